@@ -0,0 +1,167 @@
+#include "BatchRunner.hpp"
+#include "InputParser.hpp"
+#include "QuadTree.hpp"
+#include "QuadTreeNode.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+BatchRunner::BatchRunner(unsigned int threads, Caches caches)
+    : threads(threads), caches(caches) {
+  if (this->threads == 0) {
+    this->threads = std::thread::hardware_concurrency();
+    this->threads = this->threads == 0 ? 1 : this->threads;
+  }
+}
+
+/**
+ * Returns the cache mode named "isolated" or "shared".
+ */
+BatchRunner::Caches BatchRunner::cachesNamed(const std::string &name) {
+  if (name == "isolated") {
+    return ISOLATED;
+  }
+  if (name == "shared") {
+    return SHARED;
+  }
+  throw "Caches must be isolated or shared.";
+}
+
+/**
+ * Returns the tab separated names of the fields of each record.
+ */
+std::string BatchRunner::header() {
+  return "file\tgeneration\tpopulation\tminX\tminY\tmaxX\tmaxY\tnodes\t"
+         "seconds\tstatus";
+}
+
+/**
+ * Returns a record as one tab separated line, without the newline. Patterns
+ * that died have "-" for their bounding box, and the status is "ok" or why
+ * the file couldn't be run.
+ */
+std::string BatchRunner::format(const Record &record) {
+  std::ostringstream line;
+  line << record.path << '\t' << record.generation << '\t'
+       << record.population << '\t';
+  if (record.box.isEmpty()) {
+    line << "-\t-\t-\t-\t";
+  } else {
+    line << record.box.minX << '\t' << record.box.minY << '\t'
+         << record.box.maxX << '\t' << record.box.maxY << '\t';
+  }
+  line << record.nodes << '\t' << record.seconds << '\t'
+       << (record.error.empty() ? "ok" : record.error);
+  return line.str();
+}
+
+/**
+ * Reads a batch list, one life file per line followed by the generation to
+ * run it to, or by nothing to run it to the given one. Blank lines and lines
+ * starting with '#' are skipped.
+ */
+std::vector<BatchRunner::Job> BatchRunner::readJobs(std::istream &in,
+                                                    uint64_t generations) {
+  auto jobs = std::vector<Job>();
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    std::string path;
+    std::string target;
+    std::string extra;
+    if (!(fields >> path) || path[0] == '#') {
+      continue;
+    }
+    if (fields >> target >> extra) {
+      throw "Batch lines must be a file and an optional generation.";
+    }
+
+    Job job = Job{path, generations};
+    if (!target.empty()) {
+      char *end;
+      job.generations = strtoull(target.c_str(), &end, 10);
+      if (target[0] == '-' || *end != '\0') {
+        throw "Invalid generation in batch list.";
+      }
+    }
+    jobs.push_back(job);
+  }
+  return jobs;
+}
+
+/**
+ * Runs every job across the threads, writing each record to out, if given,
+ * in the order of the jobs as soon as every record before it is done, and
+ * returns the records in the same order. A file that can't be run gets a
+ * record with its error rather than stopping the batch.
+ */
+std::vector<BatchRunner::Record>
+BatchRunner::run(const std::vector<Job> &jobs, std::ostream *out) {
+  // every thread starts with the default rule, so each is handed this one
+  Rule rule = QuadTreeNode::getRule();
+  std::atomic<size_t> next(0);
+  auto records = std::vector<Record>(jobs.size());
+  auto done = std::vector<bool>(jobs.size(), false);
+  size_t written = 0;
+  std::mutex lock;
+  auto workers = std::vector<std::thread>();
+
+  for (unsigned int i = 0; i < threads; i++) {
+    workers.push_back(std::thread([&]() {
+      QuadTreeNode::setRule(rule);
+      for (size_t index = next++; index < jobs.size(); index = next++) {
+        Record record = runJob(jobs[index]);
+
+        std::lock_guard<std::mutex> guard(lock);
+        records[index] = record;
+        done[index] = true;
+        for (; written < jobs.size() && done[written]; written++) {
+          if (out != nullptr) {
+            *out << format(records[written]) << std::endl;
+          }
+        }
+      }
+    }));
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return records;
+}
+
+/**
+ * Returns how many threads run the jobs.
+ */
+unsigned int BatchRunner::getThreads() const { return threads; }
+
+/**
+ * Runs one life file to its target generation on the calling thread. The
+ * target is reached by seeking, so long runs of regular patterns take
+ * hyperspeed jumps.
+ */
+BatchRunner::Record BatchRunner::runJob(const Job &job) const {
+  if (caches == ISOLATED || QuadTreeNode::cacheSize() > GARBAGE_LIMIT) {
+    QuadTreeNode::collectGarbage(std::vector<QuadTreeNode *>());
+  }
+
+  Record record = Record{job.path, 0, 0, Rect::empty(), 0, 0, ""};
+  auto start = std::chrono::steady_clock::now();
+  try {
+    QuadTree tree = QuadTree(InputParser::readFile(job.path));
+    tree.setHistoryLimit(0);
+    tree.seek(job.generations);
+    record.generation = tree.getGeneration();
+    record.population = tree.population();
+    record.box = tree.boundingBox();
+  } catch (const char *e) {
+    record.error = e;
+  }
+  record.nodes = QuadTreeNode::cacheSize();
+  record.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return record;
+}
@@ -0,0 +1,59 @@
+#ifndef BATCHRUNNER_HPP
+#define BATCHRUNNER_HPP
+#include "Rect.hpp"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Runs many life files to their target generations on a pool of threads,
+ * giving one record per file. Threads take the next file as they finish one.
+ * Nodes live in each thread's own arena, so the cache a file runs on is
+ * either emptied before it (isolated, so its record doesn't depend on what
+ * ran before it) or kept from the files that thread ran before (shared, so
+ * the still lifes and spaceships most patterns are made of are stepped
+ * once).
+ */
+class BatchRunner {
+public:
+  // with shared caches, a thread collects garbage before a file once its
+  // cache has grown past this
+  static const size_t GARBAGE_LIMIT = 1 << 22;
+
+  enum Caches { ISOLATED, SHARED };
+
+  struct Job {
+    std::string path;
+    uint64_t generations;
+  };
+
+  struct Record {
+    std::string path;
+    uint64_t generation; // reached, 0 when the file couldn't be run
+    uint64_t population;
+    Rect box;
+    size_t nodes; // in the thread's cache when the file was done
+    double seconds;
+    std::string error; // empty when the file ran
+  };
+
+  BatchRunner(unsigned int, Caches);
+
+  static Caches cachesNamed(const std::string &);
+  static std::string header();
+  static std::string format(const Record &);
+  static std::vector<Job> readJobs(std::istream &, uint64_t);
+
+  std::vector<Record> run(const std::vector<Job> &, std::ostream *);
+  unsigned int getThreads() const;
+
+private:
+  unsigned int threads;
+  Caches caches;
+
+  Record runJob(const Job &) const;
+};
+
+#endif // BATCHRUNNER_HPP
@@ -0,0 +1,252 @@
+#include "Census.hpp"
+#include "Classifier.hpp"
+#include <algorithm>
+
+// the characters of a 5 cell column of a strip, and of runs of empty columns
+static const char *const COLUMN_DIGITS = "0123456789abcdefghijklmnopqrstuv";
+static const char *const RUN_DIGITS = "0123456789abcdefghijklmnopqrstuvwxyz";
+static const unsigned int STRIP_HEIGHT = 5;
+static const unsigned int LONGEST_RUN = 39; // "yz"
+
+Census::Census() : total(0) {}
+
+/**
+ * Returns the root of the set holding index, halving the path to it.
+ */
+static size_t findSet(std::vector<size_t> &parents, size_t index) {
+  while (parents[index] != index) {
+    parents[index] = parents[parents[index]];
+    index = parents[index];
+  }
+  return index;
+}
+
+/**
+ * Splits cells into objects, each being the cells reachable from one another
+ * through neighbors. Objects come out in the order of their first cell from
+ * the north, each with its cells sorted by row. The cells are swept row by
+ * row, joining each cell to its west neighbor and to the three cells above
+ * it, which a pointer into the previous row finds without any hashing.
+ */
+std::vector<Census::Cells> Census::separate(const Cells &cells) {
+  // sorted by row and then column
+  auto rows = Cells();
+  rows.reserve(cells.size());
+  for (auto const &cell : cells) {
+    rows.push_back(std::make_pair(cell.second, cell.first));
+  }
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+  auto parents = std::vector<size_t>(rows.size());
+  for (size_t i = 0; i < rows.size(); i++) {
+    parents[i] = i;
+  }
+  auto join = [&](size_t a, size_t b) {
+    a = findSet(parents, a);
+    b = findSet(parents, b);
+    // the lower index stays the root, keeping objects in order
+    if (a < b) {
+      parents[b] = a;
+    } else if (b < a) {
+      parents[a] = b;
+    }
+  };
+
+  size_t above = 0;    // the first cell of the row above that can touch
+  size_t rowStart = 0; // the first cell of the current row
+  for (size_t i = 0; i < rows.size(); i++) {
+    int64_t y = rows[i].first;
+    int64_t x = rows[i].second;
+    if (i > 0 && rows[i - 1].first != y) {
+      above = rows[i - 1].first == y - 1 ? rowStart : i;
+      rowStart = i;
+    }
+    if (i > rowStart && rows[i - 1].second == x - 1) {
+      join(i - 1, i);
+    }
+    while (above < rowStart && rows[above].second < x - 1) {
+      above++;
+    }
+    for (size_t j = above; j < rowStart && rows[j].second <= x + 1; j++) {
+      join(j, i);
+    }
+  }
+
+  auto objects = std::vector<Cells>();
+  auto objectOf = std::vector<size_t>(rows.size());
+  for (size_t i = 0; i < rows.size(); i++) {
+    size_t root = findSet(parents, i);
+    if (root == i) {
+      objectOf[i] = objects.size();
+      objects.push_back(Cells());
+    }
+    objects[objectOf[root]].push_back(
+        std::make_pair(rows[i].second, rows[i].first));
+  }
+  return objects;
+}
+
+/**
+ * Returns the Wechsler code of cells as they lie. The pattern is cut into
+ * strips 5 rows tall from its north edge, each column of a strip written as
+ * one base-32 digit with the north row in the lowest bit. Strips are
+ * separated by 'z' and lose their trailing empty columns, and runs of empty
+ * columns shorten to 'w' for two, 'x' for three and 'y' plus a base-36 digit
+ * for four to 39.
+ */
+std::string Census::wechsler(const Cells &cells) {
+  if (cells.empty()) {
+    return "0";
+  }
+  int64_t minX = cells[0].first;
+  int64_t minY = cells[0].second;
+  int64_t maxX = minX;
+  int64_t maxY = minY;
+  for (auto const &cell : cells) {
+    minX = std::min(minX, cell.first);
+    minY = std::min(minY, cell.second);
+    maxX = std::max(maxX, cell.first);
+    maxY = std::max(maxY, cell.second);
+  }
+
+  size_t width = maxX - minX + 1;
+  size_t strips = (maxY - minY) / STRIP_HEIGHT + 1;
+  auto columns = std::vector<uint8_t>(width * strips, 0);
+  for (auto const &cell : cells) {
+    size_t y = cell.second - minY;
+    columns[(y / STRIP_HEIGHT) * width + (cell.first - minX)] |=
+        1 << (y % STRIP_HEIGHT);
+  }
+
+  std::string code;
+  for (size_t strip = 0; strip < strips; strip++) {
+    if (strip > 0) {
+      code += 'z';
+    }
+    size_t zeros = 0;
+    for (size_t x = 0; x < width; x++) {
+      uint8_t column = columns[strip * width + x];
+      if (column == 0) {
+        zeros++;
+        continue;
+      }
+      while (zeros > 0) {
+        size_t run = std::min<size_t>(zeros, LONGEST_RUN);
+        if (run == 1) {
+          code += '0';
+        } else if (run == 2) {
+          code += 'w';
+        } else if (run == 3) {
+          code += 'x';
+        } else {
+          code += 'y';
+          code += RUN_DIGITS[run - 4];
+        }
+        zeros -= run;
+      }
+      code += COLUMN_DIGITS[column];
+    }
+  }
+  return code;
+}
+
+/**
+ * Returns cells rotated and reflected into one of eight orientations, moved
+ * so their bounding box starts at (0, 0) and sorted. Orientation 0 only
+ * moves them, bits 0 and 1 mirror the x and y axes and bit 2 swaps them.
+ */
+Census::Cells Census::orient(const Cells &cells, unsigned int orientation) {
+  auto oriented = Cells();
+  oriented.reserve(cells.size());
+  int64_t minX = INT64_MAX;
+  int64_t minY = INT64_MAX;
+  for (auto const &cell : cells) {
+    int64_t x = orientation & 1 ? -cell.first : cell.first;
+    int64_t y = orientation & 2 ? -cell.second : cell.second;
+    if (orientation & 4) {
+      std::swap(x, y);
+    }
+    oriented.push_back(std::make_pair(x, y));
+    minX = std::min(minX, x);
+    minY = std::min(minY, y);
+  }
+  for (auto &cell : oriented) {
+    cell.first -= minX;
+    cell.second -= minY;
+  }
+  std::sort(oriented.begin(), oriented.end());
+  return oriented;
+}
+
+/**
+ * Returns the shortest and then lowest Wechsler code among the eight
+ * rotations and reflections of cells, such as "33" for the block.
+ */
+std::string Census::canonicalCode(const Cells &cells) {
+  std::string best;
+  for (unsigned int orientation = 0; orientation < 8; orientation++) {
+    auto code = wechsler(orient(cells, orientation));
+    if (best.empty() || code.size() < best.size() ||
+        (code.size() == best.size() && code < best)) {
+      best = code;
+    }
+  }
+  return best;
+}
+
+/**
+ * Counts amount more of the object with the given name.
+ */
+void Census::add(const std::string &code, uint64_t amount) {
+  counts[code] += amount;
+  total += amount;
+}
+
+/**
+ * Separates ash into objects and counts each of them under the name the
+ * classifier gives it.
+ */
+void Census::addAsh(const Cells &cells, Classifier &classifier) {
+  for (auto const &object : separate(cells)) {
+    add(classifier.classify(object).code, 1);
+  }
+}
+
+/**
+ * Adds every count of another census to this one.
+ */
+void Census::merge(const Census &other) {
+  for (auto const &entry : other.counts) {
+    add(entry.first, entry.second);
+  }
+}
+
+/**
+ * Returns how many of the object with the given name were counted.
+ */
+uint64_t Census::count(const std::string &code) const {
+  auto found = counts.find(code);
+  return found == counts.end() ? 0 : found->second;
+}
+
+/**
+ * Returns how many objects were counted altogether.
+ */
+uint64_t Census::objects() const { return total; }
+
+/**
+ * Returns every object with its count, the most common first and ties by
+ * name.
+ */
+std::vector<std::pair<std::string, uint64_t>> Census::sorted() const {
+  auto entries = std::vector<std::pair<std::string, uint64_t>>(counts.begin(),
+                                                               counts.end());
+  std::sort(entries.begin(), entries.end(),
+            [](const std::pair<std::string, uint64_t> &a,
+               const std::pair<std::string, uint64_t> &b) {
+              return a.second != b.second ? a.second > b.second
+                                          : a.first < b.first;
+            });
+  return entries;
+}
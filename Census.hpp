@@ -0,0 +1,40 @@
+#ifndef CENSUS_HPP
+#define CENSUS_HPP
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Classifier;
+
+/**
+ * A tally of the objects left in the ash of many runs. Ash is separated into
+ * objects of cells connected through any of their eight neighbors, and each
+ * object is named by a Classifier with its apgsearch code, such as xs4_33
+ * for the block, so every phase, rotation and reflection counts together.
+ */
+class Census {
+public:
+  typedef std::vector<std::pair<int64_t, int64_t>> Cells;
+
+  Census();
+
+  static std::vector<Cells> separate(const Cells &);
+  static std::string canonicalCode(const Cells &);
+  static Cells orient(const Cells &, unsigned int);
+  static std::string wechsler(const Cells &);
+
+  void add(const std::string &, uint64_t);
+  void addAsh(const Cells &, Classifier &);
+  void merge(const Census &);
+  uint64_t count(const std::string &) const;
+  uint64_t objects() const;
+  std::vector<std::pair<std::string, uint64_t>> sorted() const;
+
+private:
+  std::unordered_map<std::string, uint64_t> counts;
+  uint64_t total;
+};
+
+#endif // CENSUS_HPP
@@ -0,0 +1,129 @@
+#include "Classifier.hpp"
+#include "QuadTree.hpp"
+#include <algorithm>
+
+Classifier::Classifier() : hits(0), misses(0) {}
+
+size_t Classifier::ShapeHash::operator()(const Census::Cells &cells) const {
+  uint64_t hash = cells.size();
+  for (auto const &cell : cells) {
+    hash ^=
+        uint64_t(cell.first) * 0x9E3779B97F4A7C15ull + uint64_t(cell.second);
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 32;
+  }
+  return hash;
+}
+
+const char *Classifier::kindName(Kind kind) {
+  switch (kind) {
+  case STILL_LIFE:
+    return "still life";
+  case OSCILLATOR:
+    return "oscillator";
+  case SPACESHIP:
+    return "spaceship";
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ * Returns what an object is, running it only if no object of the same shape
+ * was classified before in any of its phases and orientations.
+ */
+const Classifier::Classification &
+Classifier::classify(const Census::Cells &object) {
+  auto shape = Census::orient(object, 0);
+  auto found = known.find(shape);
+  if (found != known.end()) {
+    hits++;
+    return found->second;
+  }
+  misses++;
+
+  auto phases = std::vector<Census::Cells>();
+  auto classification = run(shape, phases);
+  for (auto const &phase : phases) {
+    for (unsigned int orientation = 1; orientation < 8; orientation++) {
+      known.insert(
+          std::make_pair(Census::orient(phase, orientation), classification));
+    }
+    known.insert(std::make_pair(phase, classification));
+  }
+  return known.find(shape)->second;
+}
+
+/**
+ * Returns how many objects were named from the shapes already known.
+ */
+uint64_t Classifier::getHits() const { return hits; }
+
+/**
+ * Returns how many objects had to be run to be named.
+ */
+uint64_t Classifier::getMisses() const { return misses; }
+
+/**
+ * Returns how many shapes, counting every phase and orientation, are known.
+ */
+size_t Classifier::knownShapes() const { return known.size(); }
+
+/**
+ * Steps an object starting at (0, 0) on its own until its shape comes back,
+ * anywhere, or it dies, grows or runs past MAX_PERIOD generations. phases
+ * is filled with the shapes it went through, only the starting one for
+ * objects that don't come back.
+ */
+Classifier::Classification Classifier::run(const Census::Cells &shape,
+                                           std::vector<Census::Cells> &phases) {
+  QuadTree tree = QuadTree(shape);
+  tree.setHistoryLimit(0);
+  tree.setPeriodWindow(0);
+  phases.push_back(shape);
+
+  for (uint64_t generation = 1; generation <= MAX_PERIOD; generation++) {
+    tree.nextGeneration();
+    auto cells = tree.getLivingCells();
+    if (cells.empty() || cells.size() > MAX_GROWTH * shape.size()) {
+      break;
+    }
+    auto next = Census::orient(cells, 0);
+    if (next != shape) {
+      phases.push_back(next);
+      continue;
+    }
+
+    // the shape is back, moved by the corner of its bounding box
+    int64_t dx = INT64_MAX;
+    int64_t dy = INT64_MAX;
+    for (auto const &cell : cells) {
+      dx = std::min(dx, cell.first);
+      dy = std::min(dy, cell.second);
+    }
+
+    std::string best;
+    for (auto const &phase : phases) {
+      auto code = Census::canonicalCode(phase);
+      if (best.empty() || code.size() < best.size() ||
+          (code.size() == best.size() && code < best)) {
+        best = code;
+      }
+    }
+
+    if (dx != 0 || dy != 0) {
+      return Classification{SPACESHIP, generation, dx, dy,
+                            "xq" + std::to_string(generation) + "_" + best};
+    }
+    if (generation == 1) {
+      return Classification{STILL_LIFE, 1, 0, 0,
+                            "xs" + std::to_string(shape.size()) + "_" + best};
+    }
+    return Classification{OSCILLATOR, generation, 0, 0,
+                          "xp" + std::to_string(generation) + "_" + best};
+  }
+
+  phases.resize(1);
+  return Classification{UNKNOWN, 0, 0, 0,
+                        "zz_" + Census::canonicalCode(shape)};
+}
@@ -0,0 +1,63 @@
+#ifndef CLASSIFIER_HPP
+#define CLASSIFIER_HPP
+#include "Census.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Tells still lifes, oscillators and spaceships apart by running each object
+ * on its own, and names them with apgsearch's codes: xs followed by the
+ * population for still lifes, xp or xq followed by the period for
+ * oscillators and spaceships, then the Wechsler code of the phase and
+ * orientation with the shortest and lowest code. Objects that die, grow or
+ * change when separated from their neighbors are named zz_ followed by the
+ * code they were found with.
+ * Every phase and orientation of each object run is remembered by shape, so
+ * the same object found again is named by one hash lookup, and ash of
+ * millions of cells, which is made of few distinct objects, costs little
+ * more than separating it.
+ */
+class Classifier {
+public:
+  // the longest period looked for, and how many times its starting population
+  // an object may reach before it is taken to be growing
+  static const uint64_t MAX_PERIOD = 1024;
+  static const uint64_t MAX_GROWTH = 4;
+
+  enum Kind { STILL_LIFE, OSCILLATOR, SPACESHIP, UNKNOWN };
+
+  struct Classification {
+    Kind kind;
+    uint64_t period; // 0 for unknown objects
+    int64_t dx;      // moved per period, by spaceships
+    int64_t dy;
+    std::string code;
+  };
+
+  Classifier();
+
+  static const char *kindName(Kind);
+
+  const Classification &classify(const Census::Cells &);
+  uint64_t getHits() const;
+  uint64_t getMisses() const;
+  size_t knownShapes() const;
+
+private:
+  struct ShapeHash {
+    size_t operator()(const Census::Cells &) const;
+  };
+
+  // objects by their cells in the orientation and phase they were seen in,
+  // moved to start at (0, 0)
+  std::unordered_map<Census::Cells, Classification, ShapeHash> known;
+  uint64_t hits;
+  uint64_t misses;
+
+  static Classification run(const Census::Cells &,
+                            std::vector<Census::Cells> &);
+};
+
+#endif // CLASSIFIER_HPP
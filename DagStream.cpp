@@ -0,0 +1,202 @@
+#include "DagStream.hpp"
+#include <cstdio>
+
+static const char MAGIC[] = {'Q', 'T', 'D', 'G'};
+static const uint64_t RESET = 1;
+
+const uint8_t DagStreamWriter::VERSION;
+
+/**
+ * Appends value as an unsigned LEB128 varint, 7 bits to a byte with the
+ * high bit set on all but the last.
+ */
+static void putVarint(std::string &bytes, uint64_t value) {
+  while (value >= 0x80) {
+    bytes += char((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  bytes += char(value);
+}
+
+DagStreamWriter::DagStreamWriter(std::ostream &out)
+    : out(out), started(false), resetting(true), nextId(1),
+      collections(QuadTreeNode::collections()) {}
+
+/**
+ * Writes the frame of a root at a generation, sending the nodes under it
+ * that weren't sent before. Arena indices are reused after a garbage
+ * collection, so the first frame after one resends everything.
+ */
+DagStreamWriter::FrameStats DagStreamWriter::write(const QuadTreeNode *root,
+                                                   uint64_t generation) {
+  std::string frame;
+  if (!started) {
+    frame.append(MAGIC, sizeof(MAGIC));
+    frame += char(VERSION);
+    started = true;
+  }
+  if (QuadTreeNode::collections() != collections) {
+    collections = QuadTreeNode::collections();
+    resetting = true;
+  }
+  if (resetting) {
+    ids.clear();
+    nextId = 1;
+  }
+
+  std::string body;
+  uint64_t count = 0;
+  uint32_t rootId = send(root, body, count);
+  putVarint(frame, resetting ? RESET : 0);
+  putVarint(frame, generation);
+  putVarint(frame, count);
+  frame += body;
+  putVarint(frame, rootId);
+  out.write(frame.data(), frame.size());
+  out.flush();
+
+  FrameStats stats = FrameStats{count, frame.size(), resetting};
+  resetting = false;
+  return stats;
+}
+
+/**
+ * Makes the next frame tell the other end to forget every node, and send
+ * its whole tree again.
+ */
+void DagStreamWriter::reset() { resetting = true; }
+
+/**
+ * Returns the stream id of a node, first appending it and every quad under
+ * it the other end doesn't have to body, quads first.
+ */
+uint32_t DagStreamWriter::send(const QuadTreeNode *node, std::string &body,
+                               uint64_t &count) {
+  uint32_t index = QuadTreeNode::indexOf(node);
+  if (index < ids.size() && ids[index] != 0) {
+    return ids[index];
+  }
+
+  if (node->height() == 0) {
+    putVarint(body, 0);
+    body += char(node->state());
+  } else {
+    uint32_t quads[4] = {send(node->nw(), body, count),
+                         send(node->ne(), body, count),
+                         send(node->sw(), body, count),
+                         send(node->se(), body, count)};
+    putVarint(body, node->height());
+    for (uint32_t quad : quads) {
+      putVarint(body, nextId - quad);
+    }
+  }
+
+  if (index >= ids.size()) {
+    ids.resize(index + 1, 0);
+  }
+  ids[index] = nextId;
+  count++;
+  return nextId++;
+}
+
+DagStreamReader::DagStreamReader(std::istream &in)
+    : in(in), started(false), nodes(1, nullptr) {}
+
+/**
+ * Returns how many nodes later frames may refer to.
+ */
+size_t DagStreamReader::knownNodes() const { return nodes.size() - 1; }
+
+/**
+ * Returns the nodes later frames may refer to, to keep through garbage
+ * collection, with a null first.
+ */
+const std::vector<QuadTreeNode *> &DagStreamReader::pinned() const {
+  return nodes;
+}
+
+/**
+ * Reads the next frame into frame, returning false at the end of the stream,
+ * or throwing if the stream is cut short or isn't one.
+ */
+bool DagStreamReader::read(Frame &frame) {
+  if (!started) {
+    char header[sizeof(MAGIC) + 1];
+    if (!in.read(header, sizeof(header))) {
+      if (in.gcount() == 0) {
+        return false;
+      }
+      throw "Truncated node stream.";
+    }
+    for (size_t i = 0; i < sizeof(MAGIC); i++) {
+      if (header[i] != MAGIC[i]) {
+        throw "Not a node stream.";
+      }
+    }
+    if (uint8_t(header[sizeof(MAGIC)]) != DagStreamWriter::VERSION) {
+      throw "Unsupported node stream version.";
+    }
+    started = true;
+  }
+  if (in.peek() == EOF) {
+    return false;
+  }
+
+  uint64_t flags = readVarint();
+  frame.reset = (flags & RESET) != 0;
+  if (frame.reset) {
+    nodes.assign(1, nullptr);
+  }
+  frame.generation = readVarint();
+  frame.nodes = readVarint();
+
+  for (uint64_t i = 0; i < frame.nodes; i++) {
+    uint64_t height = readVarint();
+    if (height == 0) {
+      int state = in.get();
+      if (state == EOF) {
+        throw "Truncated node stream.";
+      }
+      nodes.push_back(QuadTreeNode::retrieveState(uint8_t(state)));
+      continue;
+    }
+
+    uint64_t id = nodes.size();
+    QuadTreeNode *quads[4];
+    for (auto &quad : quads) {
+      uint64_t back = readVarint();
+      if (height >= QuadTreeNode::MAX_HEIGHT || back == 0 || back >= id ||
+          nodes[id - back]->height() != height - 1) {
+        throw "Malformed node stream.";
+      }
+      quad = nodes[id - back];
+    }
+    nodes.push_back(QuadTreeNode::retrieve(quads[0], quads[1], quads[2],
+                                           quads[3]));
+  }
+
+  uint64_t root = readVarint();
+  if (root == 0 || root >= nodes.size()) {
+    throw "Malformed node stream.";
+  }
+  frame.root = nodes[root];
+  return true;
+}
+
+/**
+ * Reads one unsigned LEB128 varint.
+ */
+uint64_t DagStreamReader::readVarint() {
+  uint64_t value = 0;
+  for (unsigned int shift = 0; shift < 64; shift += 7) {
+    int byte = in.get();
+    if (byte == EOF) {
+      throw "Truncated node stream.";
+    }
+    value |= uint64_t(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw "Malformed node stream.";
+}
@@ -0,0 +1,86 @@
+#ifndef DAGSTREAM_HPP
+#define DAGSTREAM_HPP
+#include "QuadTreeNode.hpp"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Sends a universe to another process one frame per root, as the nodes the
+ * other end hasn't seen yet followed by the root. Nodes are hash-consed, so
+ * whatever didn't change since the last frame is already there, and a frame
+ * costs bytes in proportion to what is new rather than to the population.
+ *
+ * The stream starts with the 4 byte magic "QTDG" and a version byte, and
+ * each frame is made of unsigned LEB128 varints:
+ *   flags         bit 0 set when the other end must forget every node
+ *   generation
+ *   count         of the new nodes that follow
+ *   count nodes   height, then the state byte of a leaf, or for a larger
+ *                 node how far back each of its nw, ne, sw and se quads is
+ *                 from its own id
+ *   root          the id of the root
+ * New nodes take ids one after another from 1, in the order they are sent,
+ * and their quads always come before them.
+ */
+class DagStreamWriter {
+public:
+  static const uint8_t VERSION = 1;
+
+  struct FrameStats {
+    uint64_t nodes; // sent in the frame
+    uint64_t bytes;
+    bool reset;
+  };
+
+  DagStreamWriter(std::ostream &);
+
+  FrameStats write(const QuadTreeNode *, uint64_t);
+  void reset();
+
+private:
+  std::ostream &out;
+  bool started;
+  bool resetting;
+  // the stream id of every node sent since the last reset by arena index, 0
+  // for those that weren't, which stay valid until the next collection
+  std::vector<uint32_t> ids;
+  uint32_t nextId;
+  uint64_t collections;
+
+  uint32_t send(const QuadTreeNode *, std::string &, uint64_t &);
+};
+
+/**
+ * The other end of a DagStreamWriter, rebuilding each frame's root out of
+ * nodes in the calling thread's arena. Every node received is kept for
+ * later frames to refer to until the writer resets, so those nodes must be
+ * kept through garbage collection, as pinned returns them.
+ */
+class DagStreamReader {
+public:
+  struct Frame {
+    uint64_t generation;
+    QuadTreeNode *root;
+    uint64_t nodes; // new in the frame
+    bool reset;
+  };
+
+  DagStreamReader(std::istream &);
+
+  size_t knownNodes() const;
+  const std::vector<QuadTreeNode *> &pinned() const;
+  bool read(Frame &);
+
+private:
+  std::istream &in;
+  bool started;
+  // by stream id, with nothing at 0
+  std::vector<QuadTreeNode *> nodes;
+
+  uint64_t readVarint();
+};
+
+#endif // DAGSTREAM_HPP
@@ -0,0 +1,279 @@
+#include "DenseGrid.hpp"
+#include "LifeKernel.hpp"
+#include "QuadTreeNode.hpp"
+#include <unordered_set>
+
+static const unsigned int LAST_ROW = DenseGrid::TILE_SIZE - 1;
+
+DenseGrid::DenseGrid() : rule(QuadTreeNode::getRule()) {
+  if (!supports(rule)) {
+    throw "Rule not supported by the dense engine.";
+  }
+}
+
+DenseGrid::DenseGrid(std::vector<std::pair<int64_t, int64_t>> cells)
+    : DenseGrid() {
+  for (auto const &point : cells) {
+    setCellAlive(point.first, point.second);
+  }
+}
+
+/**
+ * Converts a quad tree into tiles, walking only its living cells.
+ */
+DenseGrid::DenseGrid(QuadTree &tree) : DenseGrid(tree.getLivingCells()) {
+  if (tree.topology != QuadTree::PLANE) {
+    throw "The dense engine only supports the unbounded plane.";
+  }
+}
+
+/**
+ * Returns whether the dense engine can run a rule, which must be two-state
+ * and outer-totalistic.
+ */
+bool DenseGrid::supports(const Rule &rule) {
+  return rule.totalistic && rule.states == 2;
+}
+
+/**
+ * Returns the smallest rectangle holding every living cell, which is empty
+ * if there are none. Each tile's columns are found from its rows ORed
+ * together, so no cell is visited on its own.
+ */
+Rect DenseGrid::boundingBox() {
+  Rect box = Rect::empty();
+  for (auto const &entry : tiles) {
+    int64_t originX = entry.first.first * int64_t(TILE_SIZE);
+    int64_t originY = entry.first.second * int64_t(TILE_SIZE);
+    uint64_t columns = 0;
+    for (unsigned int y = 0; y < TILE_SIZE; y++) {
+      uint64_t row = entry.second.rows[y];
+      if (row == 0) {
+        continue;
+      }
+      columns |= row;
+      box.minY = originY + y < box.minY ? originY + y : box.minY;
+      box.maxY = originY + y > box.maxY ? originY + y : box.maxY;
+    }
+    if (columns == 0) {
+      continue;
+    }
+
+    int64_t west = originX + __builtin_ctzll(columns);
+    int64_t east = originX + (LAST_ROW - __builtin_clzll(columns));
+    box.minX = west < box.minX ? west : box.minX;
+    box.maxX = east > box.maxX ? east : box.maxX;
+  }
+  return box;
+}
+
+/**
+ * Returns the tile at the given tile coordinates, or nullptr if it is empty.
+ */
+const DenseGrid::Tile *DenseGrid::findTile(int64_t tileX,
+                                           int64_t tileY) const {
+  auto found = tiles.find(TileKey(tileX, tileY));
+  return found == tiles.end() ? nullptr : &found->second;
+}
+
+/**
+ * Returns whether the cell at (x, y) is alive.
+ */
+bool DenseGrid::getCellAlive(int64_t x, int64_t y) {
+  auto tile = findTile(x >> 6, y >> 6);
+  return tile != nullptr && ((tile->rows[y & LAST_ROW] >> (x & 63)) & 1);
+}
+
+/**
+ * Returns the coordinates of every living cell, tile by tile.
+ */
+std::vector<std::pair<int64_t, int64_t>> DenseGrid::getLivingCells() {
+  auto cells = std::vector<std::pair<int64_t, int64_t>>();
+  for (auto const &entry : tiles) {
+    int64_t originX = entry.first.first * int64_t(TILE_SIZE);
+    int64_t originY = entry.first.second * int64_t(TILE_SIZE);
+    for (unsigned int y = 0; y < TILE_SIZE; y++) {
+      uint64_t row = entry.second.rows[y];
+      while (row != 0) {
+        unsigned int x = __builtin_ctzll(row);
+        cells.push_back(std::pair<int64_t, int64_t>(originX + x, originY + y));
+        row &= row - 1;
+      }
+    }
+  }
+  return cells;
+}
+
+/**
+ * Steps every tile that is alive or borders a living cell, dropping tiles
+ * that die out.
+ */
+void DenseGrid::nextGeneration() {
+  std::unordered_set<TileKey, TileKeyHash> candidates;
+  for (auto const &entry : tiles) {
+    int64_t tileX = entry.first.first;
+    int64_t tileY = entry.first.second;
+    const uint64_t *rows = entry.second.rows;
+
+    uint64_t west = 0;
+    uint64_t east = 0;
+    for (unsigned int y = 0; y < TILE_SIZE; y++) {
+      west |= rows[y] & 1;
+      east |= rows[y] >> 63;
+    }
+    uint64_t north = rows[0];
+    uint64_t south = rows[LAST_ROW];
+
+    candidates.insert(entry.first);
+    if (north) {
+      candidates.insert(TileKey(tileX, tileY - 1));
+    }
+    if (south) {
+      candidates.insert(TileKey(tileX, tileY + 1));
+    }
+    if (west) {
+      candidates.insert(TileKey(tileX - 1, tileY));
+    }
+    if (east) {
+      candidates.insert(TileKey(tileX + 1, tileY));
+    }
+    if (north & 1) {
+      candidates.insert(TileKey(tileX - 1, tileY - 1));
+    }
+    if (north >> 63) {
+      candidates.insert(TileKey(tileX + 1, tileY - 1));
+    }
+    if (south & 1) {
+      candidates.insert(TileKey(tileX - 1, tileY + 1));
+    }
+    if (south >> 63) {
+      candidates.insert(TileKey(tileX + 1, tileY + 1));
+    }
+  }
+
+  std::unordered_map<TileKey, Tile, TileKeyHash> next;
+  next.reserve(candidates.size());
+  for (auto const &key : candidates) {
+    Tile tile;
+    stepTile(key, tile);
+
+    uint64_t any = 0;
+    for (unsigned int y = 0; y < TILE_SIZE; y++) {
+      any |= tile.rows[y];
+    }
+    if (any) {
+      next[key] = tile;
+    }
+  }
+  tiles.swap(next);
+}
+
+/**
+ * Returns the amount of living cells.
+ */
+uint64_t DenseGrid::population() {
+  uint64_t population = 0;
+  for (auto const &entry : tiles) {
+    for (unsigned int y = 0; y < TILE_SIZE; y++) {
+      population += __builtin_popcountll(entry.second.rows[y]);
+    }
+  }
+  return population;
+}
+
+/**
+ * Returns the amount of living cells inside of an inclusive rectangle,
+ * masking the columns of the tiles it cuts through.
+ */
+uint64_t DenseGrid::populationIn(const Rect &box) {
+  uint64_t population = 0;
+  for (auto const &entry : tiles) {
+    int64_t originX = entry.first.first * int64_t(TILE_SIZE);
+    int64_t originY = entry.first.second * int64_t(TILE_SIZE);
+    int64_t farX = originX + LAST_ROW;
+    int64_t farY = originY + LAST_ROW;
+    if (farX < box.minX || originX > box.maxX || farY < box.minY ||
+        originY > box.maxY) {
+      continue;
+    }
+
+    unsigned int west = box.minX > originX ? box.minX - originX : 0;
+    unsigned int east = box.maxX < farX ? box.maxX - originX : LAST_ROW;
+    unsigned int north = box.minY > originY ? box.minY - originY : 0;
+    unsigned int south = box.maxY < farY ? box.maxY - originY : LAST_ROW;
+    uint64_t mask = (east == LAST_ROW ? UINT64_MAX
+                                      : (uint64_t(1) << (east + 1)) - 1) &
+                    ~((uint64_t(1) << west) - 1);
+    for (unsigned int y = north; y <= south; y++) {
+      population += __builtin_popcountll(entry.second.rows[y] & mask);
+    }
+  }
+  return population;
+}
+
+/**
+ * Sets the cell at (x, y) alive, creating its tile if needed.
+ */
+void DenseGrid::setCellAlive(int64_t x, int64_t y) {
+  auto key = TileKey(x >> 6, y >> 6);
+  auto found = tiles.find(key);
+  if (found == tiles.end()) {
+    found = tiles.insert(std::make_pair(key, Tile())).first;
+    for (unsigned int row = 0; row < TILE_SIZE; row++) {
+      found->second.rows[row] = 0;
+    }
+  }
+  found->second.rows[y & LAST_ROW] |= uint64_t(1) << (x & 63);
+}
+
+/**
+ * Calculates the next generation of a tile from it and its eight neighbors.
+ * The rows above and below come from the tiles to the north and south, and
+ * the bits shifted in at either end of each row from the tiles to the west
+ * and east.
+ */
+void DenseGrid::stepTile(const TileKey &key, Tile &out) const {
+  int64_t tileX = key.first;
+  int64_t tileY = key.second;
+
+  const Tile *columns[3][3];
+  for (int dy = -1; dy <= 1; dy++) {
+    for (int dx = -1; dx <= 1; dx++) {
+      columns[dy + 1][dx + 1] = findTile(tileX + dx, tileY + dy);
+    }
+  }
+
+  uint64_t rows[TILE_SIZE + 2];
+  uint64_t west[TILE_SIZE + 2];
+  uint64_t east[TILE_SIZE + 2];
+  for (unsigned int i = 0; i < TILE_SIZE + 2; i++) {
+    // row i is y = i - 1 relative to this tile, wrapping into the tile above
+    // or below at either end
+    unsigned int band = i == 0 ? 0 : (i == TILE_SIZE + 1 ? 2 : 1);
+    unsigned int y = band == 0 ? LAST_ROW : (band == 2 ? 0 : i - 1);
+
+    const Tile *westTile = columns[band][0];
+    const Tile *centerTile = columns[band][1];
+    const Tile *eastTile = columns[band][2];
+
+    uint64_t row = centerTile ? centerTile->rows[y] : 0;
+    uint64_t westRow = westTile ? westTile->rows[y] : 0;
+    uint64_t eastRow = eastTile ? eastTile->rows[y] : 0;
+
+    rows[i] = row;
+    west[i] = (row << 1) | (westRow >> 63);
+    east[i] = (row >> 1) | (eastRow << 63);
+  }
+
+  LifeKernel::stepRows(rows, west, east, out.rows, TILE_SIZE, rule);
+}
+
+/**
+ * Returns the amount of tiles currently holding living cells.
+ */
+size_t DenseGrid::tileCount() const { return tiles.size(); }
+
+/**
+ * Converts the tiles back into a quad tree.
+ */
+QuadTree DenseGrid::toQuadTree() { return QuadTree(getLivingCells()); }
@@ -0,0 +1,60 @@
+#ifndef DENSEGRID_HPP
+#define DENSEGRID_HPP
+#include "QuadTree.hpp"
+#include "Rule.hpp"
+#include "Universe.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * A QuickLife-style engine storing the plane as 64x64 tiles of bit-packed
+ * rows, 64 cells per word, and stepping every row with bitwise neighbor
+ * counting in LifeKernel. Unlike the QuadTree it gains nothing from
+ * repetition, but it also pays no hashing or memoization cost, which wins on
+ * chaotic patterns.
+ * Only two-state outer-totalistic rules on the unbounded plane are supported.
+ */
+class DenseGrid : public Universe {
+public:
+  static const unsigned int TILE_SIZE = 64;
+
+  DenseGrid();
+  DenseGrid(std::vector<std::pair<int64_t, int64_t>>);
+  DenseGrid(QuadTree &);
+
+  static bool supports(const Rule &);
+
+  Rect boundingBox() override;
+  bool getCellAlive(int64_t, int64_t) override;
+  std::vector<std::pair<int64_t, int64_t>> getLivingCells() override;
+  void nextGeneration() override;
+  uint64_t population() override;
+  uint64_t populationIn(const Rect &) override;
+  void setCellAlive(int64_t, int64_t) override;
+  size_t tileCount() const;
+  QuadTree toQuadTree();
+
+private:
+  typedef std::pair<int64_t, int64_t> TileKey;
+
+  struct Tile {
+    uint64_t rows[TILE_SIZE]; // bit x of row y is the cell at (x, y)
+  };
+
+  struct TileKeyHash {
+    size_t operator()(const TileKey &key) const {
+      return std::hash<int64_t>()(key.first) * 31 +
+             std::hash<int64_t>()(key.second);
+    }
+  };
+
+  std::unordered_map<TileKey, Tile, TileKeyHash> tiles;
+  Rule rule;
+
+  const Tile *findTile(int64_t, int64_t) const;
+  void stepTile(const TileKey &, Tile &) const;
+};
+
+#endif // DENSEGRID_HPP
@@ -8,6 +8,7 @@ static const int SPEED_MAX = 10;
 static const int ZOOM_MIN = 0;
 static const int ZOOM_MAX = 8;
 static const int SPEED_CONSTANT = 100;
+static const size_t GARBAGE_LIMIT = 1 << 21;
 
 /**
  * Given a string, throw that string and the result of SDL_GetError()
@@ -18,9 +19,15 @@ void Game::throwSdlException(std::string message) {
   throw oss.str();
 }
 
-Game::Game(unsigned int width, unsigned int height, QuadTree tree)
-    : shouldQuit(false), width(width), height(height), tree(tree),
-      generationCount(0), speed(5), zoom(4), x(-1), y(-1) {
+/**
+ * Creates the window, running the universe on the given engine.
+ * @param automatic whether to switch engines as the pattern changes
+ */
+Game::Game(unsigned int width, unsigned int height, QuadTree tree,
+           Simulator::Engine engine, bool automatic)
+    : shouldQuit(false), width(width), height(height),
+      simulator(tree, engine, automatic), switchCount(0), generationCount(0),
+      paused(false), speed(5), zoom(4), x(-1), y(-1) {
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     throwSdlException("Could not initialize SDL: ");
   }
@@ -47,6 +54,10 @@ Game::Game(unsigned int width, unsigned int height, QuadTree tree)
   currentTime = SDL_GetPerformanceCounter();
   lastTime = 0;
   timeSinceUpdate = 0;
+  simulator.setGarbageLimit(GARBAGE_LIMIT);
+
+  std::cout << "Starting on " << Simulator::engineName(simulator.getEngine())
+            << ", " << simulator.describeThresholds() << std::endl;
 }
 
 Game::~Game() {
@@ -96,6 +107,48 @@ void Game::handleSpeedAdjust(int amount) {
   speed = boost::algorithm::clamp(speed + amount, SPEED_MIN, SPEED_MAX);
 }
 
+/**
+ * Centers the camera on the living cells, zoomed in as far as fits them all.
+ */
+void Game::handleFit() {
+  Rect box = simulator.boundingBox();
+  if (box.isEmpty()) {
+    return;
+  }
+
+  x = box.minX + int64_t((uint64_t(box.maxX) - uint64_t(box.minX)) / 2);
+  y = box.minY + int64_t((uint64_t(box.maxY) - uint64_t(box.minY)) / 2);
+  uint64_t spanX = uint64_t(box.maxX) - uint64_t(box.minX);
+  uint64_t spanY = uint64_t(box.maxY) - uint64_t(box.minY);
+  zoom = ZOOM_MAX;
+  while (zoom > ZOOM_MIN && (spanX >= uint64_t(width >> zoom) ||
+                             spanY >= uint64_t(height >> zoom))) {
+    zoom--;
+  }
+  std::cout << "Fit " << simulator.population() << " cells in ("
+            << box.minX << ", " << box.minY << ") to (" << box.maxX << ", "
+            << box.maxY << ")" << std::endl;
+}
+
+/**
+ * Pauses the simulation and steps one generation back or forward through
+ * its history.
+ */
+void Game::handleStep(bool backward) {
+  paused = true;
+  if (backward) {
+    if (!simulator.rewind()) {
+      std::cout << "Nothing to rewind to (history is only kept on hashlife)"
+                << std::endl;
+      return;
+    }
+  } else {
+    simulator.forward();
+  }
+  generationCount = simulator.getGeneration();
+  std::cout << "Generation " << generationCount << " (paused)" << std::endl;
+}
+
 /**
  * Handles all legal input.
  * TODO: ensure we don't allow the camera to roll-over INT64_MIN/max
@@ -122,6 +175,18 @@ void Game::handleInput() {
       case SDLK_RIGHTBRACKET:
         handleZoom(1);
         break;
+      case SDLK_SPACE:
+        paused = !paused;
+        break;
+      case SDLK_COMMA:
+        handleStep(true);
+        break;
+      case SDLK_PERIOD:
+        handleStep(false);
+        break;
+      case SDLK_f:
+        handleFit();
+        break;
       case SDLK_w:
         y = clampMove(y, -1);
         break;
@@ -142,7 +207,8 @@ void Game::handleInput() {
 }
 
 /**
- * Update the clock, run the tree's next generation if its time.
+ * Update the clock, run the universe's next generation if its time, and
+ * report any switch between engines.
  */
 void Game::update() {
   lastTime = currentTime;
@@ -151,12 +217,19 @@ void Game::update() {
                        (double)SDL_GetPerformanceFrequency());
 
   timeSinceUpdate += dt;
-  if (timeSinceUpdate > speed * SPEED_CONSTANT) {
+  if (paused) {
+    timeSinceUpdate = 0;
+  } else if (timeSinceUpdate > speed * SPEED_CONSTANT) {
     auto ticks = SDL_GetTicks();
-    tree.nextGeneration();
-    std::cout << "Generation " << ++generationCount << " at height "
-              << tree.height() << " took " << SDL_GetTicks() - ticks << "ms"
-              << std::endl;
+    simulator.nextGeneration();
+    generationCount = simulator.getGeneration();
+    std::cout << "Generation " << generationCount << " took "
+              << SDL_GetTicks() - ticks << "ms on "
+              << simulator.describeStats() << std::endl;
+    if (simulator.getSwitchCount() != switchCount) {
+      switchCount = simulator.getSwitchCount();
+      std::cout << "Engine " << simulator.getLastDecision() << std::endl;
+    }
     timeSinceUpdate -= speed * SPEED_CONSTANT;
   }
 }
@@ -186,7 +259,7 @@ void Game::render() {
 
   for (int64_t i = yMin; i <= yMax && i >= yMin; i++) {
     for (int64_t j = xMin; j <= xMax && j >= xMin; j++) {
-      if (tree.getCellAlive(j, i)) {
+      if (simulator.getCellAlive(j, i)) {
         rect.x = (j - x + w) * cellSize;
         rect.y = (i - y + h) * cellSize;
 
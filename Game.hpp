@@ -1,11 +1,13 @@
 #ifndef GAME_HPP
 #define GAME_HPP
 #include "QuadTree.hpp"
+#include "Simulator.hpp"
 #include <SDL2/SDL.h>
 
 class Game {
 public:
-  Game(unsigned int, unsigned int, QuadTree);
+  Game(unsigned int, unsigned int, QuadTree,
+       Simulator::Engine = Simulator::HASHLIFE, bool = true);
   ~Game();
 
   static int64_t clampMin(int64_t, unsigned int, unsigned int);
@@ -21,14 +23,18 @@ private:
   static void throwSdlException(std::string);
 
   int64_t clampMove(int64_t, int) const;
+  void handleFit();
   void handleZoom(int);
   void handleSpeedAdjust(int);
+  void handleStep(bool);
 
   const int width;
   const int height;
 
-  QuadTree tree;
+  Simulator simulator;
+  unsigned int switchCount;
   unsigned int generationCount;
+  bool paused;
   int speed;
   int zoom;
   int64_t x;
@@ -4,6 +4,29 @@
 #include <fstream>
 #include <iostream>
 
+/**
+ * Pulls every "--name value" pair out of the command-line, storing them in
+ * options by name, and returns the remaining arguments (including the program
+ * name) so they can be handed to getPoints.
+ */
+std::vector<char *>
+InputParser::extractOptions(int argc, char *argv[],
+                            std::map<std::string, std::string> &options) {
+  auto remaining = std::vector<char *>();
+  for (int i = 0; i < argc; i++) {
+    std::string arg = std::string(argv[i]);
+    if (i > 0 && arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      if (i + 1 >= argc) {
+        throw "Missing value for option.";
+      }
+      options[arg.substr(2)] = std::string(argv[++i]);
+    } else {
+      remaining.push_back(argv[i]);
+    }
+  }
+  return remaining;
+}
+
 /**
  * Given command-line input, return the points either from a life file, or the
  * raw points entered.
@@ -17,28 +40,7 @@ std::vector<std::pair<int64_t, int64_t>> InputParser::getPoints(int argc,
     std::string flag = std::string(argv[1]);
     boost::trim(flag);
     if (flag == "-f") {
-      std::ifstream ifs(argv[2]);
-      std::string content((std::istreambuf_iterator<char>(ifs)),
-                          (std::istreambuf_iterator<char>()));
-
-      std::vector<std::string> tokens;
-      boost::trim(content);
-      boost::split(tokens, content, boost::is_any_of("\t\r\n "),
-                   boost::token_compress_on);
-
-      if (tokens.size() % 2 != 0) {
-        throw "Invalid amount of points.";
-      }
-
-      auto points = std::vector<std::pair<int64_t, int64_t>>();
-
-      for (int i = 0; i < tokens.size(); i += 2) {
-        auto x = strToInt64(tokens[i]);
-        auto y = strToInt64(tokens[i + 1]);
-        points.push_back(std::pair<int64_t, int64_t>(x, y));
-      }
-
-      return points;
+      return readFile(argv[2]);
     }
   }
 
@@ -57,6 +59,39 @@ std::vector<std::pair<int64_t, int64_t>> InputParser::getPoints(int argc,
   return points;
 }
 
+/**
+ * Reads the points of a life file, written as "(x, y)" pairs separated by any
+ * whitespace.
+ */
+std::vector<std::pair<int64_t, int64_t>>
+InputParser::readFile(const std::string &path) {
+  std::ifstream ifs(path);
+  if (!ifs) {
+    throw "Could not open pattern file.";
+  }
+  std::string content((std::istreambuf_iterator<char>(ifs)),
+                      (std::istreambuf_iterator<char>()));
+
+  std::vector<std::string> tokens;
+  boost::trim(content);
+  boost::split(tokens, content, boost::is_any_of("\t\r\n "),
+               boost::token_compress_on);
+
+  if (tokens.size() % 2 != 0) {
+    throw "Invalid amount of points.";
+  }
+
+  auto points = std::vector<std::pair<int64_t, int64_t>>();
+
+  for (size_t i = 0; i < tokens.size(); i += 2) {
+    auto x = strToInt64(tokens[i]);
+    auto y = strToInt64(tokens[i + 1]);
+    points.push_back(std::pair<int64_t, int64_t>(x, y));
+  }
+
+  return points;
+}
+
 /**
  * Given a string, remove legal characters and convert it to an int64_t
  */
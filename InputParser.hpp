@@ -1,13 +1,18 @@
 #ifndef INPUTPARSER_HPP
 #define INPUTPARSER_HPP
 #include <cstdint>
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
 class InputParser {
 public:
+  static std::vector<char *> extractOptions(int, char *[],
+                                           std::map<std::string, std::string> &);
   static std::vector<std::pair<int64_t, int64_t>> getPoints(int, char *[]);
+  static std::vector<std::pair<int64_t, int64_t>>
+  readFile(const std::string &);
   static int64_t strToInt64(std::string);
 };
 
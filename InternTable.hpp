@@ -0,0 +1,181 @@
+#ifndef INTERNTABLE_HPP
+#define INTERNTABLE_HPP
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * How full an intern table is and how far lookups have to probe, for
+ * comparing hash policies on the nodes of a real run. A cluster is a run of
+ * occupied slots, which every lookup landing in it has to walk to its end
+ * when the node is missing.
+ */
+struct TableDiagnostics {
+  size_t slots;
+  size_t entries;
+  double load;
+  double meanProbe; // extra slots visited to find an entry, on average
+  size_t maxProbe;
+  size_t longestCluster;
+  double meanCluster;
+  size_t distinctHashes; // below entries when full hashes collide
+  std::vector<size_t> probes; // entries by probe length, the last bucket
+                              // counting everything longer
+};
+
+/**
+ * An open addressing table of arena indices with linear probing, where
+ * index 0 marks an empty slot. Entries are hashed and compared as the nodes
+ * they index, so the table itself takes 4 bytes per slot. The Hash policy
+ * must spread its low bits, as slots are picked by masking.
+ */
+template <typename Node, typename Hash> class InternTable {
+public:
+  static const uint32_t EMPTY = 0;
+  static const size_t MIN_SLOTS = 1024;
+  static const size_t PROBE_BUCKETS = 16;
+
+  InternTable() : count(0) {}
+
+  /**
+   * Returns the index of the entry equal to node, or EMPTY if there is none.
+   */
+  uint32_t find(const Node &node, const Node *arena) const {
+    if (slots.empty()) {
+      return EMPTY;
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t slot = hash(node) & mask; slots[slot] != EMPTY;
+         slot = (slot + 1) & mask) {
+      if (arena[slots[slot]] == node) {
+        return slots[slot];
+      }
+    }
+    return EMPTY;
+  }
+
+  /**
+   * Starts loading the slot a lookup of the node of the given height made of
+   * these quads begins at, ahead of the find, without building the node.
+   */
+  void prefetch(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se,
+                unsigned int height) const {
+    if (!slots.empty()) {
+      __builtin_prefetch(
+          &slots[hash(nw, ne, sw, se, height) & (slots.size() - 1)]);
+    }
+  }
+
+  /**
+   * Adds the node at index, which must not be in the table yet, growing the
+   * table past a load of 0.7.
+   */
+  void insert(uint32_t index, const Node *arena) {
+    if ((count + 1) * 10 > slots.size() * 7) {
+      resize(slots.size() < MIN_SLOTS ? MIN_SLOTS : slots.size() * 2, arena);
+    }
+    size_t mask = slots.size() - 1;
+    size_t slot = hash(arena[index]) & mask;
+    while (slots[slot] != EMPTY) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = index;
+    count++;
+  }
+
+  /**
+   * Empties the table, keeping its slots allocated.
+   */
+  void clear() {
+    std::fill(slots.begin(), slots.end(), EMPTY);
+    count = 0;
+  }
+
+  size_t size() const { return count; }
+  size_t bytes() const { return slots.capacity() * sizeof(uint32_t); }
+
+  /**
+   * Calls visit with every index in the table.
+   */
+  template <typename Visit> void forEach(Visit visit) const {
+    for (uint32_t index : slots) {
+      if (index != EMPTY) {
+        visit(index);
+      }
+    }
+  }
+
+  /**
+   * Measures the occupancy, probe lengths and clusters of the table.
+   */
+  TableDiagnostics diagnose(const Node *arena) const {
+    TableDiagnostics result = TableDiagnostics();
+    result.slots = slots.size();
+    result.entries = count;
+    result.load = slots.empty() ? 0 : double(count) / slots.size();
+    result.probes = std::vector<size_t>(PROBE_BUCKETS, 0);
+
+    size_t mask = slots.size() - 1;
+    size_t totalProbe = 0;
+    size_t clusters = 0;
+    size_t run = 0;
+    auto hashes = std::vector<size_t>();
+    hashes.reserve(count);
+    for (size_t slot = 0; slot < slots.size(); slot++) {
+      if (slots[slot] == EMPTY) {
+        if (run > 0) {
+          clusters++;
+        }
+        run = 0;
+        continue;
+      }
+      run++;
+      if (run > result.longestCluster) {
+        result.longestCluster = run;
+      }
+
+      size_t full = hash(arena[slots[slot]]);
+      hashes.push_back(full);
+      size_t probe = (slot - (full & mask)) & mask;
+      totalProbe += probe;
+      result.maxProbe = probe > result.maxProbe ? probe : result.maxProbe;
+      result.probes[probe < PROBE_BUCKETS ? probe : PROBE_BUCKETS - 1]++;
+    }
+    if (run > 0) {
+      clusters++;
+    }
+
+    std::sort(hashes.begin(), hashes.end());
+    result.distinctHashes =
+        std::unique(hashes.begin(), hashes.end()) - hashes.begin();
+    result.meanProbe = count == 0 ? 0 : double(totalProbe) / count;
+    result.meanCluster = clusters == 0 ? 0 : double(count) / clusters;
+    return result;
+  }
+
+private:
+  std::vector<uint32_t> slots;
+  size_t count;
+  Hash hash;
+
+  void resize(size_t size, const Node *arena) {
+    auto old = std::vector<uint32_t>(size, EMPTY);
+    old.swap(slots);
+    count = 0;
+    for (uint32_t index : old) {
+      if (index != EMPTY) {
+        insert(index, arena);
+      }
+    }
+  }
+};
+
+template <typename Node, typename Hash>
+const uint32_t InternTable<Node, Hash>::EMPTY;
+template <typename Node, typename Hash>
+const size_t InternTable<Node, Hash>::MIN_SLOTS;
+template <typename Node, typename Hash>
+const size_t InternTable<Node, Hash>::PROBE_BUCKETS;
+
+#endif // INTERNTABLE_HPP
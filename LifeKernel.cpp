@@ -0,0 +1,236 @@
+#include "LifeKernel.hpp"
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIFEKERNEL_X86
+#endif
+
+// two and four rows of cells, which the compiler maps onto SSE2 and AVX2
+// registers inside functions targeting those instruction sets
+typedef uint64_t TwoRows __attribute__((vector_size(16)));
+typedef uint64_t FourRows __attribute__((vector_size(32)));
+
+LifeKernel::Level LifeKernel::level = LifeKernel::detect();
+
+template <typename V>
+static inline __attribute__((always_inline)) void load(V &value,
+                                                       const uint64_t *rows) {
+  std::memcpy(&value, rows, sizeof(V));
+}
+
+template <typename V>
+static inline __attribute__((always_inline)) void fullAdd(V a, V b, V c,
+                                                          V &sum, V &carry) {
+  V ab = a ^ b;
+  sum = ab ^ c;
+  carry = (a & b) | (ab & c);
+}
+
+/**
+ * Steps rows from index i onwards, as many at a time as fit in V, leaving i
+ * at the first row that did not fit. The eight neighbors of every cell are
+ * summed into a 4-bit count across the bit-planes s0 to s3. This is always
+ * inlined, so it is compiled for the instruction set of its caller.
+ */
+template <typename V>
+static inline __attribute__((always_inline)) void
+stepRowsWith(const uint64_t *rows, const uint64_t *west, const uint64_t *east,
+             uint64_t *out, size_t &i, size_t count, const Rule &rule) {
+  const size_t width = sizeof(V) / sizeof(uint64_t);
+  const bool conway =
+      rule.birth == (1 << 3) && rule.survival == ((1 << 2) | (1 << 3));
+
+  V zero = V();
+  V birthMasks[Rule::MAX_NEIGHBORS + 1];
+  V survivalMasks[Rule::MAX_NEIGHBORS + 1];
+  for (unsigned int n = 0; n <= Rule::MAX_NEIGHBORS; n++) {
+    birthMasks[n] = zero;
+    survivalMasks[n] = zero;
+    if ((rule.birth >> n) & 1) {
+      birthMasks[n] = ~zero;
+    }
+    if ((rule.survival >> n) & 1) {
+      survivalMasks[n] = ~zero;
+    }
+  }
+
+  for (; i + width <= count; i += width) {
+    V westAbove, above, eastAbove, westMiddle, alive, eastMiddle, westBelow,
+        below, eastBelow;
+    load(westAbove, west + i);
+    load(above, rows + i);
+    load(eastAbove, east + i);
+    load(westMiddle, west + i + 1);
+    load(alive, rows + i + 1);
+    load(eastMiddle, east + i + 1);
+    load(westBelow, west + i + 2);
+    load(below, rows + i + 2);
+    load(eastBelow, east + i + 2);
+
+    V sumA, carryA, sumB, carryB;
+    fullAdd(westAbove, above, eastAbove, sumA, carryA);
+    fullAdd(westBelow, below, eastBelow, sumB, carryB);
+    V sumC = westMiddle ^ eastMiddle;
+    V carryC = westMiddle & eastMiddle;
+
+    // ones
+    V s0, carryD;
+    fullAdd(sumA, sumB, sumC, s0, carryD);
+
+    // twos, fours and eights from the four carries
+    V twos, fours;
+    fullAdd(carryA, carryB, carryC, twos, fours);
+    V s1 = twos ^ carryD;
+    V foursCarry = twos & carryD;
+    V s2 = fours ^ foursCarry;
+    V s3 = fours & foursCarry;
+
+    V next;
+    if (conway) {
+      // exactly 3 neighbors, or 2 and alive
+      next = s1 & ~s2 & ~s3 & (s0 | alive);
+    } else {
+      next = zero;
+      for (unsigned int n = 0; n <= Rule::MAX_NEIGHBORS; n++) {
+        V matches = ((n & 1) ? s0 : ~s0) & ((n & 2) ? s1 : ~s1) &
+                    ((n & 4) ? s2 : ~s2) & ((n & 8) ? s3 : ~s3);
+        next |= matches &
+                ((birthMasks[n] & ~alive) | (survivalMasks[n] & alive));
+      }
+    }
+    std::memcpy(out + i, &next, sizeof(V));
+  }
+}
+
+static void stepRowsScalar(const uint64_t *rows, const uint64_t *west,
+                           const uint64_t *east, uint64_t *out, size_t count,
+                           const Rule &rule) {
+  size_t i = 0;
+  stepRowsWith<uint64_t>(rows, west, east, out, i, count, rule);
+}
+
+#ifdef LIFEKERNEL_X86
+__attribute__((target("sse2"))) static void
+stepRowsSse2(const uint64_t *rows, const uint64_t *west, const uint64_t *east,
+             uint64_t *out, size_t count, const Rule &rule) {
+  size_t i = 0;
+  stepRowsWith<TwoRows>(rows, west, east, out, i, count, rule);
+  stepRowsWith<uint64_t>(rows, west, east, out, i, count, rule);
+}
+
+__attribute__((target("avx2"))) static void
+stepRowsAvx2(const uint64_t *rows, const uint64_t *west, const uint64_t *east,
+             uint64_t *out, size_t count, const Rule &rule) {
+  size_t i = 0;
+  stepRowsWith<FourRows>(rows, west, east, out, i, count, rule);
+  stepRowsWith<uint64_t>(rows, west, east, out, i, count, rule);
+}
+#endif
+
+/**
+ * Returns the widest instruction set this CPU supports, as reported by CPUID.
+ */
+LifeKernel::Level LifeKernel::detect() {
+#ifdef LIFEKERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return SSE2;
+  }
+#endif
+  return SCALAR;
+}
+
+/**
+ * Returns the instruction set currently used to step rows.
+ */
+LifeKernel::Level LifeKernel::getLevel() { return level; }
+
+const char *LifeKernel::levelName(Level level) {
+  switch (level) {
+  case AVX2:
+    return "avx2";
+  case SSE2:
+    return "sse2";
+  default:
+    return "scalar";
+  }
+}
+
+/**
+ * Forces a narrower instruction set, for benchmarking and testing. Levels the
+ * CPU does not support fall back to the widest one it does.
+ */
+void LifeKernel::setLevel(Level newLevel) {
+  Level supported = detect();
+  level = newLevel <= supported ? newLevel : supported;
+}
+
+/**
+ * Steps a batch of Hashlife base cases under a totalistic rule. Each block is
+ * a 4x4 square packed as in QuadTreeNode::baseIndex, and each result holds
+ * the next states of its 2x2 center in bits 0 to 3 (nw, ne, sw, se). Sixteen
+ * blocks sit side by side in every row word, so neighbors leaking between
+ * blocks only reach their outer columns, which are never read back.
+ */
+void LifeKernel::stepBaseCases(const uint16_t *blocks, uint8_t *results,
+                               size_t count, const Rule &rule) {
+  const size_t perWord = 16;
+  size_t groups = (count + perWord - 1) / perWord;
+  if (groups == 0) {
+    return;
+  }
+
+  auto rows = std::vector<uint64_t>(groups * 4, 0);
+  auto west = std::vector<uint64_t>(groups * 4, 0);
+  auto east = std::vector<uint64_t>(groups * 4, 0);
+  for (size_t block = 0; block < count; block++) {
+    size_t group = block / perWord;
+    unsigned int shift = (block % perWord) * 4;
+    for (unsigned int y = 0; y < 4; y++) {
+      rows[group * 4 + y] |= uint64_t((blocks[block] >> (y * 4)) & 0xF)
+                             << shift;
+    }
+  }
+  for (size_t i = 0; i < rows.size(); i++) {
+    west[i] = rows[i] << 1;
+    east[i] = rows[i] >> 1;
+  }
+
+  // the rows are stepped as one long strip, where only rows 1 and 2 of every
+  // group of 4 are the centers of their blocks
+  auto out = std::vector<uint64_t>(groups * 4 - 2, 0);
+  stepRows(rows.data(), west.data(), east.data(), out.data(), out.size(), rule);
+
+  for (size_t block = 0; block < count; block++) {
+    size_t group = block / perWord;
+    unsigned int shift = (block % perWord) * 4 + 1;
+    results[block] = uint8_t(((out[group * 4] >> shift) & 3) |
+                             (((out[group * 4 + 1] >> shift) & 3) << 2));
+  }
+}
+
+/**
+ * Steps count rows of cells one generation under a totalistic rule. rows,
+ * west and east each hold count + 2 words, starting with the row above the
+ * first one stepped, where west and east are the rows shifted so each bit
+ * holds its west or east neighbor.
+ */
+void LifeKernel::stepRows(const uint64_t *rows, const uint64_t *west,
+                          const uint64_t *east, uint64_t *out, size_t count,
+                          const Rule &rule) {
+#ifdef LIFEKERNEL_X86
+  if (level == AVX2) {
+    stepRowsAvx2(rows, west, east, out, count, rule);
+    return;
+  }
+  if (level == SSE2) {
+    stepRowsSse2(rows, west, east, out, count, rule);
+    return;
+  }
+#endif
+  stepRowsScalar(rows, west, east, out, count, rule);
+}
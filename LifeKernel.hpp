@@ -0,0 +1,30 @@
+#ifndef LIFEKERNEL_HPP
+#define LIFEKERNEL_HPP
+#include "Rule.hpp"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Steps rows of bit-packed cells with full-adder neighbor counting, using the
+ * widest instruction set the CPU supports: AVX2 steps four 64-cell rows (256
+ * cells) per operation, SSE2 two rows, and the scalar fallback one row.
+ */
+class LifeKernel {
+public:
+  enum Level { SCALAR, SSE2, AVX2 };
+
+  static Level detect();
+  static Level getLevel();
+  static const char *levelName(Level);
+  static void setLevel(Level);
+
+  static void stepBaseCases(const uint16_t *, uint8_t *, size_t,
+                            const Rule &);
+  static void stepRows(const uint64_t *, const uint64_t *, const uint64_t *,
+                       uint64_t *, size_t, const Rule &);
+
+private:
+  static Level level;
+};
+
+#endif // LIFEKERNEL_HPP
@@ -0,0 +1,36 @@
+#include "NodeHash.hpp"
+
+#if defined(__x86_64__)
+#define NODEHASH_CRC32
+#endif
+
+/**
+ * Returns whether the CPU has the SSE4.2 CRC32 instruction.
+ */
+static bool detectCrc32() {
+#ifdef NODEHASH_CRC32
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+#else
+  return false;
+#endif
+}
+
+const bool Crc32Hash::available = detectCrc32();
+
+/**
+ * Folds three words into a CRC32, only called where it is available.
+ */
+#ifdef NODEHASH_CRC32
+__attribute__((target("sse4.2")))
+#endif
+uint64_t
+Crc32Hash::crc(uint64_t north, uint64_t south, uint64_t shape) {
+#ifdef NODEHASH_CRC32
+  uint64_t hash = __builtin_ia32_crc32di(0xFFFFFFFF, north);
+  hash = __builtin_ia32_crc32di(hash, south);
+  return __builtin_ia32_crc32di(hash, shape);
+#else
+  return north ^ south ^ shape;
+#endif
+}
@@ -0,0 +1,131 @@
+#ifndef NODEHASH_HPP
+#define NODEHASH_HPP
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Hash policies for the node intern table. Each hashes a node from its
+ * shape (height and state) and the arena indices of its quads, which
+ * identify every distinct subtree, so no policy has to look further down.
+ * Each also hashes a node above the leaves from its quad indices and height
+ * alone, so the slot of a node can be found before the node is built.
+ * The policy the table uses is picked at compile time with NODE_HASH, and
+ * `./benchmark hashes` compares them all on the nodes of a real run.
+ */
+
+/**
+ * The original hash, weighting the quads by 29, 31, 37 and 41 and counting
+ * dead quads as 0. Nodes that only differ in which empty quads they hold
+ * collide, and its low bits are poorly spread.
+ */
+struct LegacyHash {
+  template <typename Node> size_t operator()(const Node &node) const {
+    if (node.height() == 0) {
+      return node.state();
+    }
+    return (*this)(node.nw()->alive() ? node.quad(0) : 0,
+                   node.ne()->alive() ? node.quad(1) : 0,
+                   node.sw()->alive() ? node.quad(2) : 0,
+                   node.se()->alive() ? node.quad(3) : 0, node.height());
+  }
+
+  // hashes a node above the leaves from its quad indices, as if every quad
+  // were alive, since telling would mean loading the quads
+  size_t operator()(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se,
+                    unsigned int) const {
+    return 29 * nw + 31 * ne + 37 * sw + 41 * se;
+  }
+};
+
+/**
+ * Multiplies each pair of quad indices by an odd constant and folds the
+ * high bits back down, as hashing pointers is usually done.
+ */
+struct MixHash {
+  template <typename Node> size_t operator()(const Node &node) const {
+    return mix(node.quad(0), node.quad(1), node.quad(2), node.quad(3),
+               node.height() << 8 | node.state());
+  }
+
+  size_t operator()(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se,
+                    unsigned int height) const {
+    return mix(nw, ne, sw, se, height << 8);
+  }
+
+  static size_t mix(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se,
+                    uint64_t shape) {
+    uint64_t north = nw | uint64_t(ne) << 32;
+    uint64_t south = sw | uint64_t(se) << 32;
+    uint64_t hash = north * 0x9E3779B97F4A7C15ull ^
+                    (south * 0xC2B2AE3D27D4EB4Full) >> 7 ^ shape;
+    hash ^= hash >> 32;
+    hash *= 0xD6E8FEB86659FD93ull;
+    return hash ^ hash >> 29;
+  }
+};
+
+/**
+ * wyhash's mixing: each pair of quad indices is multiplied into 128 bits by
+ * a secret, and the halves folded together with xor.
+ */
+struct WyHash {
+  static uint64_t mum(uint64_t a, uint64_t b) {
+    unsigned __int128 product = (unsigned __int128)a * b;
+    return uint64_t(product) ^ uint64_t(product >> 64);
+  }
+
+  template <typename Node> size_t operator()(const Node &node) const {
+    return mix(node.quad(0), node.quad(1), node.quad(2), node.quad(3),
+               node.height() << 8 | node.state());
+  }
+
+  size_t operator()(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se,
+                    unsigned int height) const {
+    return mix(nw, ne, sw, se, height << 8);
+  }
+
+  static size_t mix(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se,
+                    uint64_t shape) {
+    uint64_t north = nw | uint64_t(ne) << 32;
+    uint64_t south = sw | uint64_t(se) << 32;
+    uint64_t mixed =
+        mum(north ^ 0xA0761D6478BD642Full, south ^ 0xE7037ED1A0B428DBull);
+    return mum(mixed ^ shape, 0x8EBC6AF09C88C6E3ull);
+  }
+};
+
+/**
+ * Hashes the quad indices with the SSE4.2 CRC32 instruction where the CPU
+ * has it, falling back to MixHash elsewhere. Only the low 32 bits are set.
+ */
+struct Crc32Hash {
+  static const bool available;
+
+  static uint64_t crc(uint64_t, uint64_t, uint64_t);
+
+  template <typename Node> size_t operator()(const Node &node) const {
+    return mix(node.quad(0), node.quad(1), node.quad(2), node.quad(3),
+               node.height() << 8 | node.state());
+  }
+
+  size_t operator()(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se,
+                    unsigned int height) const {
+    return mix(nw, ne, sw, se, height << 8);
+  }
+
+  static size_t mix(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se,
+                    uint64_t shape) {
+    uint64_t north = nw | uint64_t(ne) << 32;
+    uint64_t south = sw | uint64_t(se) << 32;
+    if (available) {
+      return crc(north, south, shape);
+    }
+    return MixHash::mix(nw, ne, sw, se, shape);
+  }
+};
+
+#ifndef NODE_HASH
+#define NODE_HASH MixHash
+#endif
+
+#endif // NODEHASH_HPP
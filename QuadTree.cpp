@@ -1,11 +1,14 @@
 #include "QuadTree.hpp"
 
-QuadTree::QuadTree(std::vector<std::pair<int64_t, int64_t>> cells) {
+QuadTree::QuadTree(std::vector<std::pair<int64_t, int64_t>> cells)
+    : topology(PLANE), periodWindow(DEFAULT_PERIOD_WINDOW),
+      detectTranslation(false), historyLimit(DEFAULT_HISTORY_LIMIT) {
   root = QuadTreeNode::createEmptyAtHeight(1);
   updatePoints();
   for (auto const &point : cells) {
-    setCellAlive(point.first, point.second);
+    placeCell(point.first, point.second, 1);
   }
+  resetHistory();
 }
 
 QuadTree::QuadTree()
@@ -15,8 +18,141 @@ QuadTree::QuadTree()
   updatePoints();
 }
 
-QuadTree::QuadTree(QuadTreeNode *quadTreeNode) : root(quadTreeNode) {
+QuadTree::QuadTree(QuadTreeNode *quadTreeNode)
+    : root(quadTreeNode), topology(PLANE),
+      periodWindow(DEFAULT_PERIOD_WINDOW),
+      detectTranslation(false), historyLimit(DEFAULT_HISTORY_LIMIT) {
   updatePoints();
+  resetHistory();
+}
+
+/**
+ * Creates a bounded or toroidal universe of 2^height by 2^height cells.
+ */
+QuadTree::QuadTree(std::vector<std::pair<int64_t, int64_t>> cells,
+                   Topology topology, unsigned int height)
+    : topology(topology), periodWindow(DEFAULT_PERIOD_WINDOW),
+      detectTranslation(false), historyLimit(DEFAULT_HISTORY_LIMIT) {
+  if (height < 1 || height >= QuadTreeNode::MAX_HEIGHT) {
+    throw "Invalid universe size.";
+  }
+  root = QuadTreeNode::createEmptyAtHeight(height);
+  updatePoints();
+  for (auto const &point : cells) {
+    placeCell(point.first, point.second, 1);
+  }
+  resetHistory();
+}
+
+/**
+ * Steps the universe forward the given amount of generations, in one jump per
+ * set bit of the amount.
+ */
+void QuadTree::advance(uint64_t generations) {
+  for (unsigned int bit = 0; bit < 64; bit++) {
+    if ((generations >> bit) & 1) {
+      jump(bit);
+    }
+  }
+}
+
+/**
+ * Returns the smallest rectangle holding every cell that is not dead, which
+ * is empty if the universe is.
+ */
+Rect QuadTree::boundingBox() {
+  Rect box = Rect::empty();
+  root->extendBoundingBox(min, min, box);
+  return box;
+}
+
+/**
+ * Returns the cells born and died since an earlier root of this universe,
+ * such as one from its history, walking only the subtrees that changed.
+ */
+QuadTree::Changes QuadTree::changesSince(const QuadTreeNode *earlier) const {
+  const QuadTreeNode *later = root;
+  matchHeights(earlier, later);
+
+  Changes changes;
+  int64_t corner = cornerAtHeight(later->height());
+  earlier->appendChanges(later, corner, corner, changes.born, changes.died);
+  return changes;
+}
+
+/**
+ * Returns the squares of 2^regionHeight cells that changed since an earlier
+ * root, for redrawing only those.
+ */
+std::vector<Rect>
+QuadTree::changedRegionsSince(const QuadTreeNode *earlier,
+                              unsigned int regionHeight) const {
+  const QuadTreeNode *later = root;
+  matchHeights(earlier, later);
+
+  auto regions = std::vector<Rect>();
+  int64_t corner = cornerAtHeight(later->height());
+  earlier->appendChangedRegions(later, corner, corner, regionHeight, regions);
+  return regions;
+}
+
+/**
+ * Returns the north-west corner coordinate of a root of the given height,
+ * as roots are centered on the origin.
+ */
+int64_t QuadTree::cornerAtHeight(unsigned int height) {
+  if (height >= QuadTreeNode::MAX_HEIGHT) {
+    return INT64_MIN;
+  }
+  return height <= 0 ? 0 : -(int64_t(1) << (height - 1));
+}
+
+/**
+ * Grows the shorter of two roots until both are the same height, which
+ * keeps their cells in place as roots are centered.
+ */
+void QuadTree::matchHeights(const QuadTreeNode *&a, const QuadTreeNode *&b) {
+  while (a->height() < b->height()) {
+    a = a->grow();
+  }
+  while (b->height() < a->height()) {
+    b = b->grow();
+  }
+}
+
+/**
+ * Returns the amount of living cells inside of an inclusive rectangle.
+ */
+uint64_t QuadTree::populationIn(const Rect &box) {
+  if (box.isEmpty()) {
+    return 0;
+  }
+  return root->populationWithin(min, min, box);
+}
+
+/**
+ * Frees every node this universe can no longer reach, pinning the root, the
+ * roots kept to rewind through and those remembered for period detection.
+ * Nodes are shared by every universe, so only call this when no other
+ * universe holds nodes.
+ */
+size_t QuadTree::collectGarbage() {
+  return QuadTreeNode::collectGarbage(pinnedRoots());
+}
+
+/**
+ * Steps forward to the root that was rewound past, or one generation if
+ * there is none. Returns whether a remembered root was restored.
+ */
+bool QuadTree::forward() {
+  if (future.empty()) {
+    nextGeneration();
+    return false;
+  }
+  remember();
+  restore(future.back());
+  future.pop_back();
+  return true;
 }
 
 /**
@@ -30,6 +166,59 @@ bool QuadTree::getCellAlive(const int64_t x, const int64_t y) {
   }
 }
 
+/**
+ * Return the state of a point, which is only ever 0 or 1 outside of
+ * Generations rules.
+ */
+uint8_t QuadTree::getCellState(const int64_t x, const int64_t y) {
+  if (min <= x && x <= max && min <= y && y <= max) {
+    return root->getCellState(x, y);
+  } else {
+    return 0;
+  }
+}
+
+/**
+ * Returns the coordinates of every living cell, skipping empty regions of the
+ * tree.
+ */
+std::vector<std::pair<int64_t, int64_t>> QuadTree::getLivingCells() {
+  auto cells = std::vector<std::pair<int64_t, int64_t>>();
+  cells.reserve(root->population());
+  root->appendLivingCells(min, min, cells);
+  return cells;
+}
+
+/**
+ * Returns how far the universe moves each period, which is (0, 0) for an
+ * oscillator and only detected for spaceships once translation detection is
+ * on.
+ */
+std::pair<int64_t, int64_t> QuadTree::getDisplacement() const {
+  return displacement;
+}
+
+/**
+ * Returns the amount of generations stepped since the cells were last set.
+ */
+uint64_t QuadTree::getGeneration() const { return generation; }
+
+/**
+ * Returns the period the universe repeats with, or 0 if no repeat has been
+ * seen within the period window.
+ */
+uint64_t QuadTree::getPeriod() const { return period; }
+
+/**
+ * Returns how many roots that were rewound past can be stepped forward to.
+ */
+size_t QuadTree::futureSize() const { return future.size(); }
+
+/**
+ * Returns how many earlier roots can be rewound through.
+ */
+size_t QuadTree::historySize() const { return past.size(); }
+
 /**
  * Grow the root one additional level, update the points afterward.
  */
@@ -43,50 +232,415 @@ void QuadTree::growTree(unsigned int amount) {
 /**
  * Convenience method to return the root's height.
  */
-unsigned int QuadTree::height() { return root->height; }
+unsigned int QuadTree::height() { return root->height(); }
+
+/**
+ * Steps the universe forward 2^log2Steps generations at once with Hashlife's
+ * hyperspeed. Bounded universes clip cells every generation, so they step one
+ * generation at a time. Repeats are only looked for between single steps, so
+ * the remembered roots are forgotten, keeping any period already found.
+ */
+void QuadTree::jump(unsigned int log2Steps) {
+  if (log2Steps == 0) {
+    nextGeneration();
+    return;
+  }
+
+  if (topology == BOUNDED) {
+    for (uint64_t i = 0; i < uint64_t(1) << log2Steps; i++) {
+      nextGeneration();
+    }
+    return;
+  }
+
+  remember();
+  future.clear();
+  if (topology == TORUS) {
+    // the wrapped root tiles the torus with a margin of half a root on every
+    // side, so it can jump at most 2^(height - 1) generations at a time
+    unsigned int largest = root->height() - 1;
+    for (uint64_t i = 0; log2Steps > largest &&
+                         i < uint64_t(1) << (log2Steps - largest);
+         i++) {
+      root = root->wrap()->advance(largest);
+    }
+    if (log2Steps <= largest) {
+      root = root->wrap()->advance(log2Steps);
+    }
+  } else {
+    // cells travel at most one cell per generation, so the pattern needs a
+    // margin of 2^log2Steps cells inside of the center that is returned
+    root = root->compact();
+    root = root->grow()->grow();
+    while (root->height() < log2Steps + 3 &&
+           root->height() < QuadTreeNode::MAX_HEIGHT) {
+      root = root->grow();
+    }
+    root = root->advance(log2Steps)->compact();
+  }
+  updatePoints();
+  generation += uint64_t(1) << log2Steps;
+  forgetRoots();
+  recordRoot();
+  recordCheckpoint();
+}
+
+/**
+ * Returns the height of the root needed for a universe with the given side
+ * length, which must be a power of two.
+ */
+unsigned int QuadTree::heightForSize(uint64_t size) {
+  if (size < 2 || (size & (size - 1)) != 0) {
+    throw "Universe size must be a power of two.";
+  }
+  unsigned int height = 0;
+  while (size > 1) {
+    size >>= 1;
+    height++;
+  }
+  return height;
+}
 
 /**
  * Performs the main calculation, setting the root to be the next generation.
  * See the method in QuadTreeNode's implementation file for more information.
  */
 void QuadTree::nextGeneration() {
-  // by growing twice we are ensuring we have a center node with equal empty
-  // borders to its size allowing for expansion in nextGeneration
-  growTree(2);
-  root = root->nextGeneration()->compact();
+  remember();
+  future.clear();
+  if (topology == BOUNDED) {
+    // surrounding the root with dead cells clips anything leaving the edges,
+    // and the next generation is the same size as the root again
+    root = root->grow()->nextGeneration();
+  } else if (topology == TORUS) {
+    root = root->wrap()->nextGeneration();
+  } else {
+    // cells spread at most one cell per generation, so the root only grows
+    // while cells lie outside of its central quarter. The next generation is
+    // the root's central half, which keeps the root from growing any taller
+    // than the pattern needs without compacting it
+    while (!root->hasRoomToStep()) {
+      root = root->grow();
+    }
+    root = root->nextGeneration();
+    // cells past the edges of the 64-bit plane are dropped, and a universe
+    // that died out shrinks back to the smallest root
+    if (root->height() > QuadTreeNode::MAX_HEIGHT || !root->alive()) {
+      root = root->compact();
+    }
+  }
   updatePoints();
+  generation++;
+  recordRoot();
+  recordCheckpoint();
+}
+
+/**
+ * Returns the root in a form that only depends on the cells it holds. Nodes
+ * are hash-consed, so two universes with the same cells share this pointer.
+ */
+QuadTreeNode *QuadTree::normalizedRoot() const {
+  return topology == PLANE ? root->compact() : root;
+}
+
+/**
+ * Remembers the current root, and records the period if it was seen before.
+ * Stepping is deterministic, so once a root repeats the universe cycles
+ * through the same roots forever. Without a period window nothing is looked
+ * for, so the root isn't compacted either.
+ */
+void QuadTree::recordRoot() {
+  if (periodWindow == 0) {
+    return;
+  }
+  auto node = normalizedRoot();
+  auto seen = recentRoots.find(node);
+  if (seen != recentRoots.end()) {
+    period = generation - seen->second;
+    displacement = std::pair<int64_t, int64_t>(0, 0);
+    seen->second = generation;
+  } else {
+    recentRoots[node] = generation;
+    if (detectTranslation) {
+      recordShape();
+    }
+  }
+  rootOrder.push_back(std::make_pair(node, generation));
+
+  while (rootOrder.size() > periodWindow) {
+    auto oldest = rootOrder.front();
+    rootOrder.pop_front();
+    // a root seen again later keeps its newer entry
+    auto entry = recentRoots.find(oldest.first);
+    if (entry != recentRoots.end() && entry->second == oldest.second) {
+      recentRoots.erase(entry);
+    }
+  }
+}
+
+/**
+ * Remembers the live region cut out at its bounding box, and records the
+ * period and displacement if the same shape was seen before elsewhere. The
+ * cut out node only depends on the shape, so a translated repeat finds the
+ * same pointer. Roots too large to cut from without overflow are skipped.
+ */
+void QuadTree::recordShape() {
+  Rect box = boundingBox();
+  if (box.isEmpty() || root->height() >= 62) {
+    return;
+  }
+
+  uint64_t side = uint64_t(box.maxX - box.minX) > uint64_t(box.maxY - box.minY)
+                      ? uint64_t(box.maxX - box.minX)
+                      : uint64_t(box.maxY - box.minY);
+  unsigned int shapeHeight = 0;
+  while ((uint64_t(1) << shapeHeight) <= side) {
+    shapeHeight++;
+  }
+  auto shape =
+      root->extract(box.minX - min, box.minY - min, shapeHeight);
+
+  auto seen = recentShapes.find(shape);
+  if (seen != recentShapes.end()) {
+    period = generation - seen->second.generation;
+    displacement = std::pair<int64_t, int64_t>(box.minX - seen->second.x,
+                                               box.minY - seen->second.y);
+  }
+  recentShapes[shape] = Sighting{generation, box.minX, box.minY};
+  shapeOrder.push_back(std::make_pair(shape, generation));
+
+  while (shapeOrder.size() > periodWindow) {
+    auto oldest = shapeOrder.front();
+    shapeOrder.pop_front();
+    auto entry = recentShapes.find(oldest.first);
+    if (entry != recentShapes.end() &&
+        entry->second.generation == oldest.second) {
+      recentShapes.erase(entry);
+    }
+  }
+}
+
+/**
+ * Keeps the root as a checkpoint if the generation is a power of two. There
+ * are at most 64 of them, however far the universe runs.
+ */
+void QuadTree::recordCheckpoint() {
+  if ((generation & (generation - 1)) == 0) {
+    checkpoints[generation] = root;
+  }
+}
+
+/**
+ * Keeps the current root to rewind to, forgetting the oldest past the limit.
+ */
+void QuadTree::remember() {
+  if (historyLimit == 0) {
+    return;
+  }
+  past.push_back(std::make_pair(root, generation));
+  while (past.size() > historyLimit) {
+    past.pop_front();
+  }
+}
+
+/**
+ * Makes a remembered root current. Repeats are only looked for going
+ * forwards, so the roots remembered for that are forgotten, keeping any
+ * period already found.
+ */
+void QuadTree::restore(const std::pair<QuadTreeNode *, uint64_t> &entry) {
+  root = entry.first;
+  generation = entry.second;
+  updatePoints();
+  forgetRoots();
+  recordRoot();
+}
+
+/**
+ * Steps back to the previous root, returning false if there is none left.
+ * Rewinding costs nothing, as the roots are shared and immutable.
+ */
+bool QuadTree::rewind() {
+  if (past.empty()) {
+    return false;
+  }
+  future.push_back(std::make_pair(root, generation));
+  restore(past.back());
+  past.pop_back();
+  return true;
+}
+
+/**
+ * Forgets every remembered root and shape.
+ */
+void QuadTree::forgetRoots() {
+  recentRoots.clear();
+  rootOrder.clear();
+  recentShapes.clear();
+  shapeOrder.clear();
+}
+
+/**
+ * Forgets every remembered root, starting the generation count over from the
+ * current root.
+ */
+void QuadTree::resetHistory() {
+  generation = 0;
+  past.clear();
+  future.clear();
+  checkpoints.clear();
+  checkpoints[0] = root;
+  period = 0;
+  displacement = std::pair<int64_t, int64_t>(0, 0);
+  forgetRoots();
+  recordRoot();
+}
+
+/**
+ * Returns every root this universe still needs, for the garbage collector.
+ */
+std::vector<QuadTreeNode *> QuadTree::pinnedRoots() const {
+  auto roots = std::vector<QuadTreeNode *>{root};
+  for (auto const &entry : past) {
+    roots.push_back(entry.first);
+  }
+  for (auto const &entry : future) {
+    roots.push_back(entry.first);
+  }
+  for (auto const &entry : recentRoots) {
+    roots.push_back(entry.first);
+  }
+  for (auto const &entry : recentShapes) {
+    roots.push_back(entry.first);
+  }
+  for (auto const &entry : checkpoints) {
+    roots.push_back(entry.second);
+  }
+  return roots;
 }
 
 /**
  * Convenience method to return root's population.
  */
-uint64_t QuadTree::population() { return root->population; }
+uint64_t QuadTree::population() { return root->population(); }
 
 /**
  * Update the min and max variables to relate to the height. This performs some
  * checks to prevent integer roll-over.
  */
 void QuadTree::updatePoints() {
-  if (root->height >= QuadTreeNode::MAX_HEIGHT) {
+  if (root->height() >= QuadTreeNode::MAX_HEIGHT) {
     max = INT64_MAX;
     min = INT64_MIN;
   } else {
-    int64_t point = root->height <= 0 ? 0 : int64_t(1) << (root->height - 1);
+    min = cornerAtHeight(root->height());
+    max = -min - 1;
+  }
+}
 
-    max = point - 1;
-    min = -point;
+/**
+ * Moves the universe to any generation, earlier or later, starting from the
+ * closest checkpoint at or before it. From there it jumps by the largest
+ * power of two the generation is a multiple of that doesn't pass the target,
+ * which passes through every power of two on the way and so leaves
+ * checkpoints behind, reaching any generation in O(log N) jumps. History is
+ * linear, so seeking forgets the generations to rewind and step forward to.
+ */
+void QuadTree::seek(uint64_t target) {
+  if (target != generation) {
+    auto checkpoint = --checkpoints.upper_bound(target);
+    if (checkpoint->first > generation || target < generation) {
+      restore(std::make_pair(checkpoint->second, checkpoint->first));
+    }
   }
+  past.clear();
+  future.clear();
+
+  while (generation < target) {
+    unsigned int log2Steps = 63;
+    if (generation != 0) {
+      log2Steps = __builtin_ctzll(generation);
+    }
+    while ((uint64_t(1) << log2Steps) > target - generation) {
+      log2Steps--;
+    }
+    jump(log2Steps);
+  }
+  past.clear();
 }
 
 /**
  * Set a cell alive, growing the tree until the point exists within the tree.
  */
-void QuadTree::setCellAlive(int64_t x, int64_t y) {
-  while (true && root->height <= QuadTreeNode::MAX_HEIGHT) {
+void QuadTree::setCellAlive(int64_t x, int64_t y) { setCellState(x, y, 1); }
+
+/**
+ * Set a cell to the given state, growing the tree until the point exists
+ * within the tree, and start the history over from it.
+ */
+void QuadTree::setCellState(int64_t x, int64_t y, uint8_t state) {
+  placeCell(x, y, state);
+  resetHistory();
+}
+
+/**
+ * Sets a cell to the given state, growing the tree until the point exists
+ * within the tree, without touching the history, so that many cells can be
+ * placed before it is reset once. Bounded universes ignore cells outside of
+ * their edges, and toroidal ones wrap them around.
+ */
+void QuadTree::placeCell(int64_t x, int64_t y, uint8_t state) {
+  if (topology == TORUS) {
+    // the side length is a power of two, so wrapping is a mask of the offset
+    // from min, which is safe to take in unsigned arithmetic
+    uint64_t mask = uint64_t(max - min);
+    x = min + int64_t((uint64_t(x) - uint64_t(min)) & mask);
+    y = min + int64_t((uint64_t(y) - uint64_t(min)) & mask);
+  } else if (topology == BOUNDED &&
+             (x < min || x > max || y < min || y > max)) {
+    return;
+  }
+
+  while (true && root->height() <= QuadTreeNode::MAX_HEIGHT) {
     if (min <= x && x <= max && min <= y && y <= max) {
       break;
     }
     growTree(1);
   }
-  root = root->setCellAlive(x, y);
+  root = root->setCellState(x, y, state);
+}
+
+/**
+ * Turns detection of spaceships on or off. Cutting out the live region costs
+ * a walk along its edges every generation, so it is off by default and only
+ * roots repeating in place are detected.
+ */
+void QuadTree::setDetectTranslation(bool detect) {
+  if (detect && !detectTranslation) {
+    detectTranslation = true;
+    recordShape();
+  }
+  detectTranslation = detect;
+}
+
+/**
+ * Sets how many earlier roots are kept to rewind through, where 0 keeps none.
+ */
+void QuadTree::setHistoryLimit(size_t limit) {
+  historyLimit = limit;
+  while (past.size() > historyLimit) {
+    past.pop_front();
+  }
+}
+
+/**
+ * Sets how many recent roots are remembered when looking for a repeat, taking
+ * effect from the next generation. A window of 0 turns detection off and
+ * forgets the roots already remembered.
+ */
+void QuadTree::setPeriodWindow(size_t window) {
+  periodWindow = window;
+  if (periodWindow == 0) {
+    forgetRoots();
+  }
 }
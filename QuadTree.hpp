@@ -1,27 +1,119 @@
 #ifndef QUADTREE_HPP
 #define QUADTREE_HPP
 #include "QuadTreeNode.hpp"
+#include "Rect.hpp"
+#include "Universe.hpp"
 #include <cstdint>
+#include <deque>
+#include <map>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
-class QuadTree {
+class QuadTree : public Universe {
 public:
+  // an unbounded plane grows as needed, while bounded and toroidal universes
+  // keep a fixed size, clipping or wrapping cells at their edges
+  enum Topology { PLANE, BOUNDED, TORUS };
+
+  // how many recent roots are remembered when looking for a repeat, which
+  // bounds the longest period that can be detected
+  static const size_t DEFAULT_PERIOD_WINDOW = 4096;
+  // how many past roots are kept to rewind through, which costs little as
+  // successive roots share most of their nodes
+  static const size_t DEFAULT_HISTORY_LIMIT = 10000;
+
+  // the cells that came alive and died between two roots
+  struct Changes {
+    std::vector<std::pair<int64_t, int64_t>> born;
+    std::vector<std::pair<int64_t, int64_t>> died;
+  };
+
   int64_t min;
   int64_t max;
   QuadTreeNode *root;
+  Topology topology;
 
   QuadTree();
   QuadTree(QuadTreeNode *);
   QuadTree(std::vector<std::pair<int64_t, int64_t>>);
+  QuadTree(std::vector<std::pair<int64_t, int64_t>>, Topology, unsigned int);
+
+  static unsigned int heightForSize(uint64_t);
 
-  bool getCellAlive(int64_t, int64_t);
+  void advance(uint64_t);
+  Rect boundingBox() override;
+  Changes changesSince(const QuadTreeNode *) const;
+  std::vector<Rect> changedRegionsSince(const QuadTreeNode *,
+                                        unsigned int) const;
+  size_t collectGarbage();
+  bool forward();
+
+  bool getCellAlive(int64_t, int64_t) override;
+  uint8_t getCellState(int64_t, int64_t);
+  std::vector<std::pair<int64_t, int64_t>> getLivingCells() override;
   void growTree(unsigned int);
+  std::pair<int64_t, int64_t> getDisplacement() const;
+  uint64_t getGeneration() const;
+  uint64_t getPeriod() const;
+  size_t futureSize() const;
+  size_t historySize() const;
   unsigned int height();
-  void nextGeneration();
-  uint64_t population();
-  void setCellAlive(int64_t, int64_t);
+  void jump(unsigned int);
+  void nextGeneration() override;
+  std::vector<QuadTreeNode *> pinnedRoots() const;
+  uint64_t population() override;
+  uint64_t populationIn(const Rect &) override;
+  bool rewind();
+  void seek(uint64_t);
+  void setCellAlive(int64_t, int64_t) override;
+  void setCellState(int64_t, int64_t, uint8_t);
+  void setDetectTranslation(bool);
+  void setHistoryLimit(size_t);
+  void setPeriodWindow(size_t);
   void updatePoints();
+
+private:
+  // where a shape was last seen, being its generation and the north-west
+  // corner of its bounding box
+  struct Sighting {
+    uint64_t generation;
+    int64_t x;
+    int64_t y;
+  };
+
+  uint64_t generation;
+  uint64_t period; // 0 until the universe repeats
+  std::pair<int64_t, int64_t> displacement; // moved per period
+  size_t periodWindow;
+  bool detectTranslation;
+  // the generation each recent normalized root was last seen at, and the
+  // roots in the order they were seen so the oldest can be forgotten
+  std::unordered_map<QuadTreeNode *, uint64_t> recentRoots;
+  std::deque<std::pair<QuadTreeNode *, uint64_t>> rootOrder;
+  // the same for the live region cut out at its bounding box, which matches
+  // wherever the pattern has moved to
+  std::unordered_map<QuadTreeNode *, Sighting> recentShapes;
+  std::deque<std::pair<QuadTreeNode *, uint64_t>> shapeOrder;
+  // earlier roots with their generations, newest last, and the roots that
+  // were rewound past, next one last
+  std::deque<std::pair<QuadTreeNode *, uint64_t>> past;
+  std::vector<std::pair<QuadTreeNode *, uint64_t>> future;
+  size_t historyLimit;
+  // the roots at generation 0 and every power of two reached, to seek from
+  std::map<uint64_t, QuadTreeNode *> checkpoints;
+
+  void forgetRoots();
+  static int64_t cornerAtHeight(unsigned int);
+  static void matchHeights(const QuadTreeNode *&, const QuadTreeNode *&);
+  void recordCheckpoint();
+  QuadTreeNode *normalizedRoot() const;
+  void placeCell(int64_t, int64_t, uint8_t);
+  void recordRoot();
+  void recordShape();
+  void remember();
+  void resetHistory();
+  void restore(const std::pair<QuadTreeNode *, uint64_t> &);
 };
 
 #endif // QUADTREE_HPP
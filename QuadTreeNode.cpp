@@ -1,46 +1,118 @@
 #include "QuadTreeNode.hpp"
+#include "LifeKernel.hpp"
+#include "SharedArena.hpp"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sys/mman.h>
+#include <unordered_set>
 
-std::unordered_map<QuadTreeNode, QuadTreeNode *> QuadTreeNode::cache =
-    std::unordered_map<QuadTreeNode, QuadTreeNode *>();
+// the name of the hash policy, which processes sharing an arena must agree on
+#define NODE_HASH_NAME(policy) NODE_HASH_STRING(policy)
+#define NODE_HASH_STRING(policy) #policy
+
+// rules common enough to be worth their own compiled kernel, as birth and
+// survival masks (bit n set for n neighbors)
+static const uint16_t CONWAY_BIRTH = 1 << 3;
+static const uint16_t CONWAY_SURVIVAL = (1 << 2) | (1 << 3);
+static const uint16_t HIGHLIFE_BIRTH = (1 << 3) | (1 << 6);
+static const uint16_t DAY_AND_NIGHT_BIRTH =
+    (1 << 3) | (1 << 6) | (1 << 7) | (1 << 8);
+static const uint16_t DAY_AND_NIGHT_SURVIVAL =
+    (1 << 3) | (1 << 4) | (1 << 6) | (1 << 7) | (1 << 8);
+static const uint16_t SEEDS_BIRTH = 1 << 2;
+
+// the arena threads map when they make their first node, if it is shared,
+// and every shared arena this process has mapped, which stay mapped as long
+// as it runs since threads may still be using them
+static std::mutex sharingLock;
+static SharedArena *sharedDefault = nullptr;
+static std::vector<std::unique_ptr<SharedArena>> sharedArenas;
+
+const uint32_t QuadTreeNode::NONE;
+
+thread_local QuadTreeNode *QuadTreeNode::arena = nullptr;
+thread_local uint32_t QuadTreeNode::arenaCapacity = 0;
+thread_local uint32_t QuadTreeNode::arenaTop = NONE + 1;
+thread_local bool QuadTreeNode::viewing = false;
+thread_local uint64_t QuadTreeNode::collectionCount = 0;
+thread_local SharedArena *QuadTreeNode::shared = nullptr;
+thread_local std::vector<uint32_t> QuadTreeNode::freeSlots =
+    std::vector<uint32_t>();
+thread_local InternTable<QuadTreeNode, NODE_HASH> QuadTreeNode::cache =
+    InternTable<QuadTreeNode, NODE_HASH>();
+thread_local std::unordered_map<uint32_t, uint64_t>
+    QuadTreeNode::largePopulations =
+    std::unordered_map<uint32_t, uint64_t>();
+thread_local uint32_t QuadTreeNode::empties[QuadTreeNode::HEIGHT_MASK + 1] =
+    {};
+
+thread_local Rule QuadTreeNode::rule = Rule();
+
+thread_local QuadTreeNode::BaseKernel QuadTreeNode::baseKernel =
+    &QuadTreeNode::nextTotalistic<CONWAY_BIRTH, CONWAY_SURVIVAL>;
+
+thread_local std::vector<uint8_t> QuadTreeNode::baseTable =
+    std::vector<uint8_t>();
+
+thread_local QuadTreeNode::Stats QuadTreeNode::stats =
+    QuadTreeNode::Stats();
+
+std::atomic<bool> QuadTreeNode::prefetching(false);
+
+thread_local std::unordered_map<QuadTreeNode::JumpKey, QuadTreeNode *,
+                                QuadTreeNode::JumpKeyHash>
+    QuadTreeNode::jumps = std::unordered_map<QuadTreeNode::JumpKey,
+                                             QuadTreeNode *, JumpKeyHash>();
+
+static_assert(sizeof(QuadTreeNode) == 24, "QuadTreeNode should stay packed");
 
 /**
  * Creates a new leaf node.
- * @param alive if this node is living or dead
+ * @param state 0 if this node is dead, 1 if living, and above 1 if dying under
+ * a Generations rule
  */
-QuadTreeNode::QuadTreeNode(const bool alive)
-    : nw(nullptr), ne(nullptr), sw(nullptr), se(nullptr), alive(alive),
-      height(0), population(alive ? 1 : 0) {
-  next = nullptr;
-}
+QuadTreeNode::QuadTreeNode(const uint8_t state)
+    : quads{NONE, NONE, NONE, NONE}, nextIndex(NONE),
+      bits(uint32_t(state) | uint32_t(state != 0) << ALIVE_SHIFT |
+           uint32_t(state == 1) << POPULATION_SHIFT) {}
 
 /**
  * Creates a new non-leaf node composed of four child nodes, height being one
  * level up from the child nodes, population being the total population of the
- * children, and alive if any child node contains any living cells.
+ * children, and alive if any child node contains any living cells. The nodes
+ * must be in the arena, and a population that saturates is only known once
+ * the node is interned.
  * @param nw, ne, sw, se the four child nodes.
  */
 QuadTreeNode::QuadTreeNode(QuadTreeNode *nw, QuadTreeNode *ne, QuadTreeNode *sw,
                            QuadTreeNode *se)
-    : nw(nw), ne(ne), sw(sw), se(se),
-      alive(nw->alive || ne->alive || sw->alive || se->alive),
-      height(nw->height + 1), population(nw->population + ne->population +
-                                         sw->population + se->population) {
-  next = nullptr;
+    : quads{indexOf(nw), indexOf(ne), indexOf(sw), indexOf(se)},
+      nextIndex(NONE) {
+  uint32_t small = (nw->bits >> POPULATION_SHIFT) +
+                   (ne->bits >> POPULATION_SHIFT) +
+                   (sw->bits >> POPULATION_SHIFT) +
+                   (se->bits >> POPULATION_SHIFT);
+  bits = (nw->height() + 1) << HEIGHT_SHIFT |
+         uint32_t(nw->alive() || ne->alive() || sw->alive() || se->alive())
+             << ALIVE_SHIFT |
+         (small < SATURATED ? small : SATURATED) << POPULATION_SHIFT;
 }
 
 /**
  * Equality operator. Note that this does not care about next.
  */
 bool QuadTreeNode::operator==(const QuadTreeNode &other) const {
-  if (height != other.height) {
+  if (height() != other.height()) {
     return false;
   }
 
-  if (height == 0) {
-    return alive == other.alive;
+  if (height() == 0) {
+    return state() == other.state();
   }
 
-  return nw == other.nw && ne == other.ne && sw == other.sw && se == other.se;
+  return quads[0] == other.quads[0] && quads[1] == other.quads[1] &&
+         quads[2] == other.quads[2] && quads[3] == other.quads[3];
 }
 
 bool QuadTreeNode::operator!=(const QuadTreeNode &other) const {
@@ -49,61 +121,436 @@ bool QuadTreeNode::operator!=(const QuadTreeNode &other) const {
 
 /**
  * Static method returning an empty (all dead) node all the way down to the
- * leaves (height 0).
+ * leaves (height 0). Each height is interned once and then read back from
+ * the table of canonical empty nodes, without hashing.
  * @param the height at which to start building the empty nodes downwards.
  */
 QuadTreeNode *QuadTreeNode::createEmptyAtHeight(unsigned int height) {
-  if (height == 0) {
-    return retrieve(false);
+  if (height > HEIGHT_MASK) {
+    throw "Height too large for a node.";
+  }
+  if (empties[height] == NONE) {
+    QuadTreeNode *node;
+    if (height == 0) {
+      node = intern(QuadTreeNode(uint8_t(0)));
+    } else {
+      auto lower = createEmptyAtHeight(height - 1);
+      node = intern(QuadTreeNode(lower, lower, lower, lower));
+    }
+    empties[height] = indexOf(node);
+  }
+  return arena + empties[height];
+}
+
+/**
+ * Reserves address space for the arena without committing memory, which the
+ * system only backs as nodes are written. Smaller reservations are tried
+ * where the address space is limited. Threads started after the arena was
+ * shared map the shared one instead.
+ */
+void QuadTreeNode::reserveArena() {
+  static thread_local ArenaRelease release;
+  {
+    std::lock_guard<std::mutex> guard(sharingLock);
+    if (sharedDefault != nullptr) {
+      if (sharedDefault->rule() != rule.toString()) {
+        throw "The shared arena runs another rule.";
+      }
+      shared = sharedDefault;
+      arena = static_cast<QuadTreeNode *>(shared->nodes());
+      arenaCapacity = shared->capacity();
+      return;
+    }
+  }
+
+  for (uint64_t capacity = uint64_t(1) << 32; capacity >= 1 << 16;
+       capacity /= 2) {
+    void *memory = mmap(nullptr, capacity * sizeof(QuadTreeNode),
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory != MAP_FAILED) {
+      arena = static_cast<QuadTreeNode *>(memory);
+      arenaCapacity = uint32_t(capacity - 1);
+      return;
+    }
+  }
+  throw "Could not reserve memory for nodes.";
+}
+
+QuadTreeNode::ArenaRelease::~ArenaRelease() {
+  if (shared == nullptr && arena != nullptr) {
+    munmap(arena, (uint64_t(arenaCapacity) + 1) * sizeof(QuadTreeNode));
+  }
+  // the thread's tables are thread_local too and go with it, possibly
+  // before this does, so only the plain state is reset
+  shared = nullptr;
+  arena = nullptr;
+  arenaCapacity = 0;
+  arenaTop = NONE + 1;
+  std::fill(empties, empties + HEIGHT_MASK + 1, NONE);
+}
+
+QuadTreeNode::ArenaView::ArenaView(const QuadTreeNode *other)
+    : own(arena), wasViewing(viewing) {
+  arena = const_cast<QuadTreeNode *>(other);
+  viewing = viewing || other != own;
+}
+
+QuadTreeNode::ArenaView::~ArenaView() {
+  arena = own;
+  viewing = wasViewing;
+}
+
+/**
+ * Returns a free slot in the arena, reusing those freed by collectGarbage.
+ */
+uint32_t QuadTreeNode::allocate() {
+  if (viewing) {
+    throw "Nodes can't be made while viewing another thread's arena.";
+  }
+  if (!freeSlots.empty()) {
+    uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+    return index;
+  }
+  if (arena == nullptr) {
+    reserveArena();
+  }
+  if (shared != nullptr) {
+    return shared->allocate();
+  }
+  if (arenaTop >= arenaCapacity) {
+    throw "Out of node indices.";
   }
-  auto node = createEmptyAtHeight(height - 1);
-  return retrieve(node, node, node, node);
+  return arenaTop++;
 }
 
 /**
  * Given a quad tree node, look up the relevant pointer in the cache, or create
  * a new one, store it in the cache, and return it.
  */
-QuadTreeNode *const QuadTreeNode::intern(QuadTreeNode node) {
-  auto ret = cache[node];
+QuadTreeNode *const QuadTreeNode::intern(const QuadTreeNode &node) {
+  // the first node decides whether this thread's arena is the shared one
+  if (arena == nullptr && !viewing) {
+    reserveArena();
+  }
+  if (shared != nullptr) {
+    return internShared(node);
+  }
+  uint32_t found = cache.find(node, arena);
+  if (found != NONE) {
+    stats.internHits++;
+    return arena + found;
+  }
+
+  uint32_t index = allocate();
+  arena[index] = node;
+  if ((node.bits >> POPULATION_SHIFT) == SATURATED) {
+    largePopulations[index] = node.nw()->population() +
+                              node.ne()->population() +
+                              node.sw()->population() + node.se()->population();
+  }
+  cache.insert(index, arena);
+  stats.internMisses++;
+  return arena + index;
+}
+
+/**
+ * Interns a node in the shared arena. The slot is taken before the node is
+ * published, and when another thread or process publishes an equal node
+ * first, the slot was never seen by anyone and is kept for the next node.
+ */
+QuadTreeNode *const QuadTreeNode::internShared(const QuadTreeNode &node) {
+  uint32_t found = shared->find<QuadTreeNode, NODE_HASH>(node, arena);
+  if (found != NONE) {
+    stats.internHits++;
+    return arena + found;
+  }
 
-  if (!ret) {
-    ret = new QuadTreeNode(node);
-    cache[node] = ret;
+  uint32_t index = allocate();
+  arena[index] = node;
+  found = shared->insert<QuadTreeNode, NODE_HASH>(index, arena);
+  if (found != index) {
+    freeSlots.push_back(index);
+    stats.internHits++;
+    return arena + found;
   }
+  stats.internMisses++;
+  return arena + index;
+}
 
-  return ret;
+/**
+ * Returns the population of a node too large for its 16 bits. Nodes made by
+ * another thread or process aren't in this thread's side table, so their
+ * population is added up from their quads, and kept if this thread owns its
+ * table.
+ */
+uint64_t QuadTreeNode::largePopulation() const {
+  if (!viewing) {
+    auto found = largePopulations.find(indexOf(this));
+    if (found != largePopulations.end()) {
+      return found->second;
+    }
+  }
+  uint64_t total = nw()->population() + ne()->population() +
+                   sw()->population() + se()->population();
+  if (!viewing) {
+    largePopulations[indexOf(this)] = total;
+  }
+  return total;
 }
 
 /**
  * Create a return a new leaf node from the cache.
  */
 QuadTreeNode *const QuadTreeNode::retrieve(bool alive) {
-  return intern(QuadTreeNode(alive));
+  return alive ? intern(QuadTreeNode(uint8_t(1))) : createEmptyAtHeight(0);
+}
+
+/**
+ * Create or return a leaf node with the given state from the cache.
+ */
+QuadTreeNode *const QuadTreeNode::retrieveState(uint8_t state) {
+  return intern(QuadTreeNode(state));
 }
 
 /**
- * Create or return a new quad from the cache.
+ * Create or return a new quad from the cache. Four empty quads make the
+ * empty node one level up, which is taken from its table instead.
  */
 QuadTreeNode *const QuadTreeNode::retrieve(QuadTreeNode *nw, QuadTreeNode *ne,
                                            QuadTreeNode *sw, QuadTreeNode *se) {
+  if (!nw->alive() && !ne->alive() && !sw->alive() && !se->alive()) {
+    return createEmptyAtHeight(nw->height() + 1);
+  }
   return intern(QuadTreeNode(nw, ne, sw, se));
 }
 
+/**
+ * Returns the 2^(height - 1) square center of this node forward 2^log2Steps
+ * generations, which must be at most 2^(height - 2) for the result to be
+ * fully known. This is Hashlife's hyperspeed step: the center is advanced
+ * through nine overlapping sub-squares in two stages, where a full-size jump
+ * advances in both stages and a smaller one only in the second, so that every
+ * jump size of every node is memoized once.
+ */
+QuadTreeNode *const QuadTreeNode::advance(unsigned int log2Steps) {
+  if (log2Steps + 2 > height()) {
+    throw "Jump too large for the node.";
+  }
+  if (log2Steps == 0) {
+    return nextGeneration();
+  }
+  if (!alive()) {
+    return nw();
+  }
+
+  auto key = JumpKey(this, log2Steps);
+  if (shared != nullptr) {
+    uint32_t found = shared->findJump(indexOf(this), log2Steps);
+    if (found != NONE) {
+      return arena + found;
+    }
+  } else {
+    auto found = jumps.find(key);
+    if (found != jumps.end()) {
+      return found->second;
+    }
+  }
+
+  QuadTreeNode *squares[9] = {
+      nw(),
+      retrieve(nw()->ne(), ne()->nw(), nw()->se(), ne()->sw()),
+      ne(),
+      retrieve(nw()->sw(), nw()->se(), sw()->nw(), sw()->ne()),
+      retrieveCenteredChildren(),
+      retrieve(ne()->sw(), ne()->se(), se()->nw(), se()->ne()),
+      sw(),
+      retrieve(sw()->ne(), se()->nw(), sw()->se(), se()->sw()),
+      se()};
+
+  bool full = log2Steps + 2 == height();
+  QuadTreeNode *centers[9];
+  for (unsigned int i = 0; i < 9; i++) {
+    centers[i] = full ? squares[i]->advance(log2Steps - 1)
+                      : squares[i]->retrieveCenteredChildren();
+  }
+
+  unsigned int second = full ? log2Steps - 1 : log2Steps;
+  auto result = retrieve(
+      retrieve(centers[0], centers[1], centers[3], centers[4])->advance(second),
+      retrieve(centers[1], centers[2], centers[4], centers[5])->advance(second),
+      retrieve(centers[3], centers[4], centers[6], centers[7])->advance(second),
+      retrieve(centers[4], centers[5], centers[7], centers[8])
+          ->advance(second));
+  if (shared != nullptr) {
+    shared->insertJump(indexOf(this), log2Steps, indexOf(result));
+  } else {
+    jumps[key] = result;
+  }
+  return result;
+}
+
+/**
+ * Appends the coordinates of every living cell in this node to cells, given
+ * the coordinates of this node's north-west corner. Offsets are added in
+ * unsigned arithmetic, as the root can span the whole signed 64-bit range.
+ */
+void QuadTreeNode::appendLivingCells(
+    int64_t x, int64_t y,
+    std::vector<std::pair<int64_t, int64_t>> &cells) const {
+  if (population() == 0) {
+    return;
+  }
+  if (height() == 0) {
+    cells.push_back(std::pair<int64_t, int64_t>(x, y));
+    return;
+  }
+
+  uint64_t half = uint64_t(1) << (height() - 1);
+  int64_t midX = int64_t(uint64_t(x) + half);
+  int64_t midY = int64_t(uint64_t(y) + half);
+  nw()->appendLivingCells(x, y, cells);
+  ne()->appendLivingCells(midX, y, cells);
+  sw()->appendLivingCells(x, midY, cells);
+  se()->appendLivingCells(midX, midY, cells);
+}
+
+/**
+ * Appends the coordinates of the living cells inside box, given the
+ * coordinates of this node's north-west corner, skipping the quads that are
+ * empty or outside of it.
+ */
+void QuadTreeNode::appendLivingCellsWithin(
+    int64_t x, int64_t y, const Rect &box,
+    std::vector<std::pair<int64_t, int64_t>> &cells) const {
+  if (!alive()) {
+    return;
+  }
+
+  uint64_t span = height() >= 64 ? UINT64_MAX : (uint64_t(1) << height()) - 1;
+  int64_t farX = int64_t(uint64_t(x) + span);
+  int64_t farY = int64_t(uint64_t(y) + span);
+  if (farX < box.minX || x > box.maxX || farY < box.minY || y > box.maxY) {
+    return;
+  }
+  if (height() == 0) {
+    if (state() == 1) {
+      cells.push_back(std::pair<int64_t, int64_t>(x, y));
+    }
+    return;
+  }
+
+  uint64_t half = uint64_t(1) << (height() - 1);
+  int64_t midX = int64_t(uint64_t(x) + half);
+  int64_t midY = int64_t(uint64_t(y) + half);
+  nw()->appendLivingCellsWithin(x, y, box, cells);
+  ne()->appendLivingCellsWithin(midX, y, box, cells);
+  sw()->appendLivingCellsWithin(x, midY, box, cells);
+  se()->appendLivingCellsWithin(midX, midY, box, cells);
+}
+
+/**
+ * Appends the cells that are alive in later but not in this node to born,
+ * and those alive here but not in later to died, given the coordinates of
+ * both nodes' north-west corner. Both nodes must have the same height.
+ * Nodes are hash-consed, so identical subtrees are the same pointer and are
+ * skipped without looking inside, and only the changed parts are walked.
+ */
+void QuadTreeNode::appendChanges(
+    const QuadTreeNode *later, int64_t x, int64_t y,
+    std::vector<std::pair<int64_t, int64_t>> &born,
+    std::vector<std::pair<int64_t, int64_t>> &died) const {
+  if (this == later) {
+    return;
+  }
+  if (population() == 0) {
+    later->appendLivingCells(x, y, born);
+    return;
+  }
+  if (later->population() == 0) {
+    appendLivingCells(x, y, died);
+    return;
+  }
+  if (height() == 0) {
+    return; // both alive, differing only in how they got there
+  }
+
+  uint64_t half = uint64_t(1) << (height() - 1);
+  int64_t midX = int64_t(uint64_t(x) + half);
+  int64_t midY = int64_t(uint64_t(y) + half);
+  nw()->appendChanges(later->nw(), x, y, born, died);
+  ne()->appendChanges(later->ne(), midX, y, born, died);
+  sw()->appendChanges(later->sw(), x, midY, born, died);
+  se()->appendChanges(later->se(), midX, midY, born, died);
+}
+
+/**
+ * Appends the squares of 2^regionHeight cells, aligned to this node, where
+ * any cell's state differs between this node and later, given the
+ * coordinates of both nodes' north-west corner. Like appendChanges it only
+ * walks subtrees that differ, and suits redrawing just what changed.
+ */
+void QuadTreeNode::appendChangedRegions(const QuadTreeNode *later, int64_t x,
+                                        int64_t y, unsigned int regionHeight,
+                                        std::vector<Rect> &regions) const {
+  if (this == later) {
+    return;
+  }
+  if (height() <= regionHeight) {
+    uint64_t span = height() >= 64 ? UINT64_MAX : (uint64_t(1) << height()) - 1;
+    regions.push_back(Rect{x, y, int64_t(uint64_t(x) + span),
+                           int64_t(uint64_t(y) + span)});
+    return;
+  }
+
+  uint64_t half = uint64_t(1) << (height() - 1);
+  int64_t midX = int64_t(uint64_t(x) + half);
+  int64_t midY = int64_t(uint64_t(y) + half);
+  nw()->appendChangedRegions(later->nw(), x, y, regionHeight, regions);
+  ne()->appendChangedRegions(later->ne(), midX, y, regionHeight, regions);
+  sw()->appendChangedRegions(later->sw(), x, midY, regionHeight, regions);
+  se()->appendChangedRegions(later->se(), midX, midY, regionHeight, regions);
+}
+
 /**
  * Returns whether or not the portions of the quad along the border of this
  * quad's center are all dead.
  */
 bool QuadTreeNode::areBordersEmpty() const {
+  return bordersEmpty(nw(), ne(), sw(), se());
+}
+
+/**
+ * Returns whether the quads along the border of the center of the node made
+ * of these four quads are all dead, without interning that node.
+ */
+bool QuadTreeNode::bordersEmpty(const QuadTreeNode *nw, const QuadTreeNode *ne,
+                                const QuadTreeNode *sw,
+                                const QuadTreeNode *se) {
   return
       // check that everything but nw->se is empty
-      !nw->nw->alive && !nw->ne->alive && !nw->sw->alive &&
+      !nw->nw()->alive() && !nw->ne()->alive() && !nw->sw()->alive() &&
       // check that everything but ne->sw is empty
-      !ne->nw->alive && !ne->ne->alive && !ne->se->alive &&
+      !ne->nw()->alive() && !ne->ne()->alive() && !ne->se()->alive() &&
       // check that everything but sw->ne is empty
-      !sw->nw->alive && !sw->sw->alive && !sw->se->alive &&
+      !sw->nw()->alive() && !sw->sw()->alive() && !sw->se()->alive() &&
       // check that everything but se->nw is empty
-      !se->ne->alive && !se->sw->alive && !se->se->alive;
+      !se->ne()->alive() && !se->sw()->alive() && !se->se()->alive();
+}
+
+/**
+ * Returns whether every cell that is not dead lies in the central quarter of
+ * this node, so that its next generation, being its central half, holds
+ * every cell that can come alive. Nodes too small to have a central quarter
+ * never do. Only the liveness of quads is read, so nothing is interned.
+ */
+bool QuadTreeNode::hasRoomToStep() const {
+  if (height() <= MIN_GROWABLE) {
+    return false;
+  }
+  return areBordersEmpty() &&
+         bordersEmpty(nw()->se(), ne()->sw(), sw()->ne(), se()->nw());
 }
 
 /**
@@ -112,25 +559,106 @@ bool QuadTreeNode::areBordersEmpty() const {
  * less than the maximum height.
  */
 QuadTreeNode *const QuadTreeNode::compact() const {
-  if (height <= 1) {
+  if (height() <= 1) {
     return const_cast<QuadTreeNode *const>(this);
   }
+  if (!alive()) {
+    return createEmptyAtHeight(MIN_GROWABLE - 1);
+  }
 
-  auto node = QuadTreeNode::retrieve(nw, ne, sw, se);
+  auto node = const_cast<QuadTreeNode *>(this);
 
-  while (node->height > MAX_HEIGHT ||
-         (node->height >= MIN_GROWABLE && node->areBordersEmpty())) {
-    node = retrieve(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+  while (node->height() > MAX_HEIGHT ||
+         (node->height() >= MIN_GROWABLE && node->areBordersEmpty())) {
+    node = retrieve(node->nw()->se(), node->ne()->sw(), node->sw()->ne(),
+                    node->se()->nw());
   }
   return node;
 }
 
+/**
+ * Grows box to cover every cell in this node that is not dead, given the
+ * coordinates of this node's north-west corner. Quads lying inside the box
+ * already can't grow it, so they are skipped without being visited.
+ */
+void QuadTreeNode::extendBoundingBox(int64_t x, int64_t y, Rect &box) const {
+  if (!alive()) {
+    return;
+  }
+
+  uint64_t span = height() >= 64 ? UINT64_MAX : (uint64_t(1) << height()) - 1;
+  int64_t farX = int64_t(uint64_t(x) + span);
+  int64_t farY = int64_t(uint64_t(y) + span);
+  if (box.minX <= x && farX <= box.maxX && box.minY <= y && farY <= box.maxY) {
+    return;
+  }
+
+  if (height() == 0) {
+    box.minX = x < box.minX ? x : box.minX;
+    box.minY = y < box.minY ? y : box.minY;
+    box.maxX = x > box.maxX ? x : box.maxX;
+    box.maxY = y > box.maxY ? y : box.maxY;
+    return;
+  }
+
+  uint64_t half = uint64_t(1) << (height() - 1);
+  int64_t midX = int64_t(uint64_t(x) + half);
+  int64_t midY = int64_t(uint64_t(y) + half);
+  nw()->extendBoundingBox(x, y, box);
+  ne()->extendBoundingBox(midX, y, box);
+  sw()->extendBoundingBox(x, midY, box);
+  se()->extendBoundingBox(midX, midY, box);
+}
+
+/**
+ * Returns the 2^windowHeight square whose north-west corner is (x, y) from
+ * this node's north-west corner, where cells outside of this node are dead.
+ * Windows inside a single quad are taken from that quad, and whole aligned
+ * quads are reused, so only nodes along the window's edges are rebuilt.
+ * Only nodes below height 62 can be cut from, so offsets can't overflow.
+ */
+QuadTreeNode *const QuadTreeNode::extract(int64_t x, int64_t y,
+                                          unsigned int windowHeight) const {
+  int64_t size = int64_t(1) << height();
+  int64_t windowSize = int64_t(1) << windowHeight;
+  if (!alive() || x >= size || y >= size || x + windowSize <= 0 ||
+      y + windowSize <= 0) {
+    return createEmptyAtHeight(windowHeight);
+  }
+  if (windowHeight == height() && x == 0 && y == 0) {
+    return const_cast<QuadTreeNode *const>(this);
+  }
+
+  if (windowHeight < height()) {
+    int64_t half = size / 2;
+    bool west = x + windowSize <= half;
+    bool east = x >= half;
+    bool north = y + windowSize <= half;
+    bool south = y >= half;
+    if ((west || east) && (north || south)) {
+      auto quad = north ? (west ? nw() : ne()) : (west ? sw() : se());
+      return quad->extract(east ? x - half : x, south ? y - half : y,
+                           windowHeight);
+    }
+  }
+
+  // the window straddles quads, so build it from its own four quarters
+  int64_t halfWindow = windowSize / 2;
+  return retrieve(extract(x, y, windowHeight - 1),
+                  extract(x + halfWindow, y, windowHeight - 1),
+                  extract(x, y + halfWindow, windowHeight - 1),
+                  extract(x + halfWindow, y + halfWindow, windowHeight - 1));
+}
+
 /**
  * Returns the life state of a cell at coordinate (x,y)
  */
 bool QuadTreeNode::getCellAlive(int64_t x, int64_t y) const {
-  if (height == 0) {
-    return alive;
+  if (!alive()) {
+    return false;
+  }
+  if (height() == 0) {
+    return population() > 0;
   }
 
   // figure out how far off from center we are, so we can traverse into the
@@ -139,31 +667,106 @@ bool QuadTreeNode::getCellAlive(int64_t x, int64_t y) const {
 
   if (x < 0) {
     if (y < 0) {
-      if (nw->alive) {
-        return nw->getCellAlive(x + offset, y + offset);
-      } else {
-        return false;
-      }
+      return nw()->getCellAlive(x + offset, y + offset);
     } else {
-      if (sw->alive) {
-        return sw->getCellAlive(x + offset, y - offset);
-      } else {
-        return false;
-      }
+      return sw()->getCellAlive(x + offset, y - offset);
     }
   } else {
     if (y < 0) {
-      if (ne->alive) {
-        return ne->getCellAlive(x - offset, y + offset);
-      } else {
-        return false;
-      }
+      return ne()->getCellAlive(x - offset, y + offset);
     } else {
-      if (se->alive) {
-        return se->getCellAlive(x - offset, y - offset);
-      } else {
-        return false;
-      }
+      return se()->getCellAlive(x - offset, y - offset);
+    }
+  }
+}
+
+/**
+ * Returns whether this node and another of the same height hold the same
+ * cells inside of box, given the coordinates of their north-west corner. Both
+ * are walked side by side, and shared quads are the same without looking
+ * inside them, so only the quads that changed are visited.
+ */
+bool QuadTreeNode::sameCellsWithin(const QuadTreeNode *other, int64_t x,
+                                   int64_t y, const Rect &box) const {
+  if (this == other) {
+    return true;
+  }
+
+  uint64_t span = height() >= 64 ? UINT64_MAX : (uint64_t(1) << height()) - 1;
+  int64_t farX = int64_t(uint64_t(x) + span);
+  int64_t farY = int64_t(uint64_t(y) + span);
+  if (farX < box.minX || x > box.maxX || farY < box.minY || y > box.maxY) {
+    return true;
+  }
+  if (height() == 0) {
+    return state() == other->state();
+  }
+
+  uint64_t half = uint64_t(1) << (height() - 1);
+  int64_t midX = int64_t(uint64_t(x) + half);
+  int64_t midY = int64_t(uint64_t(y) + half);
+  return nw()->sameCellsWithin(other->nw(), x, y, box) &&
+         ne()->sameCellsWithin(other->ne(), midX, y, box) &&
+         sw()->sameCellsWithin(other->sw(), x, midY, box) &&
+         se()->sameCellsWithin(other->se(), midX, midY, box);
+}
+
+/**
+ * Returns the amount of living cells inside of box, given the coordinates of
+ * this node's north-west corner. Subtrees that are empty or miss the box are
+ * skipped and those wholly inside it answer with their population, so only
+ * nodes straddling the box's edges are walked.
+ */
+uint64_t QuadTreeNode::populationWithin(int64_t x, int64_t y,
+                                        const Rect &box) const {
+  if (population() == 0) {
+    return 0;
+  }
+
+  uint64_t span = height() >= 64 ? UINT64_MAX : (uint64_t(1) << height()) - 1;
+  int64_t farX = int64_t(uint64_t(x) + span);
+  int64_t farY = int64_t(uint64_t(y) + span);
+  if (farX < box.minX || x > box.maxX || farY < box.minY || y > box.maxY) {
+    return 0;
+  }
+  if (box.minX <= x && farX <= box.maxX && box.minY <= y && farY <= box.maxY) {
+    return population();
+  }
+
+  uint64_t half = uint64_t(1) << (height() - 1);
+  int64_t midX = int64_t(uint64_t(x) + half);
+  int64_t midY = int64_t(uint64_t(y) + half);
+  return nw()->populationWithin(x, y, box) +
+         ne()->populationWithin(midX, y, box) +
+         sw()->populationWithin(x, midY, box) +
+         se()->populationWithin(midX, midY, box);
+}
+
+/**
+ * Returns the state of a cell at coordinate (x,y), which is only ever 0 or 1
+ * outside of Generations rules.
+ */
+uint8_t QuadTreeNode::getCellState(int64_t x, int64_t y) const {
+  if (height() == 0) {
+    return state();
+  }
+  if (!alive()) {
+    return 0;
+  }
+
+  int64_t offset = getSeekOffset();
+
+  if (x < 0) {
+    if (y < 0) {
+      return nw()->getCellState(x + offset, y + offset);
+    } else {
+      return sw()->getCellState(x + offset, y - offset);
+    }
+  } else {
+    if (y < 0) {
+      return ne()->getCellState(x - offset, y + offset);
+    } else {
+      return se()->getCellState(x - offset, y - offset);
     }
   }
 }
@@ -174,7 +777,7 @@ bool QuadTreeNode::getCellAlive(int64_t x, int64_t y) const {
 int64_t QuadTreeNode::getSeekOffset() const {
   // since we can only input within signed 64-bit, we limit the offset height to
   // the max height
-  unsigned int thisHeight = height <= MAX_HEIGHT ? height : MAX_HEIGHT;
+  unsigned int thisHeight = height() <= MAX_HEIGHT ? height() : MAX_HEIGHT;
   // calculate how far off from the center we are (in terms of fourths, which is
   // why we shift by -2)
   int64_t shiftBy = thisHeight - 2 <= 0 ? 0 : thisHeight - 2;
@@ -183,14 +786,18 @@ int64_t QuadTreeNode::getSeekOffset() const {
 
 /**
  * Returns a new node that has been "grown" one level higher, with empty quads
- * accounting for all the new space.
+ * accounting for all the new space. An empty node grows into the next empty
+ * node without building anything.
  */
 QuadTreeNode *const QuadTreeNode::grow() const {
-  auto empty = QuadTreeNode::createEmptyAtHeight(height - 1);
-  auto newNW = retrieve(empty, empty, empty, nw);
-  auto newNE = retrieve(empty, empty, ne, empty);
-  auto newSW = retrieve(empty, sw, empty, empty);
-  auto newSE = retrieve(se, empty, empty, empty);
+  if (!alive()) {
+    return createEmptyAtHeight(height() + 1);
+  }
+  auto empty = QuadTreeNode::createEmptyAtHeight(height() - 1);
+  auto newNW = retrieve(empty, empty, empty, nw());
+  auto newNE = retrieve(empty, empty, ne(), empty);
+  auto newSW = retrieve(empty, sw(), empty, empty);
+  auto newSE = retrieve(se(), empty, empty, empty);
 
   return retrieve(newNW, newNE, newSW, newSE);
 }
@@ -199,7 +806,48 @@ QuadTreeNode *const QuadTreeNode::grow() const {
  * Return the next generation of this node's center.
  */
 QuadTreeNode *const QuadTreeNode::nextCenter() const {
-  return retrieve(nw->se, ne->sw, sw->ne, se->nw)->nextGeneration();
+  return retrieve(nw()->se(), ne()->sw(), sw()->ne(), se()->nw())
+      ->nextGeneration();
+}
+
+/**
+ * Starts loading what the nine sub-squares of nextGeneration are made of
+ * before the recursion needs it: the grandchildren, and the cache slots the
+ * five sub-squares straddling the quads are looked up in. Those slots are
+ * hashed from the grandchildren's indices, so only the quads themselves are
+ * read here, which the recursion reads next anyway. The misses of the rest
+ * then overlap, rather than each stalling the recursion in turn.
+ */
+void QuadTreeNode::prefetchSubSquares() const {
+  uint32_t grandchildren[4][4];
+  for (unsigned int i = 0; i < 4; i++) {
+    const uint32_t *quad = arena[quads[i]].quads;
+    for (unsigned int j = 0; j < 4; j++) {
+      grandchildren[i][j] = quad[j];
+      __builtin_prefetch(arena + quad[j]);
+    }
+  }
+
+  // the quads of the five sub-squares, by quad then grandchild, in nw, ne,
+  // sw, se order
+  static const uint8_t squares[5][4][2] = {
+      {{0, 1}, {1, 0}, {0, 3}, {1, 2}},
+      {{0, 2}, {0, 3}, {2, 0}, {2, 1}},
+      {{0, 3}, {1, 2}, {2, 1}, {3, 0}},
+      {{1, 2}, {1, 3}, {3, 0}, {3, 1}},
+      {{2, 1}, {3, 0}, {2, 3}, {3, 2}}};
+  unsigned int below = height() - 1;
+  for (auto const &square : squares) {
+    uint32_t nw = grandchildren[square[0][0]][square[0][1]];
+    uint32_t ne = grandchildren[square[1][0]][square[1][1]];
+    uint32_t sw = grandchildren[square[2][0]][square[2][1]];
+    uint32_t se = grandchildren[square[3][0]][square[3][1]];
+    if (shared != nullptr) {
+      shared->prefetch<NODE_HASH>(nw, ne, sw, se, below);
+    } else {
+      cache.prefetch(nw, ne, sw, se, below);
+    }
+  }
 }
 
 /**
@@ -207,55 +855,32 @@ QuadTreeNode *const QuadTreeNode::nextCenter() const {
  * forward in time one generation. This is done by recursively calculating the
  * centered node all the way down to the 2^1 square center. This method
  * short-circuits if the given node has a memoized version of its next
- * generation, or if its population is 0.
+ * generation, or if it has no cells that are not dead.
  */
 QuadTreeNode *const QuadTreeNode::nextGeneration() {
-  if (next != nullptr) {
-    return next;
+  // empty regions stay empty, and their center is already their nw quad
+  if (!alive()) {
+    return nw();
   }
-
-  // skip empty regions quickly
-  if (population == 0) {
-    next = nw;
-    return next;
+  // other threads may be memoizing the same node when the arena is shared,
+  // and its result must be seen after the nodes making it up
+  uint32_t memo = __atomic_load_n(&nextIndex, __ATOMIC_ACQUIRE);
+  if (memo != NONE) {
+    stats.nextHits++;
+    return arena + memo;
   }
+  stats.nextMisses++;
 
   // the bottom case - calculate the next living state of the inner center
-  if (height == MIN_GROWABLE) {
-    int64_t nwNeighbors = nw->population - nw->se->population +
-                          ne->populationWest() + sw->populationNorth() +
-                          se->nw->population;
-
-    int64_t neNeighbors = ne->population - ne->sw->population +
-                          nw->populationEast() + se->populationNorth() +
-                          sw->ne->population;
-
-    int64_t swNeighbors = sw->population - sw->ne->population +
-                          se->populationWest() + nw->populationSouth() +
-                          ne->sw->population;
-
-    int64_t seNeighbors = se->population - se->nw->population +
-                          sw->populationEast() + ne->populationSouth() +
-                          nw->se->population;
-
-    // this checks that a dead cell has 3 neighbors, or a living cell has 2
-    bool nwLives =
-        nwNeighbors == 3 || (nwNeighbors == 2 && nw->se->population > 0);
-    bool neLives =
-        neNeighbors == 3 || (neNeighbors == 2 && ne->sw->population > 0);
-    bool swLives =
-        swNeighbors == 3 || (swNeighbors == 2 && sw->ne->population > 0);
-    bool seLives =
-        seNeighbors == 3 || (seNeighbors == 2 && se->nw->population > 0);
-
-    auto newNW = retrieve(nwLives);
-    auto newNE = retrieve(neLives);
-    auto newSW = retrieve(swLives);
-    auto newSE = retrieve(seLives);
-
-    next = retrieve(newNW, newNE, newSW, newSE);
+  // using the kernel selected for the current rule
+  if (height() == MIN_GROWABLE) {
+    auto next = (this->*baseKernel)();
+    __atomic_store_n(&nextIndex, indexOf(next), __ATOMIC_RELEASE);
     return next;
   }
+  if (prefetching.load(std::memory_order_relaxed)) {
+    prefetchSubSquares();
+  }
 
   // break the center of the current node into 9 sub-squares:
   // n00 | n01 | n02
@@ -263,15 +888,15 @@ QuadTreeNode *const QuadTreeNode::nextGeneration() {
   // n10 | n11 | n12
   // ----+-----+----
   // n20 | n21 | n22
-  auto n00 = nw->nextGeneration();
-  auto n01 = nextHorizontal(nw, ne);
-  auto n02 = ne->nextGeneration();
-  auto n10 = nextVertical(nw, sw);
+  auto n00 = nw()->nextGeneration();
+  auto n01 = nextHorizontal(nw(), ne());
+  auto n02 = ne()->nextGeneration();
+  auto n10 = nextVertical(nw(), sw());
   auto n11 = nextCenter();
-  auto n12 = nextVertical(ne, se);
-  auto n20 = sw->nextGeneration();
-  auto n21 = nextHorizontal(sw, se);
-  auto n22 = se->nextGeneration();
+  auto n12 = nextVertical(ne(), se());
+  auto n20 = sw()->nextGeneration();
+  auto n21 = nextHorizontal(sw(), se());
+  auto n22 = se()->nextGeneration();
 
   // use the above 9 squares to get the four inner quads, representing the
   // 2^(height - 1) center of this node forward one generation, look at the
@@ -282,17 +907,208 @@ QuadTreeNode *const QuadTreeNode::nextGeneration() {
   auto nextSW = QuadTreeNode(n10, n11, n20, n21).retrieveCenteredChildren();
   auto nextSE = QuadTreeNode(n11, n12, n21, n22).retrieveCenteredChildren();
 
-  next = retrieve(nextNW, nextNE, nextSW, nextSE);
+  auto next = retrieve(nextNW, nextNE, nextSW, nextSE);
+  __atomic_store_n(&nextIndex, indexOf(next), __ATOMIC_RELEASE);
   return next;
 }
 
+/**
+ * Base case kernel for an outer-totalistic rule known at compile time. The
+ * neighbor counts are taken from the populations of the surrounding quads, so
+ * the rule check folds down to a constant mask test per cell.
+ */
+template <uint16_t Birth, uint16_t Survival>
+QuadTreeNode *const QuadTreeNode::nextTotalistic() const {
+  int64_t nwNeighbors = nw()->population() - nw()->se()->population() +
+                        ne()->populationWest() + sw()->populationNorth() +
+                        se()->nw()->population();
+
+  int64_t neNeighbors = ne()->population() - ne()->sw()->population() +
+                        nw()->populationEast() + se()->populationNorth() +
+                        sw()->ne()->population();
+
+  int64_t swNeighbors = sw()->population() - sw()->ne()->population() +
+                        se()->populationWest() + nw()->populationSouth() +
+                        ne()->sw()->population();
+
+  int64_t seNeighbors = se()->population() - se()->nw()->population() +
+                        sw()->populationEast() + ne()->populationSouth() +
+                        nw()->se()->population();
+
+  // a living cell survives on the survival mask, a dead one is born on the
+  // birth mask
+  bool nwLives =
+      ((nw()->se()->population() > 0 ? Survival : Birth) >> nwNeighbors) & 1;
+  bool neLives =
+      ((ne()->sw()->population() > 0 ? Survival : Birth) >> neNeighbors) & 1;
+  bool swLives =
+      ((sw()->ne()->population() > 0 ? Survival : Birth) >> swNeighbors) & 1;
+  bool seLives =
+      ((se()->nw()->population() > 0 ? Survival : Birth) >> seNeighbors) & 1;
+
+  return retrieve(retrieve(nwLives), retrieve(neLives), retrieve(swLives),
+                  retrieve(seLives));
+}
+
+/**
+ * Base case kernel for arbitrary rules, looking the 2x2 center up in the
+ * 4x4 -> 2x2 table generated when the rule was set.
+ */
+QuadTreeNode *const QuadTreeNode::nextFromTable() const {
+  uint8_t result = baseTable[baseIndex()];
+
+  return retrieve(retrieve((result & 1) != 0), retrieve((result & 2) != 0),
+                  retrieve((result & 4) != 0), retrieve((result & 8) != 0));
+}
+
+/**
+ * Base case kernel for Generations rules. The table gives which center cells
+ * the rule births or keeps from their living neighbors, and each cell's state
+ * then decides whether that is a birth, a survival, or if it ages instead.
+ */
+QuadTreeNode *const QuadTreeNode::nextGenerations() const {
+  uint8_t result = baseTable[baseIndex()];
+
+  return retrieve(
+      retrieveState(rule.nextState(nw()->se()->state(), (result & 1) != 0)),
+      retrieveState(rule.nextState(ne()->sw()->state(), (result & 2) != 0)),
+      retrieveState(rule.nextState(sw()->ne()->state(), (result & 4) != 0)),
+      retrieveState(rule.nextState(se()->nw()->state(), (result & 8) != 0)));
+}
+
+/**
+ * Packs the 4x4 cells of a height 2 node into a 16-bit index, row by row from
+ * the north-west corner, bit (y * 4 + x) being set if the cell at (x, y) is
+ * alive. Dying cells are left out, as they never count as neighbors.
+ */
+unsigned int QuadTreeNode::baseIndex() const {
+  return unsigned(nw()->nw()->population()) << 0 |
+         unsigned(nw()->ne()->population()) << 1 |
+         unsigned(ne()->nw()->population()) << 2 |
+         unsigned(ne()->ne()->population()) << 3 |
+         unsigned(nw()->sw()->population()) << 4 |
+         unsigned(nw()->se()->population()) << 5 |
+         unsigned(ne()->sw()->population()) << 6 |
+         unsigned(ne()->se()->population()) << 7 |
+         unsigned(sw()->nw()->population()) << 8 |
+         unsigned(sw()->ne()->population()) << 9 |
+         unsigned(se()->nw()->population()) << 10 |
+         unsigned(se()->ne()->population()) << 11 |
+         unsigned(sw()->sw()->population()) << 12 |
+         unsigned(sw()->se()->population()) << 13 |
+         unsigned(se()->sw()->population()) << 14 |
+         unsigned(se()->se()->population()) << 15;
+}
+
+/**
+ * Compiles a rule into the 4x4 -> 2x2 table used by the base case, indexed as
+ * in baseIndex. Bits 0 to 3 of each entry are the next states of the nw, ne,
+ * sw and se center cells. Totalistic rules step every 4x4 block as one batch
+ * through the vectorized kernel, while other rules look up each center's
+ * neighborhood in the rule.
+ */
+std::vector<uint8_t> QuadTreeNode::generateBaseTable(const Rule &rule) {
+  auto table = std::vector<uint8_t>(1 << 16, 0);
+  if (rule.totalistic) {
+    auto blocks = std::vector<uint16_t>(table.size());
+    for (unsigned int index = 0; index < blocks.size(); index++) {
+      blocks[index] = uint16_t(index);
+    }
+    LifeKernel::stepBaseCases(blocks.data(), table.data(), blocks.size(),
+                              rule);
+    return table;
+  }
+
+  for (unsigned int index = 0; index < table.size(); index++) {
+    for (unsigned int cell = 0; cell < 4; cell++) {
+      // gather the 3x3 neighborhood around the center cell at (x, y)
+      unsigned int x = 1 + (cell & 1);
+      unsigned int y = 1 + (cell >> 1);
+      unsigned int neighborhood = 0;
+      for (unsigned int dy = 0; dy < 3; dy++) {
+        for (unsigned int dx = 0; dx < 3; dx++) {
+          unsigned int bit = (y + dy - 1) * 4 + (x + dx - 1);
+          neighborhood |= ((index >> bit) & 1) << (dy * 3 + dx);
+        }
+      }
+      if (rule.next(neighborhood)) {
+        table[index] |= 1 << cell;
+      }
+    }
+  }
+  return table;
+}
+
+/**
+ * Returns whether nextGeneration prefetches ahead of its recursion.
+ */
+bool QuadTreeNode::getPrefetching() {
+  return prefetching.load(std::memory_order_relaxed);
+}
+
+/**
+ * Turns prefetching in nextGeneration on or off for every thread. It is off
+ * by default, as no win has been measured, even with the nodes far past the
+ * last level cache; ./benchmark recursion measures both ways.
+ */
+void QuadTreeNode::setPrefetching(bool enabled) {
+  prefetching.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * Returns the rule currently used to calculate generations.
+ */
+const Rule &QuadTreeNode::getRule() { return rule; }
+
+/**
+ * Sets the rule used to calculate generations. Common rules get a kernel
+ * specialized at compile time, anything else (including isotropic
+ * non-totalistic rules) is compiled into a lookup table.
+ * Since memoized generations are only valid for the rule they were computed
+ * with, changing the rule forgets all of them.
+ */
+void QuadTreeNode::setRule(const Rule &newRule) {
+  if (newRule == rule) {
+    return;
+  }
+  if (shared != nullptr) {
+    throw "The shared arena runs another rule.";
+  }
+  rule = newRule;
+
+  if (rule.states > 2) {
+    baseTable = generateBaseTable(rule);
+    baseKernel = &QuadTreeNode::nextGenerations;
+  } else if (rule.totalistic && rule.birth == CONWAY_BIRTH &&
+             rule.survival == CONWAY_SURVIVAL) {
+    baseKernel = &QuadTreeNode::nextTotalistic<CONWAY_BIRTH, CONWAY_SURVIVAL>;
+  } else if (rule.totalistic && rule.birth == HIGHLIFE_BIRTH &&
+             rule.survival == CONWAY_SURVIVAL) {
+    baseKernel = &QuadTreeNode::nextTotalistic<HIGHLIFE_BIRTH, CONWAY_SURVIVAL>;
+  } else if (rule.totalistic && rule.birth == DAY_AND_NIGHT_BIRTH &&
+             rule.survival == DAY_AND_NIGHT_SURVIVAL) {
+    baseKernel = &QuadTreeNode::nextTotalistic<DAY_AND_NIGHT_BIRTH,
+                                               DAY_AND_NIGHT_SURVIVAL>;
+  } else if (rule.totalistic && rule.birth == SEEDS_BIRTH &&
+             rule.survival == 0) {
+    baseKernel = &QuadTreeNode::nextTotalistic<SEEDS_BIRTH, 0>;
+  } else {
+    baseTable = generateBaseTable(rule);
+    baseKernel = &QuadTreeNode::nextFromTable;
+  }
+
+  cache.forEach([](uint32_t index) { arena[index].nextIndex = NONE; });
+  jumps.clear();
+}
+
 /**
  * Given two quads representing a left and right sides of a center, return the
  * next generation of their merged center.
  */
 QuadTreeNode *const QuadTreeNode::nextHorizontal(QuadTreeNode *const west,
                                                  QuadTreeNode *const east) {
-  return retrieve(west->ne, east->nw, west->se, east->sw)->nextGeneration();
+  return retrieve(west->ne(), east->nw(), west->se(), east->sw())
+      ->nextGeneration();
 }
 
 /**
@@ -302,35 +1118,36 @@ QuadTreeNode *const QuadTreeNode::nextHorizontal(QuadTreeNode *const west,
 QuadTreeNode *const QuadTreeNode::nextVertical(QuadTreeNode *north,
                                                QuadTreeNode *south) {
 
-  return retrieve(north->sw, north->se, south->nw, south->ne)->nextGeneration();
+  return retrieve(north->sw(), north->se(), south->nw(), south->ne())
+      ->nextGeneration();
 }
 
 /**
  * Returns the population from the two eastern quads.
  */
 uint64_t QuadTreeNode::populationEast() const {
-  return ne->population + se->population;
+  return ne()->population() + se()->population();
 }
 
 /**
  * Returns the population form the two northern quads.
  */
 uint64_t QuadTreeNode::populationNorth() const {
-  return nw->population + ne->population;
+  return nw()->population() + ne()->population();
 }
 
 /**
  * Returns the population from the two southern quads.
  */
 uint64_t QuadTreeNode::populationSouth() const {
-  return sw->population + se->population;
+  return sw()->population() + se()->population();
 }
 
 /**
  * Returns the population from the two western quads.
  */
 uint64_t QuadTreeNode::populationWest() const {
-  return nw->population + sw->population;
+  return nw()->population() + sw()->population();
 }
 
 /**
@@ -338,15 +1155,23 @@ uint64_t QuadTreeNode::populationWest() const {
  * of the childrens' centers.
  */
 QuadTreeNode *const QuadTreeNode::retrieveCenteredChildren() const {
-  return retrieve(nw->se, ne->sw, sw->ne, se->nw);
+  return retrieve(nw()->se(), ne()->sw(), sw()->ne(), se()->nw());
 }
 
 /**
- * Returns whether or not a given cell is alive or dead.
+ * Returns a new node with the given cell set alive.
  */
 QuadTreeNode *const QuadTreeNode::setCellAlive(int64_t x, int64_t y) const {
-  if (height == 0) {
-    return retrieve(true);
+  return setCellState(x, y, 1);
+}
+
+/**
+ * Returns a new node with the given cell set to the given state.
+ */
+QuadTreeNode *const QuadTreeNode::setCellState(int64_t x, int64_t y,
+                                               uint8_t state) const {
+  if (height() == 0) {
+    return retrieveState(state);
   }
 
   // calculate how far off from the center we are so we can traverse to the
@@ -355,15 +1180,184 @@ QuadTreeNode *const QuadTreeNode::setCellAlive(int64_t x, int64_t y) const {
 
   if (x < 0) {
     if (y < 0) {
-      return retrieve(nw->setCellAlive(x + offset, y + offset), ne, sw, se);
+      return retrieve(nw()->setCellState(x + offset, y + offset, state), ne(),
+                      sw(), se());
     } else {
-      return retrieve(nw, ne, sw->setCellAlive(x + offset, y - offset), se);
+      return retrieve(nw(), ne(),
+                      sw()->setCellState(x + offset, y - offset, state), se());
     }
   } else {
     if (y < 0) {
-      return retrieve(nw, ne->setCellAlive(x - offset, y + offset), sw, se);
+      return retrieve(nw(), ne()->setCellState(x - offset, y + offset, state),
+                      sw(), se());
+    } else {
+      return retrieve(nw(), ne(), sw(),
+                      se()->setCellState(x - offset, y - offset, state));
+    }
+  }
+}
+
+/**
+ * Returns a node one level higher tiled with copies of this node, offset so
+ * that this node sits in the center. Each quad of the result is this node
+ * with its quads swapped diagonally, and since the tiling is periodic the
+ * next generation of the center is this node on a torus.
+ */
+QuadTreeNode *const QuadTreeNode::wrap() const {
+  auto tile = retrieve(se(), sw(), ne(), nw());
+  return retrieve(tile, tile, tile, tile);
+}
+
+/**
+ * Returns the cache and next generation hit counts since the last reset.
+ */
+const QuadTreeNode::Stats &QuadTreeNode::getStats() { return stats; }
+
+/**
+ * Zeroes the cache and next generation hit counts.
+ */
+void QuadTreeNode::resetStats() { stats = Stats(); }
+
+/**
+ * Returns the bytes taken by the nodes in the arena, the intern table and the
+ * populations kept on the side, leaving out untouched reserved space.
+ */
+size_t QuadTreeNode::arenaBytes() {
+  if (shared != nullptr) {
+    return shared->bytes();
+  }
+  return size_t(arenaTop) * sizeof(QuadTreeNode) +
+         cache.bytes() +
+         freeSlots.capacity() * sizeof(uint32_t) +
+         largePopulations.size() * (sizeof(uint32_t) + sizeof(uint64_t));
+}
+
+/**
+ * Returns the amount of nodes in the cache, or in the shared arena.
+ */
+size_t QuadTreeNode::cacheSize() {
+  return shared != nullptr ? shared->size() : cache.size();
+}
+
+/**
+ * Returns whether the calling thread's nodes live in a shared arena.
+ */
+bool QuadTreeNode::arenaShared() { return shared != nullptr; }
+
+/**
+ * Maps the shared arena with the given name, making it with room for
+ * capacity nodes if no process has yet, for the calling thread and every
+ * thread that makes its first node from now on. Threads that already have
+ * nodes keep their own arenas, so the calling thread must not have made any.
+ * All of them must keep to the rule the arena was made under.
+ */
+void QuadTreeNode::shareArena(const std::string &name, uint32_t capacity) {
+  if (arena != nullptr) {
+    throw "Nodes were made on this thread before the arena was shared.";
+  }
+  std::lock_guard<std::mutex> guard(sharingLock);
+  sharedArenas.push_back(std::unique_ptr<SharedArena>(
+      new SharedArena(name, capacity, sizeof(QuadTreeNode), rule.toString(),
+                      NODE_HASH_NAME(NODE_HASH))));
+  sharedDefault = sharedArenas.back().get();
+}
+
+/**
+ * Makes threads that make their first node from now on get arenas of their
+ * own again. Threads already using the shared arena keep using it.
+ */
+void QuadTreeNode::stopSharingArena() {
+  std::lock_guard<std::mutex> guard(sharingLock);
+  sharedDefault = nullptr;
+}
+
+/**
+ * Returns how many garbage collections the calling thread has run, so that
+ * whoever keeps arena indices can tell when they may have been reused.
+ */
+uint64_t QuadTreeNode::collections() { return collectionCount; }
+
+/**
+ * Returns the arena index of every node in the cache.
+ */
+std::vector<uint32_t> QuadTreeNode::cachedIndices() {
+  auto indices = std::vector<uint32_t>();
+  indices.reserve(cache.size());
+  cache.forEach([&indices](uint32_t index) { indices.push_back(index); });
+  return indices;
+}
+
+/**
+ * Returns how full the cache is and how far its lookups probe under the
+ * NODE_HASH policy it was compiled with.
+ */
+TableDiagnostics QuadTreeNode::diagnoseCache() {
+  return cache.diagnose(arena);
+}
+
+/**
+ * Frees every node that can't be reached from the pinned nodes, returning how
+ * many were freed. Memoized next generations and jumps are dropped where they
+ * point at freed nodes rather than kept alive, as following them would keep
+ * every generation ever computed. Any node not reachable from a pin must not
+ * be used afterwards. Nothing is freed from a shared arena, as other
+ * processes may be holding any of its nodes.
+ */
+size_t QuadTreeNode::collectGarbage(const std::vector<QuadTreeNode *> &pinned) {
+  if (shared != nullptr) {
+    return 0;
+  }
+  collectionCount++;
+  auto marked = std::vector<bool>(arenaTop, false);
+  auto stack = std::vector<uint32_t>();
+  for (auto node : pinned) {
+    if (node != nullptr) {
+      stack.push_back(indexOf(node));
+    }
+  }
+  for (uint32_t empty : empties) {
+    if (empty != NONE) {
+      stack.push_back(empty);
+    }
+  }
+  while (!stack.empty()) {
+    uint32_t index = stack.back();
+    stack.pop_back();
+    if (marked[index]) {
+      continue;
+    }
+    marked[index] = true;
+    if (arena[index].height() > 0) {
+      stack.insert(stack.end(), arena[index].quads, arena[index].quads + 4);
+    }
+  }
+
+  size_t freed = 0;
+  auto live = std::vector<uint32_t>();
+  live.reserve(cache.size());
+  cache.forEach([&](uint32_t index) {
+    if (marked[index]) {
+      live.push_back(index);
+    } else {
+      largePopulations.erase(index);
+      freeSlots.push_back(index);
+      freed++;
+    }
+  });
+
+  cache.clear();
+  for (uint32_t index : live) {
+    cache.insert(index, arena);
+    if (!marked[arena[index].nextIndex]) {
+      arena[index].nextIndex = NONE;
+    }
+  }
+  for (auto jump = jumps.begin(); jump != jumps.end();) {
+    if (marked[indexOf(jump->first.first)] && marked[indexOf(jump->second)]) {
+      ++jump;
     } else {
-      return retrieve(nw, ne, sw, se->setCellAlive(x - offset, y - offset));
+      jump = jumps.erase(jump);
     }
   }
+  return freed;
 }
@@ -1,49 +1,215 @@
 #ifndef QUADTREENODE_HPP
 #define QUADTREENODE_HPP
+#include "InternTable.hpp"
+#include "NodeHash.hpp"
+#include "Rect.hpp"
+#include "Rule.hpp"
+#include <atomic>
 #include <cstdint>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+class SharedArena;
+
+/**
+ * A square of cells 2^height wide, hash-consed so that every distinct square
+ * exists once. Nodes live in one arena and refer to their children and
+ * memoized next generation by 32-bit index into it, with the height, state
+ * and liveness packed next to a 16-bit population, so a node takes 24 bytes.
+ * Populations too large for 16 bits are kept on the side, which only the few
+ * nodes covering tens of thousands of cells need.
+ * Every thread has its own arena, cache, memo and rule, so threads never
+ * contend, and nodes may only be used on the thread that made them, unless
+ * the arena is shared, when every thread and process mapping it shares one
+ * arena, cache and memo.
+ */
 class QuadTreeNode {
 public:
+  // counts of how often the cache and memoized next generations were reused,
+  // since the last resetStats
+  struct Stats {
+    uint64_t internHits;
+    uint64_t internMisses;
+    uint64_t nextHits;
+    uint64_t nextMisses;
+  };
+
   static QuadTreeNode *createEmptyAtHeight(unsigned int);
   static const unsigned int MAX_HEIGHT = 64;
   static const unsigned int MIN_GROWABLE = 2;
+  static const uint32_t NONE = 0; // the index of no node
 
-  QuadTreeNode *const nw;
-  QuadTreeNode *const ne;
-  QuadTreeNode *const sw;
-  QuadTreeNode *const se;
-
-  const bool alive;
-  const unsigned int height; // distance from leaves
-  const uint64_t population; // amount of living nodes lower down the tree
-
-  QuadTreeNode(bool);
+  QuadTreeNode(uint8_t);
   QuadTreeNode(QuadTreeNode *const, QuadTreeNode *const, QuadTreeNode *const,
                QuadTreeNode *const);
 
+  // the four quads, which leaves don't have
+  QuadTreeNode *nw() const { return arena + quads[0]; }
+  QuadTreeNode *ne() const { return arena + quads[1]; }
+  QuadTreeNode *sw() const { return arena + quads[2]; }
+  QuadTreeNode *se() const { return arena + quads[3]; }
+  // the arena index of quad i, in the order nw, ne, sw, se
+  uint32_t quad(unsigned int i) const { return quads[i]; }
+
+  // if any cell lower down the tree is not dead
+  bool alive() const { return (bits >> ALIVE_SHIFT) & 1; }
+  // leaf state, 1 being alive and above 1 dying under Generations rules
+  uint8_t state() const { return uint8_t(bits); }
+  // distance from leaves
+  unsigned int height() const { return (bits >> HEIGHT_SHIFT) & HEIGHT_MASK; }
+  // amount of living cells lower down the tree
+  uint64_t population() const {
+    uint32_t small = bits >> POPULATION_SHIFT;
+    return small < SATURATED ? small : largePopulation();
+  }
+
+  static uint32_t indexOf(const QuadTreeNode *node) {
+    return uint32_t(node - arena);
+  }
+  static const QuadTreeNode *getArena() { return arena; }
+
+  // points the calling thread at another thread's arena, as returned by
+  // getArena there, until it goes out of scope, so it can read nodes that
+  // thread keeps from garbage collection meanwhile. Nothing can be made or
+  // stepped through a view, as the cache stays the other thread's
+  class ArenaView {
+  public:
+    ArenaView(const QuadTreeNode *);
+    ArenaView(const ArenaView &) = delete;
+    ArenaView &operator=(const ArenaView &) = delete;
+    ~ArenaView();
+
+  private:
+    QuadTreeNode *own;
+    bool wasViewing;
+  };
+
   bool operator==(const QuadTreeNode &) const;
   bool operator!=(const QuadTreeNode &) const;
 
   static QuadTreeNode *const retrieve(bool);
+  static QuadTreeNode *const retrieveState(uint8_t);
   static QuadTreeNode *const retrieve(QuadTreeNode *const, QuadTreeNode *const,
                                       QuadTreeNode *const, QuadTreeNode *const);
 
+  QuadTreeNode *const advance(unsigned int);
+  void appendLivingCells(int64_t, int64_t,
+                         std::vector<std::pair<int64_t, int64_t>> &) const;
+  void appendLivingCellsWithin(int64_t, int64_t, const Rect &,
+                               std::vector<std::pair<int64_t, int64_t>> &)
+      const;
+  void appendChanges(const QuadTreeNode *, int64_t, int64_t,
+                     std::vector<std::pair<int64_t, int64_t>> &,
+                     std::vector<std::pair<int64_t, int64_t>> &) const;
+  void appendChangedRegions(const QuadTreeNode *, int64_t, int64_t,
+                            unsigned int, std::vector<Rect> &) const;
   QuadTreeNode *const compact() const;
+  void extendBoundingBox(int64_t, int64_t, Rect &) const;
+  QuadTreeNode *const extract(int64_t, int64_t, unsigned int) const;
   bool getCellAlive(int64_t, int64_t) const;
+  bool sameCellsWithin(const QuadTreeNode *, int64_t, int64_t,
+                       const Rect &) const;
+  uint8_t getCellState(int64_t, int64_t) const;
+  uint64_t populationWithin(int64_t, int64_t, const Rect &) const;
   QuadTreeNode *const grow() const;
+  bool hasRoomToStep() const;
   QuadTreeNode *const nextGeneration();
   QuadTreeNode *const setCellAlive(int64_t, int64_t) const;
+  QuadTreeNode *const setCellState(int64_t, int64_t, uint8_t) const;
+  QuadTreeNode *const wrap() const;
+
+  static size_t arenaBytes();
+  static size_t cacheSize();
+  static std::vector<uint32_t> cachedIndices();
+  static TableDiagnostics diagnoseCache();
+  static size_t collectGarbage(const std::vector<QuadTreeNode *> &);
+  static uint64_t collections();
+
+  static bool arenaShared();
+  static void shareArena(const std::string &, uint32_t);
+  static void stopSharingArena();
+
+  static std::vector<uint8_t> generateBaseTable(const Rule &);
+  static bool getPrefetching();
+  static void setPrefetching(bool);
+  static const Rule &getRule();
+  static void setRule(const Rule &);
+  static const Stats &getStats();
+  static void resetStats();
 
 private:
-  static std::unordered_map<QuadTreeNode, QuadTreeNode *> cache;
-
-  static QuadTreeNode *const intern(QuadTreeNode);
+  // bits holds the state in its low byte, then the height, whether alive,
+  // and the population, which saturates at SATURATED
+  static const unsigned int HEIGHT_SHIFT = 8;
+  static const uint32_t HEIGHT_MASK = 0x7F;
+  static const unsigned int ALIVE_SHIFT = 15;
+  static const unsigned int POPULATION_SHIFT = 16;
+  static const uint32_t SATURATED = 0xFFFF;
+
+  typedef QuadTreeNode *const (QuadTreeNode::*BaseKernel)() const;
+  typedef std::pair<const QuadTreeNode *, unsigned int> JumpKey;
+
+  struct JumpKeyHash {
+    size_t operator()(const JumpKey &key) const {
+      return std::hash<const QuadTreeNode *>()(key.first) * 31 + key.second;
+    }
+  };
+
+  // every node, indexed by the quads of the others. Slot NONE is never used,
+  // and freed slots are reused before the arena grows
+  static thread_local QuadTreeNode *arena;
+  static thread_local uint32_t arenaCapacity;
+  static thread_local uint32_t arenaTop;
+  // while an ArenaView is open, which leaves the thread unable to make nodes
+  static thread_local bool viewing;
+  // garbage collections so far, after which freed indices may be reused
+  static thread_local uint64_t collectionCount;
+  // the shared arena the thread's nodes live in, if any, in place of the
+  // cache
+  static thread_local SharedArena *shared;
+  static thread_local std::vector<uint32_t> freeSlots;
+  // the index of every interned node, hashed with the NODE_HASH policy
+  static thread_local InternTable<QuadTreeNode, NODE_HASH> cache;
+  static thread_local std::unordered_map<uint32_t, uint64_t>
+      largePopulations;
+  // the canonical empty node at every height, NONE until first asked for.
+  // Nothing dead but empty nodes, so a node is empty exactly if it is not
+  // alive, and these are pinned through garbage collection
+  static thread_local uint32_t empties[HEIGHT_MASK + 1];
+  static thread_local Rule rule;
+  static thread_local BaseKernel baseKernel;
+  static thread_local std::vector<uint8_t> baseTable;
+  static thread_local Stats stats;
+  // whether nextGeneration prefetches the nodes and cache slots of its
+  // sub-squares, for every thread, off unless asked for. Threads only read
+  // it as a hint, so it is loaded relaxed
+  static std::atomic<bool> prefetching;
+  // memoized jumps of more than one generation, keyed by node and the log2 of
+  // the amount of generations, as next only holds a single generation
+  static thread_local std::unordered_map<JumpKey, QuadTreeNode *, JumpKeyHash>
+      jumps;
+
+  static QuadTreeNode *const intern(const QuadTreeNode &);
+  static QuadTreeNode *const internShared(const QuadTreeNode &);
+  static uint32_t allocate();
+  static void reserveArena();
+
+  // hands the calling thread's arena back to the system when it exits
+  struct ArenaRelease {
+    ~ArenaRelease();
+  };
+
+  uint32_t quads[4];
+  uint32_t nextIndex; // memoized next generation, NONE until calculated
+  uint32_t bits;
 
   bool areBordersEmpty() const;
+  static bool bordersEmpty(const QuadTreeNode *, const QuadTreeNode *,
+                           const QuadTreeNode *, const QuadTreeNode *);
   int64_t getSeekOffset() const;
-
-  QuadTreeNode *next;
+  uint64_t largePopulation() const;
 
   uint64_t populationWest() const;
   uint64_t populationEast() const;
@@ -58,24 +224,13 @@ private:
 
   QuadTreeNode *const retrieveCenteredChildren() const;
   QuadTreeNode *const nextCenter() const;
-};
+  void prefetchSubSquares() const;
 
-/**
- * Injects the hash function for QuadTreeNode into the standard namespace,
- * advice taken from StackOverflow (TODO: refind answer to link from here).
- */
-namespace std {
-template <> struct hash<QuadTreeNode> {
-  size_t operator()(const QuadTreeNode &node) const {
-    if (node.height == 0) {
-      return hash<uint64_t>()(node.population);
-    }
-    return 29 * (node.nw->alive ? hash<QuadTreeNode>()(*node.nw) : 0) +
-           31 * (node.ne->alive ? hash<QuadTreeNode>()(*node.ne) : 0) +
-           37 * (node.sw->alive ? hash<QuadTreeNode>()(*node.sw) : 0) +
-           41 * (node.se->alive ? hash<QuadTreeNode>()(*node.se) : 0);
-  }
+  template <uint16_t Birth, uint16_t Survival>
+  QuadTreeNode *const nextTotalistic() const;
+  QuadTreeNode *const nextFromTable() const;
+  QuadTreeNode *const nextGenerations() const;
+  unsigned int baseIndex() const;
 };
-}
 
 #endif // QUADTREENODE_HPP
@@ -0,0 +1,370 @@
+#include "QueryServer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Listens on a Unix domain socket at path, replacing any left behind by an
+ * earlier server. Saves only go to files directly in saveDirectory, and an
+ * empty one turns them off. Nothing is answered until run is called, on the
+ * thread that made the tree's nodes.
+ */
+QueryServer::QueryServer(QuadTree &tree, const std::string &path,
+                         const std::string &saveDirectory)
+    : tree(tree), path(path), saveDirectory(saveDirectory), listener(-1),
+      stopping(false) {
+  sockaddr_un address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    throw "Socket path is empty or too long.";
+  }
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    throw "Could not create the query socket.";
+  }
+  unlink(path.c_str());
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) != 0 ||
+      listen(listener, SOMAXCONN) != 0) {
+    close(listener);
+    throw "Could not listen on the query socket.";
+  }
+}
+
+QueryServer::~QueryServer() {
+  close(listener);
+  unlink(path.c_str());
+}
+
+/**
+ * Returns the reply to one request line, without its newline. Steps wait
+ * for the stepping thread, and everything else reads the latest snapshot.
+ */
+std::string QueryServer::answer(const std::string &request) {
+  std::istringstream fields(request);
+  std::string command;
+  fields >> command;
+
+  auto arguments = [&](std::vector<int64_t> &values) {
+    for (auto &value : values) {
+      if (!(fields >> value)) {
+        return false;
+      }
+    }
+    std::string extra;
+    return !(fields >> extra);
+  };
+
+  try {
+    if (command == "step") {
+      auto values = std::vector<int64_t>(1);
+      if (!arguments(values) || values[0] < 0) {
+        return "error step takes a generation count.";
+      }
+      return step(values[0]);
+    }
+    if (command == "stop") {
+      return "ok";
+    }
+
+    auto values = std::vector<int64_t>(command == "region" ? 4 : 0);
+    std::string file;
+    if (command == "save") {
+      if (saveDirectory.empty()) {
+        return "error Saving is off, start the server with --save-dir.";
+      }
+      if (!(fields >> file) || file == "." || file == ".." ||
+          file.find('/') != std::string::npos) {
+        return "error save takes a file name without a directory.";
+      }
+      file = saveDirectory + "/" + file;
+    }
+    if (!arguments(values)) {
+      return "error Wrong arguments for " + command + ".";
+    }
+
+    auto current = snapshot();
+    QuadTreeNode::ArenaView view(current->arena);
+    std::ostringstream reply;
+    reply << "ok";
+    if (command == "generation") {
+      reply << " " << current->generation;
+    } else if (command == "population") {
+      reply << " " << current->population;
+    } else if (command == "bbox") {
+      Rect box = Rect::empty();
+      current->root->extendBoundingBox(current->corner, current->corner, box);
+      if (box.isEmpty()) {
+        reply << " empty";
+      } else {
+        reply << " " << box.minX << " " << box.minY << " " << box.maxX << " "
+              << box.maxY;
+      }
+    } else if (command == "region") {
+      auto cells = std::vector<std::pair<int64_t, int64_t>>();
+      current->root->appendLivingCellsWithin(
+          current->corner, current->corner,
+          Rect{values[0], values[1], values[2], values[3]}, cells);
+      reply << " " << cells.size();
+      for (auto const &cell : cells) {
+        reply << " " << cell.first << " " << cell.second;
+      }
+    } else if (command == "save") {
+      auto cells = std::vector<std::pair<int64_t, int64_t>>();
+      cells.reserve(current->population);
+      current->root->appendLivingCells(current->corner, current->corner,
+                                       cells);
+      std::ofstream out(file);
+      for (auto const &cell : cells) {
+        out << "(" << cell.first << ", " << cell.second << ")\n";
+      }
+      if (!out) {
+        return "error Could not write " + file + ".";
+      }
+      reply << " " << cells.size();
+    } else {
+      return "error Unknown request " + command + ".";
+    }
+    return reply.str();
+  } catch (const char *e) {
+    return std::string("error ") + e;
+  }
+}
+
+/**
+ * Serves requests until stop is called, stepping the universe on the calling
+ * thread, which must be the one that made its nodes. Returns once every
+ * connection is closed.
+ */
+void QueryServer::run() {
+  publish();
+  acceptor = std::thread(&QueryServer::accept, this);
+
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    wake.wait(guard, [&]() { return stopping || !steps.empty(); });
+    if (stopping) {
+      break;
+    }
+    auto next = steps.front();
+    steps.pop_front();
+    guard.unlock();
+
+    std::string reply;
+    try {
+      if (tooLong(next->generations)) {
+        throw "Too many generations to step this universe at once.";
+      }
+      tree.advance(next->generations);
+      if (QuadTreeNode::cacheSize() > GARBAGE_LIMIT) {
+        collectGarbage();
+      }
+      publish();
+      reply = "ok " + std::to_string(tree.getGeneration());
+    } catch (const char *e) {
+      reply = std::string("error ") + e;
+    }
+    next->reply.set_value(reply);
+    guard.lock();
+  }
+  for (auto &pending : steps) {
+    pending->reply.set_value("error The server is stopping.");
+  }
+  steps.clear();
+  guard.unlock();
+
+  acceptor.join();
+  // the connections read this thread's arena, so they must all be done
+  // before it can go
+  auto closing = std::list<Connection>();
+  guard.lock();
+  closing.splice(closing.end(), connections);
+  guard.unlock();
+  for (auto &connection : closing) {
+    connection.thread.join();
+  }
+}
+
+/**
+ * Makes run return, closing the socket and every connection. Safe to call
+ * from any thread, and more than once.
+ */
+void QueryServer::stop() {
+  std::lock_guard<std::mutex> guard(lock);
+  stopping = true;
+  shutdown(listener, SHUT_RDWR);
+  for (auto &connection : connections) {
+    if (connection.socket >= 0) {
+      shutdown(connection.socket, SHUT_RDWR);
+    }
+  }
+  wake.notify_all();
+}
+
+/**
+ * Takes connections until the server stops, serving each on its own thread
+ * and joining those that have closed.
+ */
+void QueryServer::accept() {
+  while (true) {
+    int client = ::accept(listener, nullptr, nullptr);
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto connection = connections.begin();
+         connection != connections.end();) {
+      if (connection->done) {
+        connection->thread.join();
+        connection = connections.erase(connection);
+      } else {
+        ++connection;
+      }
+    }
+    if (stopping) {
+      if (client >= 0) {
+        close(client);
+      }
+      return;
+    }
+    if (client < 0) {
+      continue;
+    }
+
+    connections.emplace_back();
+    Connection &connection = connections.back();
+    connection.socket = client;
+    connection.done = false;
+    connection.thread = std::thread(&QueryServer::serve, this,
+                                    std::ref(connection));
+  }
+}
+
+/**
+ * Keeps the nodes of the tree and of every snapshot still being read, and
+ * collects the rest. Snapshots are only handed out under the lock, and the
+ * latest is always kept, so none can be picked up once this has looked.
+ */
+void QueryServer::collectGarbage() {
+  auto pinned = tree.pinnedRoots();
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto held = std::vector<std::weak_ptr<const Snapshot>>();
+    for (auto const &weak : published) {
+      auto snapshot = weak.lock();
+      if (snapshot) {
+        pinned.push_back(snapshot->root);
+        held.push_back(weak);
+      }
+    }
+    published.swap(held);
+  }
+  QuadTreeNode::collectGarbage(pinned);
+}
+
+/**
+ * Makes the tree's root the latest snapshot, counting its population here,
+ * where the populations of large nodes are kept rather than added up again.
+ */
+void QueryServer::publish() {
+  auto next = std::make_shared<const Snapshot>(
+      Snapshot{QuadTreeNode::getArena(), tree.root, tree.min,
+               tree.getGeneration(), tree.root->population()});
+  std::lock_guard<std::mutex> guard(lock);
+  latest = next;
+  published.erase(std::remove_if(published.begin(), published.end(),
+                                 [](const std::weak_ptr<const Snapshot> &weak) {
+                                   return weak.expired();
+                                 }),
+                  published.end());
+  published.push_back(next);
+}
+
+/**
+ * Answers the request lines of one connection until it closes.
+ */
+void QueryServer::serve(Connection &connection) {
+  std::string pending;
+  char buffer[4096];
+  bool open = true;
+  while (open) {
+    ssize_t received = recv(connection.socket, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+      break;
+    }
+    pending.append(buffer, received);
+
+    size_t end;
+    while (open && (end = pending.find('\n')) != std::string::npos) {
+      std::string request = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      if (!request.empty() && request.back() == '\r') {
+        request.pop_back();
+      }
+
+      std::string reply = answer(request) + "\n";
+      for (size_t sent = 0; sent < reply.size();) {
+        ssize_t written = send(connection.socket, reply.data() + sent,
+                               reply.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0) {
+          open = false;
+          break;
+        }
+        sent += written;
+      }
+      if (request == "stop") {
+        stop();
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  close(connection.socket);
+  connection.socket = -1;
+  connection.done = true;
+}
+
+/**
+ * Returns the latest snapshot, which is kept until it is let go of.
+ */
+std::shared_ptr<const QueryServer::Snapshot> QueryServer::snapshot() {
+  std::lock_guard<std::mutex> guard(lock);
+  return latest;
+}
+
+/**
+ * Hands a step to the stepping thread and waits for its reply.
+ */
+std::string QueryServer::step(uint64_t generations) {
+  auto request = std::make_shared<Step>();
+  request->generations = generations;
+  auto reply = request->reply.get_future();
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (stopping) {
+      return "error The server is stopping.";
+    }
+    steps.push_back(request);
+  }
+  wake.notify_all();
+  return reply.get();
+}
+
+/**
+ * Returns whether stepping this many generations would take the fixed
+ * universe more than MAX_FIXED_STEPS steps of its root. The plane jumps
+ * any distance with hyperspeed, so it is never too long.
+ */
+bool QueryServer::tooLong(uint64_t generations) const {
+  if (tree.topology == QuadTree::BOUNDED) {
+    return generations > MAX_FIXED_STEPS;
+  }
+  if (tree.topology == QuadTree::TORUS) {
+    return (generations >> (tree.root->height() - 1)) > MAX_FIXED_STEPS;
+  }
+  return false;
+}
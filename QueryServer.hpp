@@ -0,0 +1,102 @@
+#ifndef QUERYSERVER_HPP
+#define QUERYSERVER_HPP
+#include "QuadTree.hpp"
+#include "QuadTreeNode.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Answers line-based requests about a running universe over a Unix domain
+ * socket, one reply line per request line:
+ *   step N                  steps N generations, replying with the generation,
+ *                           which fixed universes cap as they can't jump far
+ *   generation              the generation of the latest snapshot
+ *   population              its population
+ *   bbox                    its bounding box as minX minY maxX maxY, or empty
+ *   region x0 y0 x1 y1      the count and coordinates of its living cells in
+ *                           the inclusive rectangle
+ *   save name               writes it to a life file of that name in the save
+ *                           directory, replying with the count
+ *   stop                    stops the server
+ * Replies start with "ok" or "error". Only the thread running the server
+ * steps the universe, and after each step it publishes the new root as an
+ * immutable snapshot. Every connection has its own thread, which answers
+ * queries from the latest snapshot by viewing the stepping thread's arena,
+ * so queries never wait on a step and a step never waits on a query. Nodes
+ * of snapshots still being read are kept through garbage collection.
+ */
+class QueryServer {
+public:
+  // the stepping thread collects garbage after a step once its cache has
+  // grown past this
+  static const size_t GARBAGE_LIMIT = 1 << 22;
+  // bounded universes step one generation at a time and toroidal ones half
+  // a root at a time, so a step taking more of those than this is refused
+  // rather than holding up the stepping thread
+  static const uint64_t MAX_FIXED_STEPS = 1 << 16;
+
+  QueryServer(QuadTree &, const std::string &, const std::string &);
+  ~QueryServer();
+
+  std::string answer(const std::string &);
+  void run();
+  void stop();
+
+private:
+  struct Snapshot {
+    const QuadTreeNode *arena;
+    QuadTreeNode *root;
+    int64_t corner; // of the root's north-west cell
+    uint64_t generation;
+    // counted by the stepping thread, whose side table keeps the populations
+    // too large for a node, where a view would add them up again
+    uint64_t population;
+  };
+
+  struct Step {
+    uint64_t generations;
+    std::promise<std::string> reply;
+  };
+
+  struct Connection {
+    int socket; // -1 once closed
+    std::atomic<bool> done;
+    std::thread thread;
+  };
+
+  QuadTree &tree;
+  std::string path;
+  std::string saveDirectory; // empty when saving is off
+  int listener;
+  std::thread acceptor;
+
+  // guards everything below
+  std::mutex lock;
+  std::condition_variable wake;
+  bool stopping;
+  std::shared_ptr<const Snapshot> latest;
+  // every snapshot handed out, for keeping those still held through garbage
+  // collection
+  std::vector<std::weak_ptr<const Snapshot>> published;
+  std::deque<std::shared_ptr<Step>> steps;
+  std::list<Connection> connections;
+
+  void accept();
+  void collectGarbage();
+  void publish();
+  void serve(Connection &);
+  std::shared_ptr<const Snapshot> snapshot();
+  std::string step(uint64_t);
+  bool tooLong(uint64_t) const;
+};
+
+#endif // QUERYSERVER_HPP
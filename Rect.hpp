@@ -0,0 +1,26 @@
+#ifndef RECT_HPP
+#define RECT_HPP
+#include <cstdint>
+
+/**
+ * An inclusive rectangle of cells, which is empty while min is past max.
+ */
+struct Rect {
+  int64_t minX;
+  int64_t minY;
+  int64_t maxX;
+  int64_t maxY;
+
+  static Rect empty() {
+    return Rect{INT64_MAX, INT64_MAX, INT64_MIN, INT64_MIN};
+  }
+
+  bool isEmpty() const { return minX > maxX || minY > maxY; }
+
+  bool operator==(const Rect &other) const {
+    return minX == other.minX && minY == other.minY && maxX == other.maxX &&
+           maxY == other.maxY;
+  }
+};
+
+#endif // RECT_HPP
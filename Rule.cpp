@@ -0,0 +1,301 @@
+#include "Rule.hpp"
+#include <boost/algorithm/string.hpp>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+// Hensel letters for each neighbor count up to 4, counts 5 to 7 using the
+// letters of their complement (8 - n)
+static const char *HENSEL_LETTERS[5] = {"", "ce", "ceaikn", "ceaiknjqry",
+                                        "ceaiknjqrytwz"};
+
+// a representative neighborhood for each of the above letters, as a ring of
+// bits running clockwise from north: N, NE, E, SE, S, SW, W, NW
+static const uint8_t HENSEL_NEIGHBORHOODS[5][13] = {
+    {},
+    {0x02, 0x01},
+    {0x0A, 0x05, 0x03, 0x11, 0x09, 0x22},
+    {0x2A, 0x15, 0x07, 0x83, 0x25, 0x0B, 0x43, 0x23, 0x13, 0x29},
+    {0xAA, 0x55, 0x0F, 0x1B, 0x4B, 0x8B, 0x53, 0x27, 0x17, 0x2B, 0x39, 0x63,
+     0x33}};
+
+// the (x, y) position within the 3x3 neighborhood of each bit in the ring
+static const unsigned int RING_X[8] = {1, 2, 2, 2, 1, 0, 0, 0};
+static const unsigned int RING_Y[8] = {0, 0, 1, 2, 2, 2, 1, 0};
+
+static const unsigned int CENTER = 1 << 4;
+
+/**
+ * Creates the standard Conway rule, B3/S23.
+ */
+Rule::Rule() : Rule(1 << 3, (1 << 2) | (1 << 3)) {}
+
+/**
+ * Creates an outer-totalistic rule from its birth and survival masks, where
+ * bit n of each mask is set if n neighbors cause a birth or survival
+ * respectively.
+ */
+Rule::Rule(uint16_t birth, uint16_t survival)
+    : birth(birth), survival(survival), totalistic(true), states(2) {
+  fillTotalistic();
+}
+
+/**
+ * Parses a rule string. Both the B/S notation ("B36/S23") and the older S/B
+ * notation ("23/36") are accepted, case-insensitively. In B/S notation, a
+ * count can be followed by Hensel letters to restrict it to those isotropic
+ * neighborhoods ("B2a") or by a minus and letters to exclude them ("S2-a").
+ * Generations rules add the amount of states as a third part, either as
+ * "B2/S/C3" or "/3" in S/B notation.
+ */
+Rule::Rule(std::string str)
+    : birth(0), survival(0), totalistic(true), states(2) {
+  boost::trim(str);
+  boost::to_lower(str);
+
+  std::vector<std::string> parts;
+  boost::split(parts, str, boost::is_any_of("/"));
+  if (parts.size() == 3) {
+    states = parseStates(parts[2]);
+  } else if (parts.size() != 2) {
+    throw "Invalid rule.";
+  }
+
+  std::string birthCounts;
+  std::string survivalCounts;
+  if (!parts[0].empty() && parts[0][0] == 'b') {
+    if (parts[1].empty() || parts[1][0] != 's') {
+      throw "Invalid rule.";
+    }
+    birthCounts = parts[0].substr(1);
+    survivalCounts = parts[1].substr(1);
+  } else if (!parts[0].empty() && parts[0][0] == 's') {
+    if (parts[1].empty() || parts[1][0] != 'b') {
+      throw "Invalid rule.";
+    }
+    survivalCounts = parts[0].substr(1);
+    birthCounts = parts[1].substr(1);
+  } else {
+    survivalCounts = parts[0];
+    birthCounts = parts[1];
+  }
+
+  birth = parseCounts(birthCounts, false);
+  survival = parseCounts(survivalCounts, true);
+
+  if (!totalistic) {
+    notation = "B" + birthCounts + "/S" + survivalCounts;
+  }
+
+  // a dead cell with no neighbors coming alive would fill the infinite plane
+  if (transitions[0]) {
+    throw "B0 rules are not supported.";
+  }
+}
+
+bool Rule::operator==(const Rule &other) const {
+  return transitions == other.transitions && states == other.states;
+}
+
+bool Rule::operator!=(const Rule &other) const { return !(*this == other); }
+
+/**
+ * Sets the transitions of every neighborhood from the birth and survival
+ * masks.
+ */
+void Rule::fillTotalistic() {
+  for (unsigned int neighborhood = 0; neighborhood < NEIGHBORHOODS;
+       neighborhood++) {
+    transitions[neighborhood] =
+        lives(neighborhood & CENTER, neighborCount(neighborhood));
+  }
+}
+
+/**
+ * Returns the representative ring of neighbors for a Hensel letter of the
+ * given count, throwing if the letter does not exist for that count.
+ */
+uint8_t Rule::henselNeighborhood(unsigned int count, char letter) {
+  unsigned int base = count <= 4 ? count : MAX_NEIGHBORS - count;
+  const char *found = std::strchr(HENSEL_LETTERS[base], letter);
+  if (letter == '\0' || found == nullptr) {
+    throw "Invalid rule.";
+  }
+
+  uint8_t ring = HENSEL_NEIGHBORHOODS[base][found - HENSEL_LETTERS[base]];
+  return count <= 4 ? ring : uint8_t(~ring);
+}
+
+/**
+ * Returns whether or not this is the standard B3/S23 rule.
+ */
+bool Rule::isConway() const { return *this == Rule(); }
+
+/**
+ * Returns whether a cell with the given state and amount of living neighbors
+ * is alive in the next generation. Only meaningful for totalistic rules.
+ */
+bool Rule::lives(bool alive, unsigned int neighbors) const {
+  return ((alive ? survival : birth) >> neighbors) & 1;
+}
+
+/**
+ * Returns the amount of living neighbors around the center of a 3x3
+ * neighborhood.
+ */
+unsigned int Rule::neighborCount(unsigned int neighborhood) {
+  unsigned int count = 0;
+  for (unsigned int bit = 0; bit < 9; bit++) {
+    if (bit != 4 && ((neighborhood >> bit) & 1)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * Returns the next state of the center of a 3x3 neighborhood, bit (y * 3 + x)
+ * being the cell at (x, y).
+ */
+bool Rule::next(unsigned int neighborhood) const {
+  return transitions[neighborhood];
+}
+
+/**
+ * Returns the state of a cell in the next generation, given its current state
+ * and whether the rule births or keeps a living cell in its neighborhood. Under
+ * Generations rules a living cell that does not survive starts dying, and
+ * dying cells age until they return to dead regardless of their neighbors.
+ */
+uint8_t Rule::nextState(uint8_t state, bool lives) const {
+  if (state == 0) {
+    return lives ? 1 : 0;
+  } else if (state == 1) {
+    return lives ? 1 : (states > 2 ? 2 : 0);
+  } else {
+    return state + 1u < states ? state + 1 : 0;
+  }
+}
+
+/**
+ * Given a string of neighbor counts ("236", or with Hensel letters "2-a36i"),
+ * set the transitions for cells in the given state and return the mask with
+ * the bit of each count set.
+ */
+uint16_t Rule::parseCounts(const std::string &counts, bool alive) {
+  uint16_t mask = 0;
+  size_t i = 0;
+  while (i < counts.size()) {
+    char c = counts[i++];
+    if (c < '0' || c - '0' > int(MAX_NEIGHBORS)) {
+      throw "Invalid rule.";
+    }
+    unsigned int count = c - '0';
+    mask |= 1 << count;
+
+    bool exclude = i < counts.size() && counts[i] == '-';
+    if (exclude) {
+      i++;
+    }
+    std::string letters;
+    while (i < counts.size() && std::isalpha(counts[i])) {
+      letters += counts[i++];
+    }
+    if (exclude && letters.empty()) {
+      throw "Invalid rule.";
+    }
+
+    // every rotation and reflection of each letter's neighborhood
+    std::bitset<NEIGHBORHOODS> lettered;
+    for (auto letter : letters) {
+      uint8_t ring = henselNeighborhood(count, letter);
+      for (unsigned int reflection = 0; reflection < 2; reflection++) {
+        for (unsigned int rotation = 0; rotation < 4; rotation++) {
+          lettered[ringToNeighborhood(ring) | (alive ? CENTER : 0)] = true;
+          ring = uint8_t(ring << 2 | ring >> 6);
+        }
+        // mirror east and west, keeping north and south in place
+        uint8_t mirrored = 0;
+        for (unsigned int bit = 0; bit < 8; bit++) {
+          mirrored |= ((ring >> bit) & 1) << ((8 - bit) % 8);
+        }
+        ring = mirrored;
+      }
+    }
+
+    for (unsigned int neighborhood = 0; neighborhood < NEIGHBORHOODS;
+         neighborhood++) {
+      if (bool(neighborhood & CENTER) != alive ||
+          neighborCount(neighborhood) != count) {
+        continue;
+      }
+      if (letters.empty() || lettered[neighborhood] != exclude) {
+        transitions[neighborhood] = true;
+      }
+    }
+
+    if (!letters.empty()) {
+      totalistic = false;
+    }
+  }
+  return mask;
+}
+
+/**
+ * Parses the amount of states of a Generations rule ("c3", "g3" or "3").
+ */
+unsigned int Rule::parseStates(const std::string &str) {
+  std::string digits = str;
+  if (!digits.empty() && (digits[0] == 'c' || digits[0] == 'g')) {
+    digits = digits.substr(1);
+  }
+  if (digits.empty() || digits.size() > 3 ||
+      digits.find_first_not_of("0123456789") != std::string::npos) {
+    throw "Invalid rule.";
+  }
+
+  unsigned int states = std::stoi(digits);
+  if (states < 2 || states > MAX_STATES) {
+    throw "Invalid rule.";
+  }
+  return states;
+}
+
+/**
+ * Converts a clockwise ring of neighbor bits into a 3x3 neighborhood index.
+ */
+unsigned int Rule::ringToNeighborhood(uint8_t ring) {
+  unsigned int neighborhood = 0;
+  for (unsigned int bit = 0; bit < 8; bit++) {
+    if ((ring >> bit) & 1) {
+      neighborhood |= 1 << (RING_Y[bit] * 3 + RING_X[bit]);
+    }
+  }
+  return neighborhood;
+}
+
+/**
+ * Returns the rule in B/S notation, with the amount of states for
+ * Generations rules.
+ */
+std::string Rule::toString() const {
+  std::string str = "B";
+  for (unsigned int i = 0; i <= MAX_NEIGHBORS; i++) {
+    if ((birth >> i) & 1) {
+      str += char('0' + i);
+    }
+  }
+  str += "/S";
+  for (unsigned int i = 0; i <= MAX_NEIGHBORS; i++) {
+    if ((survival >> i) & 1) {
+      str += char('0' + i);
+    }
+  }
+  if (!totalistic) {
+    str = notation;
+  }
+  if (states > 2) {
+    str += "/C" + std::to_string(states);
+  }
+  return str;
+}
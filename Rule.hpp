@@ -0,0 +1,48 @@
+#ifndef RULE_HPP
+#define RULE_HPP
+#include <bitset>
+#include <cstdint>
+#include <string>
+
+class Rule {
+public:
+  static const unsigned int MAX_NEIGHBORS = 8;
+  static const unsigned int NEIGHBORHOODS = 512;
+  static const unsigned int MAX_STATES = 256;
+
+  uint16_t birth;    // bit n is set if a dead cell with n neighbors is born
+  uint16_t survival; // bit n is set if a live cell with n neighbors survives
+  bool totalistic;   // false if any count is restricted by Hensel letters
+  unsigned int states; // above 2 for Generations rules, where cells that fail
+                       // to survive spend states - 2 generations dying
+
+  Rule();
+  Rule(std::string);
+  Rule(uint16_t, uint16_t);
+
+  bool operator==(const Rule &) const;
+  bool operator!=(const Rule &) const;
+
+  static unsigned int neighborCount(unsigned int);
+
+  bool isConway() const;
+  bool lives(bool, unsigned int) const;
+  bool next(unsigned int) const;
+  uint8_t nextState(uint8_t, bool) const;
+  std::string toString() const;
+
+private:
+  // the next state of the center of every 3x3 neighborhood, indexed with bit
+  // (y * 3 + x) being the cell at (x, y)
+  std::bitset<NEIGHBORHOODS> transitions;
+  std::string notation;
+
+  static uint8_t henselNeighborhood(unsigned int, char);
+  static unsigned int ringToNeighborhood(uint8_t);
+
+  void fillTotalistic();
+  uint16_t parseCounts(const std::string &, bool);
+  static unsigned int parseStates(const std::string &);
+};
+
+#endif // RULE_HPP
@@ -0,0 +1,277 @@
+#include "SharedArena.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static const char MAGIC[8] = {'Q', 'T', 'A', 'R', 'E', 'N', 'A', '\0'};
+// the header takes a page of its own, followed by the slots and the nodes
+static const size_t HEADER_BYTES = 4096;
+static const size_t MIN_SLOTS = 1024;
+// how long to wait for another process to finish making the arena
+static const auto SETUP_TIMEOUT = std::chrono::seconds(10);
+
+const uint32_t SharedArena::VERSION;
+const uint32_t SharedArena::EMPTY;
+
+struct SharedArena::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t nodeSize;
+  uint32_t capacity; // node indices, of which 0 is never handed out
+  uint32_t top;      // the next index to hand out
+  uint64_t slotCount;
+  uint64_t jumpCount; // jumps offered, which stop being kept at 70% of slots
+  uint64_t bytes;
+  char rule[128];
+  char hash[32];
+  uint32_t ready; // set once everything above is written
+};
+
+/**
+ * Returns the name of a shared memory object, which must start with a slash.
+ */
+static std::string objectName(const std::string &name) {
+  return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+/**
+ * Returns where the jump keys start, after the slots.
+ */
+static size_t jumpOffset(uint64_t slotCount) {
+  return HEADER_BYTES + (slotCount * sizeof(uint32_t) + 63) / 64 * 64;
+}
+
+/**
+ * Returns where the nodes start after the slots, the jump keys and their
+ * results, aligned to a cache line.
+ */
+static size_t arenaOffset(uint64_t slotCount) {
+  return jumpOffset(slotCount) +
+         (slotCount * (sizeof(uint64_t) + sizeof(uint32_t)) + 63) / 64 * 64;
+}
+
+/**
+ * Returns the key a jump is memoized under, which is never 0.
+ */
+static uint64_t jumpKey(uint32_t index, unsigned int log2Steps) {
+  return uint64_t(log2Steps) << 32 | index;
+}
+
+/**
+ * Returns the first slot a jump key is looked for in.
+ */
+static size_t jumpSlot(uint64_t key) {
+  key *= 0x9E3779B97F4A7C15ull;
+  return key ^ key >> 29;
+}
+
+/**
+ * Maps the shared arena with the given name, making it with room for
+ * capacity nodes of nodeSize bytes if it doesn't exist yet. The rule and the
+ * hash policy the nodes are memoized and placed under must match those of
+ * whoever made it.
+ */
+SharedArena::SharedArena(const std::string &name, uint32_t capacity,
+                         size_t nodeSize, const std::string &rule,
+                         const std::string &hash)
+    : header(nullptr), slots(nullptr), jumpKeys(nullptr),
+      jumpResults(nullptr), mask(0), arena(nullptr), mapped(0),
+      creator(false) {
+  if (capacity < 2) {
+    throw "A shared arena needs room for at least one node.";
+  }
+  if (rule.size() >= sizeof(Header::rule) ||
+      hash.size() >= sizeof(Header::hash)) {
+    throw "Rule or hash name too long to share.";
+  }
+
+  std::string path = objectName(name);
+  int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  creator = fd >= 0;
+  if (!creator) {
+    if (errno != EEXIST ||
+        (fd = shm_open(path.c_str(), O_RDWR, 0)) < 0) {
+      throw "Could not open the shared arena.";
+    }
+  }
+
+  uint64_t slotCount = MIN_SLOTS;
+  auto deadline = std::chrono::steady_clock::now() + SETUP_TIMEOUT;
+  if (creator) {
+    while (slotCount * 7 < uint64_t(capacity) * 10) {
+      slotCount *= 2;
+    }
+    mapped = arenaOffset(slotCount) + size_t(capacity) * nodeSize;
+    if (ftruncate(fd, mapped) != 0) {
+      close(fd);
+      shm_unlink(path.c_str());
+      throw "Could not size the shared arena.";
+    }
+  } else {
+    // the process making it may not have sized it yet
+    struct stat status;
+    while (fstat(fd, &status) == 0 && size_t(status.st_size) < HEADER_BYTES) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        close(fd);
+        throw "The shared arena was never set up.";
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    mapped = status.st_size;
+  }
+
+  void *memory = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_NORESERVE, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    if (creator) {
+      shm_unlink(path.c_str());
+    }
+    throw "Could not map the shared arena.";
+  }
+  header = static_cast<Header *>(memory);
+
+  if (creator) {
+    memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    header->version = VERSION;
+    header->nodeSize = nodeSize;
+    header->capacity = capacity;
+    header->top = 1;
+    header->slotCount = slotCount;
+    header->jumpCount = 0;
+    header->bytes = mapped;
+    strncpy(header->rule, rule.c_str(), sizeof(header->rule) - 1);
+    strncpy(header->hash, hash.c_str(), sizeof(header->hash) - 1);
+    __atomic_store_n(&header->ready, 1, __ATOMIC_RELEASE);
+  } else {
+    while (__atomic_load_n(&header->ready, __ATOMIC_ACQUIRE) == 0) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        munmap(memory, mapped);
+        throw "The shared arena was never set up.";
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const char *error = nullptr;
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header->version != VERSION || header->bytes != mapped) {
+      error = "Not a shared arena, or one of another version.";
+    } else if (header->nodeSize != nodeSize || hash != header->hash) {
+      error = "The shared arena was made by another build.";
+    } else if (rule != header->rule) {
+      error = "The shared arena runs another rule.";
+    }
+    if (error != nullptr) {
+      munmap(memory, mapped);
+      throw error;
+    }
+  }
+
+  slots = reinterpret_cast<uint32_t *>(static_cast<char *>(memory) +
+                                       HEADER_BYTES);
+  jumpKeys = reinterpret_cast<uint64_t *>(static_cast<char *>(memory) +
+                                         jumpOffset(header->slotCount));
+  jumpResults = reinterpret_cast<uint32_t *>(jumpKeys + header->slotCount);
+  mask = header->slotCount - 1;
+  arena = static_cast<char *>(memory) + arenaOffset(header->slotCount);
+}
+
+SharedArena::~SharedArena() { munmap(header, mapped); }
+
+/**
+ * Removes the shared arena with the given name, which lives on in the
+ * processes still mapping it.
+ */
+void SharedArena::unlink(const std::string &name) {
+  shm_unlink(objectName(name).c_str());
+}
+
+/**
+ * Hands out an index no other thread or process will get.
+ */
+uint32_t SharedArena::allocate() {
+  uint32_t index = __atomic_fetch_add(&header->top, 1, __ATOMIC_RELAXED);
+  if (index >= header->capacity) {
+    throw "The shared arena is full.";
+  }
+  return index;
+}
+
+/**
+ * Returns the bytes in use: the header, the slots and the nodes handed out.
+ */
+size_t SharedArena::bytes() const {
+  return arenaOffset(header->slotCount) + size() * header->nodeSize;
+}
+
+/**
+ * Returns how many node indices the arena has, including the unused 0.
+ */
+uint32_t SharedArena::capacity() const { return header->capacity; }
+
+/**
+ * Returns whether this process made the arena rather than finding it.
+ */
+bool SharedArena::created() const { return creator; }
+
+/**
+ * Returns the memoized result of the node at index jumping 2^log2Steps
+ * generations, or EMPTY if no one has memoized it yet.
+ */
+uint32_t SharedArena::findJump(uint32_t index, unsigned int log2Steps) const {
+  uint64_t key = jumpKey(index, log2Steps);
+  for (size_t slot = jumpSlot(key) & mask;; slot = (slot + 1) & mask) {
+    uint64_t found = __atomic_load_n(jumpKeys + slot, __ATOMIC_ACQUIRE);
+    if (found == 0) {
+      return EMPTY;
+    }
+    if (found == key) {
+      return __atomic_load_n(jumpResults + slot, __ATOMIC_ACQUIRE);
+    }
+  }
+}
+
+/**
+ * Memoizes the result of the node at index jumping 2^log2Steps generations,
+ * unless the table is full. Results are the same whoever works them out, so
+ * when another thread or process claims the key first either result will do.
+ */
+void SharedArena::insertJump(uint32_t index, unsigned int log2Steps,
+                             uint32_t result) {
+  if (__atomic_fetch_add(&header->jumpCount, 1, __ATOMIC_RELAXED) * 10 >=
+      header->slotCount * 7) {
+    return;
+  }
+  uint64_t key = jumpKey(index, log2Steps);
+  for (size_t slot = jumpSlot(key) & mask;; slot = (slot + 1) & mask) {
+    uint64_t found = 0;
+    if (__atomic_compare_exchange_n(jumpKeys + slot, &found, key, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ||
+        found == key) {
+      __atomic_store_n(jumpResults + slot, result, __ATOMIC_RELEASE);
+      return;
+    }
+  }
+}
+
+/**
+ * Returns the start of the nodes, indexed from 0.
+ */
+void *SharedArena::nodes() const { return arena; }
+
+/**
+ * Returns the rule every node's next generation is memoized under.
+ */
+std::string SharedArena::rule() const { return header->rule; }
+
+/**
+ * Returns how many nodes have been handed out by every process.
+ */
+size_t SharedArena::size() const {
+  uint32_t top = __atomic_load_n(&header->top, __ATOMIC_RELAXED);
+  return (top < header->capacity ? top : header->capacity) - 1;
+}
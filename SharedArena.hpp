@@ -0,0 +1,105 @@
+#ifndef SHAREDARENA_HPP
+#define SHAREDARENA_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * A node arena and its intern table in POSIX shared memory, so that every
+ * process and thread mapping it shares one hash-consed universe of nodes and
+ * their memoized next generations. Nodes refer to each other by index, so
+ * each process can map it anywhere.
+ * The table has a fixed amount of slots, at most 70% of which the arena can
+ * fill, and never moves. Slots are claimed with a compare and swap, so
+ * lookups take no lock, and of two processes interning the same node at once
+ * one finds the other's. Jumps of more than one generation are memoized in a
+ * second table of the same size, by node index and log2 of the steps, for as
+ * long as it has room. Nodes are never freed, as any process may hold any
+ * of them, so the arena is sized up front; memory is only taken as nodes are
+ * written.
+ */
+class SharedArena {
+public:
+  static const uint32_t VERSION = 1;
+  static const uint32_t EMPTY = 0;
+
+  SharedArena(const std::string &, uint32_t, size_t, const std::string &,
+              const std::string &);
+  SharedArena(const SharedArena &) = delete;
+  SharedArena &operator=(const SharedArena &) = delete;
+  ~SharedArena();
+
+  static void unlink(const std::string &);
+
+  uint32_t allocate();
+  size_t bytes() const;
+  uint32_t capacity() const;
+  bool created() const;
+  uint32_t findJump(uint32_t, unsigned int) const;
+  void insertJump(uint32_t, unsigned int, uint32_t);
+  void *nodes() const;
+  std::string rule() const;
+  size_t size() const;
+
+  /**
+   * Returns the index of the node equal to node, or EMPTY if there is none.
+   */
+  template <typename Node, typename Hash>
+  uint32_t find(const Node &node, const Node *arena) const {
+    for (size_t slot = Hash()(node) & mask;; slot = (slot + 1) & mask) {
+      uint32_t index = __atomic_load_n(slots + slot, __ATOMIC_ACQUIRE);
+      if (index == EMPTY) {
+        return EMPTY;
+      }
+      if (arena[index] == node) {
+        return index;
+      }
+    }
+  }
+
+  /**
+   * Starts loading the slot a lookup of the node of the given height made of
+   * these quads begins at, ahead of the find, without building the node.
+   */
+  template <typename Hash>
+  void prefetch(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se,
+                unsigned int height) const {
+    __builtin_prefetch(slots + (Hash()(nw, ne, sw, se, height) & mask));
+  }
+
+  /**
+   * Publishes the node written at index, returning index, or the index of an
+   * equal node some other thread or process published first, in which case
+   * index was never seen by anyone and can be reused.
+   */
+  template <typename Node, typename Hash>
+  uint32_t insert(uint32_t index, const Node *arena) {
+    for (size_t slot = Hash()(arena[index]) & mask;;
+         slot = (slot + 1) & mask) {
+      uint32_t found = EMPTY;
+      if (__atomic_compare_exchange_n(slots + slot, &found, index, false,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return index;
+      }
+      if (arena[found] == arena[index]) {
+        return found;
+      }
+    }
+  }
+
+private:
+  struct Header;
+
+  Header *header;
+  uint32_t *slots;
+  // jump keys are the node index and the log2 of the steps above it, and
+  // their results are only written once the key is
+  uint64_t *jumpKeys;
+  uint32_t *jumpResults;
+  size_t mask;
+  void *arena;
+  size_t mapped;
+  bool creator;
+};
+
+#endif // SHAREDARENA_HPP
@@ -0,0 +1,315 @@
+#include "Simulator.hpp"
+#include "DenseGrid.hpp"
+#include "QuadTreeNode.hpp"
+#include <cmath>
+#include <sstream>
+
+const Simulator::Thresholds Simulator::DEFAULT_THRESHOLDS = {0.9, 0.02, 16};
+
+static const unsigned int MAX_RETURN_WINDOW = 1 << 16;
+
+/**
+ * Creates a simulator starting on the given engine.
+ * @param automatic whether to migrate between engines as the pattern changes
+ */
+Simulator::Simulator(QuadTree tree, Engine engine, bool automatic,
+                     Thresholds thresholds)
+    : universe(new QuadTree(tree)), engine(HASHLIFE), automatic(automatic),
+      thresholds(thresholds), topology(tree.topology), generation(0),
+      hitRate(1), internHitRate(1), interns(0), growth(0), streak(0),
+      returnWindow(thresholds.window), switchCount(0), lastDecision("none"),
+      garbageLimit(0) {
+  if (thresholds.window == 0) {
+    throw "Switching window must be at least one generation.";
+  }
+  if (engine == DENSE) {
+    if (!canSwitch()) {
+      throw "Rule or topology not supported by the dense engine.";
+    }
+    switchTo(DENSE, "requested");
+    switchCount = 0;
+  }
+  populations.push_back(universe->population());
+}
+
+const char *Simulator::engineName(Engine engine) {
+  return engine == DENSE ? "dense" : "hashlife";
+}
+
+/**
+ * Returns whether the universe can move to the dense engine, which only runs
+ * two-state totalistic rules on the unbounded plane.
+ */
+bool Simulator::canSwitch() const {
+  return topology == QuadTree::PLANE &&
+         DenseGrid::supports(QuadTreeNode::getRule());
+}
+
+/**
+ * Frees the cached nodes the universe no longer needs, returning how many
+ * were freed. The dense engine holds no nodes, so every one is freed.
+ */
+size_t Simulator::collectGarbage() {
+  if (engine == HASHLIFE) {
+    return quadTree()->collectGarbage();
+  }
+  return QuadTreeNode::collectGarbage(std::vector<QuadTreeNode *>());
+}
+
+/**
+ * Steps forward to the generation that was rewound past, or steps one
+ * generation if there is none. Returns whether a rewound generation was
+ * restored.
+ */
+bool Simulator::forward() {
+  if (engine != HASHLIFE || quadTree()->futureSize() == 0) {
+    nextGeneration();
+    return false;
+  }
+  uint64_t before = quadTree()->getGeneration();
+  quadTree()->forward();
+  restarted(generation + (quadTree()->getGeneration() - before));
+  return true;
+}
+
+Rect Simulator::boundingBox() { return universe->boundingBox(); }
+
+bool Simulator::getCellAlive(int64_t x, int64_t y) {
+  return universe->getCellAlive(x, y);
+}
+
+std::vector<std::pair<int64_t, int64_t>> Simulator::getLivingCells() {
+  return universe->getLivingCells();
+}
+
+/**
+ * Steps the universe one generation, then decides whether to migrate it. On
+ * hashlife the decision uses the share of next generations answered from the
+ * memo during this step, and on the dense engine the relative change in
+ * population over the window.
+ */
+void Simulator::nextGeneration() {
+  QuadTreeNode::resetStats();
+  universe->nextGeneration();
+  generation++;
+  recordPopulation();
+
+  if (garbageLimit != 0 && QuadTreeNode::cacheSize() > garbageLimit) {
+    collectGarbage();
+    // a universe that still needs most of the limit would collect again
+    // right away, so give it room to grow
+    if (QuadTreeNode::cacheSize() > garbageLimit / 2) {
+      garbageLimit *= 2;
+    }
+  }
+
+  if (engine == HASHLIFE) {
+    auto const &stats = QuadTreeNode::getStats();
+    uint64_t nexts = stats.nextHits + stats.nextMisses;
+    interns = stats.internHits + stats.internMisses;
+    hitRate = nexts == 0 ? 1 : double(stats.nextHits) / nexts;
+    internHitRate = interns == 0 ? 1 : double(stats.internHits) / interns;
+  }
+
+  if (!automatic || !canSwitch()) {
+    streak = 0;
+    return;
+  }
+
+  bool shouldSwitch;
+  if (engine == HASHLIFE) {
+    shouldSwitch = hitRate < thresholds.minHitRate;
+  } else {
+    shouldSwitch = populations.size() > thresholds.window &&
+                   growth <= thresholds.maxGrowth;
+  }
+  streak = shouldSwitch ? streak + 1 : 0;
+  if (streak < (engine == HASHLIFE ? thresholds.window : returnWindow)) {
+    return;
+  }
+
+  std::ostringstream reason;
+  if (engine == HASHLIFE) {
+    reason << "next hit rate below " << thresholds.minHitRate << " for "
+           << thresholds.window << " generations";
+    switchTo(DENSE, reason.str());
+  } else {
+    reason << "population change within " << thresholds.maxGrowth * 100
+           << "% for " << returnWindow << " generations";
+    switchTo(HASHLIFE, reason.str());
+  }
+}
+
+uint64_t Simulator::population() { return universe->population(); }
+
+uint64_t Simulator::populationIn(const Rect &box) {
+  return universe->populationIn(box);
+}
+
+/**
+ * Returns the universe as a quad tree, which it only is on hashlife.
+ */
+QuadTree *Simulator::quadTree() const {
+  return static_cast<QuadTree *>(universe.get());
+}
+
+/**
+ * Continues from another generation after moving through history, starting
+ * the switching measurements over.
+ */
+void Simulator::restarted(uint64_t newGeneration) {
+  generation = newGeneration;
+  populations.clear();
+  populations.push_back(universe->population());
+  growth = 0;
+  streak = 0;
+}
+
+/**
+ * Steps back one generation, returning false if there is no history left.
+ * History is only kept on hashlife, and is lost when switching engines.
+ */
+bool Simulator::rewind() {
+  if (engine != HASHLIFE) {
+    return false;
+  }
+  uint64_t before = quadTree()->getGeneration();
+  if (!quadTree()->rewind()) {
+    return false;
+  }
+  restarted(generation - (before - quadTree()->getGeneration()));
+  return true;
+}
+
+void Simulator::setCellAlive(int64_t x, int64_t y) {
+  universe->setCellAlive(x, y);
+}
+
+/**
+ * Records the population after a step, and the relative change in population
+ * across the window.
+ */
+void Simulator::recordPopulation() {
+  populations.push_back(universe->population());
+  if (populations.size() > thresholds.window + 1) {
+    populations.erase(populations.begin());
+  }
+
+  double first = double(populations.front());
+  double last = double(populations.back());
+  growth = std::fabs(last - first) / (first > 0 ? first : 1);
+}
+
+/**
+ * Sets how many nodes may be cached before unneeded ones are collected, where
+ * 0 never collects. Only set this while no other universe holds nodes, as
+ * those would be freed from under it.
+ */
+void Simulator::setGarbageLimit(size_t limit) { garbageLimit = limit; }
+
+/**
+ * Returns a one line summary of the switching thresholds.
+ */
+std::string Simulator::describeThresholds() const {
+  std::ostringstream oss;
+  oss << "engine switching " << (automatic ? "on" : "off")
+      << ": hashlife to dense below " << thresholds.minHitRate
+      << " next hit rate, dense to hashlife within "
+      << thresholds.maxGrowth * 100 << "% population change, over "
+      << thresholds.window << " generations";
+  return oss.str();
+}
+
+/**
+ * Returns a one line summary of the current engine and the measurements the
+ * switching decisions are based on.
+ */
+std::string Simulator::describeStats() const {
+  std::ostringstream oss;
+  oss.precision(3);
+  // the dense engine doesn't memoize, so it reports the last hashlife rates
+  oss << engineName(engine) << (engine == DENSE ? ", last hashlife" : ",")
+      << " next hit rate " << hitRate << ", intern hit rate "
+      << internHitRate << " over " << interns << " interns, population "
+      << populations.back() << " (" << growth * 100 << "% over "
+      << populations.size() - 1 << "), switches " << switchCount
+      << ", last decision: " << lastDecision << ", "
+      << QuadTreeNode::cacheSize() << " nodes cached";
+  if (getPeriod() != 0) {
+    oss << ", repeating with period " << getPeriod();
+  }
+  return oss.str();
+}
+
+Simulator::Engine Simulator::getEngine() const { return engine; }
+
+uint64_t Simulator::getGeneration() const { return generation; }
+
+/**
+ * Returns the relative change in population across the window.
+ */
+double Simulator::getGrowth() const { return growth; }
+
+/**
+ * Returns the share of next generations answered from the memo during the
+ * last hashlife step.
+ */
+double Simulator::getHitRate() const { return hitRate; }
+
+/**
+ * Returns how many nodes were looked up in the intern table during the last
+ * hashlife step, hits and misses alike.
+ */
+uint64_t Simulator::getInterns() const { return interns; }
+
+/**
+ * Returns the period the universe repeats with, which is only detected on
+ * hashlife, or 0 if it hasn't repeated.
+ */
+uint64_t Simulator::getPeriod() const {
+  if (engine != HASHLIFE) {
+    return 0;
+  }
+  return quadTree()->getPeriod();
+}
+
+const std::string &Simulator::getLastDecision() const { return lastDecision; }
+
+unsigned int Simulator::getSwitchCount() const { return switchCount; }
+
+/**
+ * Migrates the living cells to the other engine.
+ */
+void Simulator::switchTo(Engine target, const std::string &reason) {
+  if (target == DENSE) {
+    if (switchCount > 0 && returnWindow < MAX_RETURN_WINDOW) {
+      returnWindow *= 2;
+    }
+    universe.reset(new DenseGrid(*quadTree()));
+  } else {
+    universe.reset(new QuadTree(universe->getLivingCells()));
+    // the memo is cold after migrating, so the hit rate starts over
+    hitRate = 1;
+    internHitRate = 1;
+    interns = 0;
+  }
+
+  std::ostringstream oss;
+  oss << "switched to " << engineName(target) << " at generation "
+      << generation << " (" << reason << ")";
+  lastDecision = oss.str();
+  engine = target;
+  streak = 0;
+  switchCount++;
+}
+
+/**
+ * Returns a copy of the universe as a quad tree, migrating the cells if it is
+ * on the dense engine.
+ */
+QuadTree Simulator::toQuadTree() {
+  if (engine == HASHLIFE) {
+    return *quadTree();
+  }
+  return QuadTree(universe->getLivingCells());
+}
@@ -0,0 +1,89 @@
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+#include "QuadTree.hpp"
+#include "Universe.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Runs a universe on whichever engine suits it, migrating between the
+ * Hashlife QuadTree and the dense DenseGrid as the pattern changes. Hashlife
+ * wins once a pattern is regular and its memoized generations are reused, and
+ * loses while a pattern is chaotic, so a low next generation hit rate moves
+ * the universe to the dense engine, and a settled population moves it back.
+ * Patterns that settle while still too busy for hashlife would flip back and
+ * forth, so each return to dense doubles how long the population must settle
+ * before trying hashlife again.
+ */
+class Simulator : public Universe {
+public:
+  enum Engine { HASHLIFE, DENSE };
+
+  struct Thresholds {
+    double minHitRate;   // hashlife next generation hit rate to stay on it
+    double maxGrowth;    // population change over the window to leave dense
+    unsigned int window; // generations a condition must hold to switch
+  };
+
+  static const Thresholds DEFAULT_THRESHOLDS;
+
+  Simulator(QuadTree, Engine = HASHLIFE, bool = true,
+            Thresholds = DEFAULT_THRESHOLDS);
+
+  static const char *engineName(Engine);
+
+  Rect boundingBox() override;
+  bool getCellAlive(int64_t, int64_t) override;
+  std::vector<std::pair<int64_t, int64_t>> getLivingCells() override;
+  void nextGeneration() override;
+  uint64_t population() override;
+  uint64_t populationIn(const Rect &) override;
+  void setCellAlive(int64_t, int64_t) override;
+
+  bool canSwitch() const;
+  size_t collectGarbage();
+  std::string describeThresholds() const;
+  std::string describeStats() const;
+  Engine getEngine() const;
+  uint64_t getGeneration() const;
+  double getGrowth() const;
+  double getHitRate() const;
+  uint64_t getInterns() const;
+  uint64_t getPeriod() const;
+  const std::string &getLastDecision() const;
+  unsigned int getSwitchCount() const;
+  bool forward();
+  bool rewind();
+  void setGarbageLimit(size_t);
+  QuadTree toQuadTree();
+
+private:
+  std::unique_ptr<Universe> universe;
+  Engine engine;
+  bool automatic;
+  Thresholds thresholds;
+  QuadTree::Topology topology;
+
+  uint64_t generation;
+  double hitRate;
+  double internHitRate;
+  uint64_t interns; // intern table lookups during the last hashlife step
+  double growth;
+  std::vector<uint64_t> populations; // the last window + 1 populations
+  unsigned int streak; // generations the switching condition has held
+  unsigned int returnWindow; // generations to settle before leaving dense,
+                             // doubled whenever hashlife falls behind again
+  unsigned int switchCount;
+  std::string lastDecision;
+  size_t garbageLimit; // cached nodes before collecting, 0 to never collect
+
+  QuadTree *quadTree() const;
+  void recordPopulation();
+  void restarted(uint64_t);
+  void switchTo(Engine, const std::string &);
+};
+
+#endif // SIMULATOR_HPP
@@ -0,0 +1,129 @@
+#include "SoupSearch.hpp"
+#include "Classifier.hpp"
+#include "QuadTree.hpp"
+#include "QuadTreeNode.hpp"
+#include "Stabilizer.hpp"
+#include <chrono>
+#include <random>
+#include <thread>
+
+SoupSearch::SoupSearch(const Options &options) : options(options) {
+  if (options.size == 0) {
+    throw "Soups must be at least one cell wide.";
+  }
+  if (options.density < 0 || options.density > 1) {
+    throw "Soup density must be between 0 and 100%.";
+  }
+}
+
+/**
+ * Returns the options of a search for 16x16 soups at 50% density, each run
+ * for at most 20000 generations on every core.
+ */
+SoupSearch::Options SoupSearch::defaultOptions() {
+  return Options{16, 0.5, 1, 1000, 0, 20000};
+}
+
+/**
+ * Returns the cells of soup number index in the search with the given seed,
+ * a size by size square whose north-west corner is (0, 0).
+ */
+Census::Cells SoupSearch::soup(uint64_t seed, uint64_t index,
+                               unsigned int size, double density) {
+  std::seed_seq sequence{uint32_t(seed), uint32_t(seed >> 32), uint32_t(index),
+                         uint32_t(index >> 32)};
+  std::mt19937_64 random(sequence);
+
+  auto cells = Census::Cells();
+  for (unsigned int y = 0; y < size; y++) {
+    for (unsigned int x = 0; x < size; x++) {
+      // the top 53 bits as a fraction, so the draw is the same everywhere
+      if ((random() >> 11) * (1.0 / (uint64_t(1) << 53)) < density) {
+        cells.push_back(std::pair<int64_t, int64_t>(x, y));
+      }
+    }
+  }
+  return cells;
+}
+
+/**
+ * Runs every soup across the threads and returns their combined census.
+ * Threads take the next soup as they finish one, so slow soups don't hold
+ * up the rest.
+ */
+SoupSearch::Report SoupSearch::run() {
+  unsigned int threads = options.threads;
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+    threads = threads == 0 ? 1 : threads;
+  }
+
+  // every thread starts with the default rule, so each is handed this one
+  Rule rule = QuadTreeNode::getRule();
+  std::atomic<uint64_t> next(0);
+  auto reports = std::vector<Report>(threads, Report{Census(), 0, 0, 0, 1, 0});
+  auto errors = std::vector<const char *>(threads, nullptr);
+  auto workers = std::vector<std::thread>();
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < threads; i++) {
+    workers.push_back(std::thread([&, i]() {
+      try {
+        work(next, rule, reports[i]);
+      } catch (const char *e) {
+        errors[i] = e;
+        next = options.soups; // stop the other threads early
+      }
+    }));
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (auto error : errors) {
+    if (error != nullptr) {
+      throw error;
+    }
+  }
+
+  Report report = Report{Census(), 0, 0, 0, threads, 0};
+  for (auto const &part : reports) {
+    report.census.merge(part.census);
+    report.soups += part.soups;
+    report.unstable += part.unstable;
+    report.generations += part.generations;
+  }
+  report.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return report;
+}
+
+/**
+ * Runs soups on the calling thread until none are left, counting their ash
+ * into report. Only the ash of soups that settled is counted. Each thread
+ * keeps its own classifier, which soon knows every common object.
+ */
+void SoupSearch::work(std::atomic<uint64_t> &next, const Rule &rule,
+                      Report &report) const {
+  QuadTreeNode::setRule(rule);
+  Classifier classifier;
+  for (uint64_t index = next++; index < options.soups; index = next++) {
+    if (QuadTreeNode::cacheSize() > GARBAGE_LIMIT) {
+      QuadTreeNode::collectGarbage(std::vector<QuadTreeNode *>());
+    }
+
+    QuadTree tree =
+        QuadTree(soup(options.seed, index, options.size, options.density));
+    tree.setHistoryLimit(0);
+    Stabilizer stabilizer = Stabilizer(tree);
+    auto result = stabilizer.run(options.maxGenerations);
+
+    report.soups++;
+    report.generations += tree.getGeneration();
+    if (result.stable) {
+      report.census.addAsh(tree.getLivingCells(), classifier);
+    } else {
+      report.unstable++;
+    }
+  }
+}
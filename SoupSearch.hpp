@@ -0,0 +1,53 @@
+#ifndef SOUPSEARCH_HPP
+#define SOUPSEARCH_HPP
+#include "Census.hpp"
+#include "Rule.hpp"
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Runs random soups until they settle and takes a census of their ash, the
+ * way patterns are hunted for. Soups are spread across threads, each with
+ * its own node cache, and every soup is seeded from the search seed and its
+ * own number, so the census doesn't depend on how many threads ran it.
+ */
+class SoupSearch {
+public:
+  // soups whose nodes have grown the cache past this are followed by a
+  // garbage collection, as nothing is shared between soups but the memo
+  static const size_t GARBAGE_LIMIT = 1 << 21;
+
+  struct Options {
+    unsigned int size; // soups are size by size squares
+    double density;    // the chance of each cell starting alive
+    uint64_t seed;
+    uint64_t soups;
+    unsigned int threads; // 0 for one per core
+    uint64_t maxGenerations; // soups not settled by then count as unstable
+  };
+
+  struct Report {
+    Census census;
+    uint64_t soups;
+    uint64_t unstable;
+    uint64_t generations; // stepped across every soup
+    unsigned int threads;
+    double seconds;
+  };
+
+  SoupSearch(const Options &);
+
+  static Census::Cells soup(uint64_t, uint64_t, unsigned int, double);
+  static Options defaultOptions();
+
+  Report run();
+
+private:
+  Options options;
+
+  void work(std::atomic<uint64_t> &, const Rule &, Report &) const;
+};
+
+#endif // SOUPSEARCH_HPP
@@ -0,0 +1,138 @@
+#include "Stabilizer.hpp"
+
+Stabilizer::Stabilizer(QuadTree &tree)
+    : tree(tree), corePeriod(0), coreAge(0) {
+  for (unsigned int period = 0; period <= MAX_PERIOD; period++) {
+    runs[period] = 0;
+  }
+  result = Result{false, 0, 0, tree.population(), 0};
+  record();
+}
+
+/**
+ * Returns what is known so far, where stable is false until the pattern has
+ * settled.
+ */
+const Stabilizer::Result &Stabilizer::getResult() const { return result; }
+
+/**
+ * Steps until the pattern settles or the given amount of generations have
+ * been stepped, whichever comes first.
+ */
+Stabilizer::Result Stabilizer::run(uint64_t maxGenerations) {
+  for (uint64_t i = 0; i < maxGenerations && !result.stable; i++) {
+    step();
+  }
+  return result;
+}
+
+/**
+ * Steps one generation, returning whether the pattern has settled.
+ */
+bool Stabilizer::step() {
+  if (result.stable) {
+    return true;
+  }
+
+  tree.nextGeneration();
+  record();
+  result.population = tree.population();
+
+  if (tree.getPeriod() != 0) {
+    settle(tree.getGeneration() - tree.getPeriod(), tree.getPeriod());
+    return true;
+  }
+
+  // the shortest period the population has repeated with for long enough
+  unsigned int period = 0;
+  for (unsigned int p = 1; p <= MAX_PERIOD && period == 0; p++) {
+    uint64_t needed = SETTLE_PERIODS * p;
+    if (runs[p] >= (needed > MIN_SETTLE_GENERATIONS ? needed
+                                                    : MIN_SETTLE_GENERATIONS)) {
+      period = p;
+    }
+  }
+
+  if (period == 0) {
+    corePeriod = 0;
+    return false;
+  }
+  if (period != corePeriod) {
+    core = tree.boundingBox();
+    corePeriod = period;
+    coreAge = 0;
+    return false;
+  }
+  coreAge++;
+
+  // the pattern's own period can be a multiple of its population's, such as
+  // blinkers keeping the same population every generation. It must repeat
+  // for a whole period, so an escaping glider leaving the core can't match
+  // by chance. Roots from before the core was taken could hold cells outside
+  // of it, so only later ones are compared, and gliders still inside the
+  // core make it differ until they have left
+  for (unsigned int multiple = period;
+       2 * multiple <= coreAge && 2 * multiple < roots.size();
+       multiple += period) {
+    bool repeats = true;
+    for (unsigned int i = 0; i < multiple && repeats; i++) {
+      size_t last = roots.size() - 1 - i;
+      repeats = sameCore(roots[last], roots[last - multiple]);
+    }
+    if (repeats) {
+      settle(tree.getGeneration() - runs[period], multiple);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Returns whether two roots hold the same cells inside of the core. Roots
+ * are centered, so the smaller one is grown until both are the same height.
+ */
+bool Stabilizer::sameCore(const std::pair<QuadTreeNode *, int64_t> &a,
+                          const std::pair<QuadTreeNode *, int64_t> &b) const {
+  auto first = a;
+  auto second = b;
+  while (first.first->height() < second.first->height()) {
+    first = std::make_pair(first.first->grow(), second.second);
+  }
+  while (second.first->height() < first.first->height()) {
+    second = std::make_pair(second.first->grow(), first.second);
+  }
+  return first.first->sameCellsWithin(second.first, first.second,
+                                      first.second, core);
+}
+
+/**
+ * Remembers the current population and root, and counts how long the
+ * population has matched each earlier one.
+ */
+void Stabilizer::record() {
+  uint64_t population = tree.population();
+  for (unsigned int period = 1; period <= MAX_PERIOD; period++) {
+    if (populations.size() >= period &&
+        populations[populations.size() - period] == population) {
+      runs[period]++;
+    } else {
+      runs[period] = 0;
+    }
+  }
+
+  populations.push_back(population);
+  roots.push_back(std::make_pair(tree.root, tree.min));
+  if (populations.size() > MAX_PERIOD) {
+    populations.pop_front();
+  }
+  if (roots.size() > 2 * MAX_PERIOD + 1) {
+    roots.pop_front();
+  }
+}
+
+void Stabilizer::settle(uint64_t generation, uint64_t period) {
+  result.stable = true;
+  result.generation = generation;
+  result.detectedAt = tree.getGeneration();
+  result.period = period;
+}
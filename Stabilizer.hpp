@@ -0,0 +1,62 @@
+#ifndef STABILIZER_HPP
+#define STABILIZER_HPP
+#include "QuadTree.hpp"
+#include "QuadTreeNode.hpp"
+#include "Rect.hpp"
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+/**
+ * Steps a quad tree until its pattern settles, as methuselahs such as acorn
+ * and Lidka do after thousands of generations. A pattern has settled once its
+ * root repeats, or once its population has been periodic for a while and
+ * everything inside the region it then covered repeats with that period.
+ * Anything outside of that region has left it and is an escaping glider or
+ * spaceship, which never comes back to disturb the rest.
+ */
+class Stabilizer {
+public:
+  // the longest population period looked for, covering ash mixing the common
+  // periods 1, 2, 3, 4, 5 and 15
+  static const unsigned int MAX_PERIOD = 60;
+  // how many periods the population must repeat for before the pattern is
+  // checked, and the least amount of generations that is
+  static const unsigned int SETTLE_PERIODS = 8;
+  static const unsigned int MIN_SETTLE_GENERATIONS = 32;
+
+  struct Result {
+    bool stable;
+    uint64_t generation; // when the pattern settled
+    uint64_t detectedAt; // when settling was noticed
+    uint64_t population;
+    uint64_t period;
+  };
+
+  Stabilizer(QuadTree &);
+
+  const Result &getResult() const;
+  Result run(uint64_t);
+  bool step();
+
+private:
+  QuadTree &tree;
+  std::deque<uint64_t> populations;
+  // the last 2 * MAX_PERIOD + 1 roots, with the coordinate of their
+  // north-west corner
+  std::deque<std::pair<QuadTreeNode *, int64_t>> roots;
+  // for each period, how many generations in a row the population matched
+  // the population that period earlier
+  uint64_t runs[MAX_PERIOD + 1];
+  Rect core;
+  unsigned int corePeriod; // 0 while the population is not periodic
+  uint64_t coreAge;        // generations stepped since the core was taken
+  Result result;
+
+  bool sameCore(const std::pair<QuadTreeNode *, int64_t> &,
+                const std::pair<QuadTreeNode *, int64_t> &) const;
+  void record();
+  void settle(uint64_t, uint64_t);
+};
+
+#endif // STABILIZER_HPP
@@ -0,0 +1,25 @@
+#ifndef UNIVERSE_HPP
+#define UNIVERSE_HPP
+#include "Rect.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * The interface shared by the engines that can step a universe, so callers
+ * can hold either the Hashlife QuadTree or the dense bit-packed DenseGrid.
+ */
+class Universe {
+public:
+  virtual ~Universe() {}
+
+  virtual Rect boundingBox() = 0;
+  virtual bool getCellAlive(int64_t, int64_t) = 0;
+  virtual std::vector<std::pair<int64_t, int64_t>> getLivingCells() = 0;
+  virtual void nextGeneration() = 0;
+  virtual uint64_t population() = 0;
+  virtual uint64_t populationIn(const Rect &) = 0;
+  virtual void setCellAlive(int64_t, int64_t) = 0;
+};
+
+#endif // UNIVERSE_HPP
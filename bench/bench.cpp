@@ -0,0 +1,319 @@
+#include "../InputParser.hpp"
+#include "../InternTable.hpp"
+#include "../LifeKernel.hpp"
+#include "../NodeHash.hpp"
+#include "../QuadTree.hpp"
+#include "../QuadTreeNode.hpp"
+#include "../Rule.hpp"
+#include "../SoupSearch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+/**
+ * Steps the same random strip of rows repeatedly at each instruction set
+ * level the CPU supports, reporting cells per nanosecond.
+ */
+static void benchKernel(const Rule &rule) {
+  const size_t count = 4096;
+  const unsigned int iterations = 2000;
+
+  mt19937_64 random(42);
+  auto rows = vector<uint64_t>(count + 2);
+  auto west = vector<uint64_t>(count + 2);
+  auto east = vector<uint64_t>(count + 2);
+  for (size_t i = 0; i < count + 2; i++) {
+    rows[i] = random();
+    west[i] = rows[i] << 1;
+    east[i] = rows[i] >> 1;
+  }
+  auto out = vector<uint64_t>(count);
+
+  cout << "kernel " << rule.toString() << " (detected "
+       << LifeKernel::levelName(LifeKernel::detect()) << ")" << endl;
+  for (auto level : {LifeKernel::SCALAR, LifeKernel::SSE2, LifeKernel::AVX2}) {
+    if (level > LifeKernel::detect()) {
+      continue;
+    }
+    LifeKernel::setLevel(level);
+
+    uint64_t checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+      LifeKernel::stepRows(rows.data(), west.data(), east.data(), out.data(),
+                           count, rule);
+      checksum += out[i % count];
+    }
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(
+                       chrono::steady_clock::now() - start)
+                       .count();
+
+    double cells = double(count) * 64 * iterations;
+    cout << "  " << LifeKernel::levelName(level) << ": " << cells / elapsed
+         << " cells/ns (checksum " << checksum << ")" << endl;
+  }
+  LifeKernel::setLevel(LifeKernel::detect());
+}
+
+/**
+ * Returns a QuadTree holding a random side by side soup.
+ */
+static QuadTree soup(int64_t side) {
+  mt19937_64 random(7);
+  auto cells = vector<pair<int64_t, int64_t>>();
+  for (int64_t y = 0; y < side; y++) {
+    for (int64_t x = 0; x < side; x++) {
+      if (random() & 1) {
+        cells.push_back(make_pair(x, y));
+      }
+    }
+  }
+  QuadTree tree = QuadTree(cells);
+  tree.setHistoryLimit(0);
+  return tree;
+}
+
+/**
+ * Interns the given nodes into a fresh table hashed with Hash, then looks
+ * each of them up again, reporting the time both took and how the table
+ * filled up.
+ */
+template <typename Hash>
+static void benchHash(const char *name, const vector<uint32_t> &indices) {
+  const QuadTreeNode *arena = QuadTreeNode::getArena();
+  InternTable<QuadTreeNode, Hash> table;
+
+  auto start = chrono::steady_clock::now();
+  for (uint32_t index : indices) {
+    table.insert(index, arena);
+  }
+  auto inserted = chrono::steady_clock::now();
+  uint64_t checksum = 0;
+  for (uint32_t index : indices) {
+    checksum += table.find(arena[index], arena);
+  }
+  auto found = chrono::steady_clock::now();
+
+  auto insertNs =
+      chrono::duration_cast<chrono::nanoseconds>(inserted - start).count();
+  auto findNs =
+      chrono::duration_cast<chrono::nanoseconds>(found - inserted).count();
+  auto diagnostics = table.diagnose(arena);
+  cout << "  " << name << ": insert " << double(insertNs) / indices.size()
+       << "ns, find " << double(findNs) / indices.size() << "ns, mean probe "
+       << diagnostics.meanProbe << ", max probe " << diagnostics.maxProbe
+       << ", longest cluster " << diagnostics.longestCluster << ", "
+       << indices.size() - diagnostics.distinctHashes
+       << " full hash collisions (checksum " << checksum << ")" << endl;
+}
+
+/**
+ * Runs a random soup on Hashlife, then compares the hash policies on the
+ * nodes it made.
+ */
+static void benchHashes(unsigned int generations) {
+  QuadTree tree = soup(256);
+  for (unsigned int i = 0; i < generations; i++) {
+    tree.nextGeneration();
+  }
+  // the cache lists nodes in the order of its own hash, and inserting them
+  // in that order clusters them, so they go in the order they were made
+  auto indices = QuadTreeNode::cachedIndices();
+  sort(indices.begin(), indices.end());
+  auto live = QuadTreeNode::diagnoseCache();
+  cout << "hashes: " << indices.size() << " nodes from " << generations
+       << " generations of a 256x256 soup, cache load " << live.load
+       << ", mean probe " << live.meanProbe << endl;
+
+  benchHash<LegacyHash>("legacy", indices);
+  benchHash<MixHash>("mix", indices);
+  benchHash<WyHash>("wyhash", indices);
+  if (Crc32Hash::available) {
+    benchHash<Crc32Hash>("crc32", indices);
+  }
+}
+
+/**
+ * Runs a random soup on Hashlife, reporting how many distinct nodes it made
+ * and the memory they take per node, including the intern table.
+ */
+static void benchNodes(unsigned int generations) {
+  QuadTree tree = soup(256);
+
+  auto start = chrono::steady_clock::now();
+  for (unsigned int i = 0; i < generations; i++) {
+    tree.nextGeneration();
+  }
+  auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+                     chrono::steady_clock::now() - start)
+                     .count();
+
+  size_t nodes = QuadTreeNode::cacheSize();
+  cout << "nodes: " << generations << " generations of a 256x256 soup in "
+       << elapsed << "ms, population " << tree.population() << endl;
+  cout << "  " << nodes << " nodes of " << sizeof(QuadTreeNode) << " bytes, "
+       << double(QuadTreeNode::arenaBytes()) / nodes
+       << " bytes per node with the intern table" << endl;
+}
+
+/**
+ * Returns a count of the CPU's reference cycles, or of nanoseconds where it
+ * has no such counter.
+ */
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return chrono::duration_cast<chrono::nanoseconds>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/**
+ * Steps a pattern one generation at a time with prefetching on or off, on a
+ * fresh thread each time so every run starts from an empty arena and cache,
+ * reporting the best of a few runs in cycles per node nextGeneration had to
+ * work out rather than found memoized, and how large the arena grew.
+ */
+static void benchRecursion(const string &name, function<QuadTree()> make,
+                           unsigned int generations, bool prefetching) {
+  const unsigned int runs = 3;
+  bool wasPrefetching = QuadTreeNode::getPrefetching();
+  QuadTreeNode::setPrefetching(prefetching);
+
+  double best = 0;
+  uint64_t nodes = 0;
+  uint64_t population = 0;
+  size_t bytes = 0;
+  for (unsigned int run = 0; run < runs; run++) {
+    uint64_t elapsed = 0;
+    thread worker([&]() {
+      QuadTree tree = make();
+      tree.setHistoryLimit(0);
+      QuadTreeNode::resetStats();
+      uint64_t start = cycles();
+      for (unsigned int i = 0; i < generations; i++) {
+        tree.nextGeneration();
+      }
+      elapsed = cycles() - start;
+      nodes = QuadTreeNode::getStats().nextMisses;
+      population = tree.population();
+      bytes = QuadTreeNode::arenaBytes();
+    });
+    worker.join();
+    double perNode = double(elapsed) / nodes;
+    best = run == 0 || perNode < best ? perNode : best;
+  }
+  QuadTreeNode::setPrefetching(wasPrefetching);
+
+  cout << "  " << name << " prefetching " << (prefetching ? "on" : "off")
+       << ": " << best << " cycles per node, " << nodes << " nodes, "
+       << bytes / (1 << 20) << " MB of arena, population " << population
+       << endl;
+}
+
+/**
+ * Runs the same soups on one thread and then on one per core, reporting the
+ * soups searched per second of each and how much the extra threads sped
+ * the search up. The census is the same either way, which is checked.
+ */
+static void benchSoups(uint64_t soups) {
+  unsigned int cores = thread::hardware_concurrency();
+  cout << "soups: " << soups << " 16x16 soups at 50%" << endl;
+
+  double single = 0;
+  auto census = vector<pair<string, uint64_t>>();
+  auto counts = vector<unsigned int>{1};
+  if (cores > 1) {
+    counts.push_back(cores);
+  }
+  for (unsigned int threads : counts) {
+    auto options = SoupSearch::defaultOptions();
+    options.soups = soups;
+    options.threads = threads;
+    auto report = SoupSearch(options).run();
+
+    double rate = report.soups / report.seconds;
+    cout << "  " << report.threads << " threads: " << rate
+         << " soups per second, " << report.generations / report.seconds
+         << " generations per second";
+    if (threads == 1) {
+      single = rate;
+      census = report.census.sorted();
+      cout << endl;
+      continue;
+    }
+    cout << ", " << rate / single << "x one thread" << endl;
+    if (report.census.sorted() != census) {
+      throw "The census changed with the thread count.";
+    }
+  }
+  if (cores <= 1) {
+    cout << "  only one core, so nothing to scale to" << endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  string mode = argc > 1 ? argv[1] : "kernel";
+
+  try {
+    if (mode == "kernel") {
+      benchKernel(Rule(argc > 2 ? argv[2] : "B3/S23"));
+    } else if (mode == "nodes") {
+      benchNodes(argc > 2 ? stoi(argv[2]) : 2000);
+    } else if (mode == "hashes") {
+      benchHashes(argc > 2 ? stoi(argv[2]) : 1000);
+    } else if (mode == "soups") {
+      benchSoups(argc > 2 ? stoull(argv[2]) : 200);
+    } else if (mode == "recursion") {
+      unsigned int generations = argc > 2 ? stoi(argv[2]) : 2000;
+      string prefetch = argc > 3 ? argv[3] : "both";
+      cout << "recursion: " << generations << " generations" << endl;
+      // a large soup instead, for a DAG that outgrows the last level cache
+      auto patterns = vector<pair<string, function<QuadTree()>>>();
+      if (argc > 4) {
+        int64_t side = stoll(argv[4]);
+        patterns.push_back(make_pair(
+            to_string(side) + "x" + to_string(side) + " soup",
+            [side]() { return soup(side); }));
+      } else {
+        for (string file : {"examples/lidka.life", "examples/backrake3.life"}) {
+          patterns.push_back(make_pair(file, [file]() {
+            return QuadTree(InputParser::readFile(file));
+          }));
+        }
+      }
+      for (auto const &pattern : patterns) {
+        if (prefetch != "on") {
+          benchRecursion(pattern.first, pattern.second, generations, false);
+        }
+        if (prefetch != "off") {
+          benchRecursion(pattern.first, pattern.second, generations, true);
+        }
+      }
+    } else {
+      cout << "Usage: ./benchmark kernel [rule] | nodes [generations] | "
+              "hashes [generations] | "
+              "recursion [generations] [on|off|both] [soup side] | "
+              "soups [soups]"
+           << endl;
+      return -1;
+    }
+  } catch (const char *e) {
+    cout << e << endl;
+    return -1;
+  }
+  return 0;
+}
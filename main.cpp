@@ -1,10 +1,23 @@
+#include "BatchRunner.hpp"
+#include "Census.hpp"
+#include "Classifier.hpp"
+#include "DagStream.hpp"
 #include "Game.hpp"
 #include "InputParser.hpp"
 #include "QuadTree.hpp"
 #include "QuadTreeNode.hpp"
+#include "QueryServer.hpp"
+#include "Rule.hpp"
+#include "Simulator.hpp"
+#include "SoupSearch.hpp"
+#include "Stabilizer.hpp"
 #include <SDL2/SDL.h>
+#include <chrono>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -12,23 +25,357 @@ using namespace std;
 
 const unsigned int WIDTH = 800;
 const unsigned int HEIGHT = 600;
+// nodes cached before a stream collects garbage, which resends its tree
+const size_t STREAM_GARBAGE_LIMIT = 1 << 22;
+// nodes a shared arena made by this process has room for
+const uint64_t DEFAULT_SHARED_CAPACITY = 1 << 24;
+
+/**
+ * Runs without a window, stepping until the pattern settles and/or jumping to
+ * a target generation, and prints what happened. A pattern that settles
+ * before the end of --until-stable is jumped the rest of the way with
+ * hyperspeed, unless --generations names another target.
+ */
+int runHeadless(QuadTree &tree, map<string, string> &options) {
+  if (options.count("until-stable")) {
+    uint64_t end =
+        tree.getGeneration() + InputParser::strToInt64(options["until-stable"]);
+    Stabilizer stabilizer = Stabilizer(tree);
+    auto result = stabilizer.run(end - tree.getGeneration());
+    if (result.stable) {
+      cout << "Stabilized at generation " << result.generation
+           << " with population " << result.population << " and period "
+           << result.period << " (noticed at generation " << result.detectedAt
+           << ")" << endl;
+      if (!options.count("generations") && tree.getGeneration() < end) {
+        // settled patterns are regular, so the power-of-two jumps of seek
+        // are memoized after the first few
+        tree.seek(end);
+        cout << "Generation " << tree.getGeneration() << ": population "
+             << tree.population() << endl;
+      }
+    } else {
+      cout << "Not stable after " << tree.getGeneration()
+           << " generations, population " << result.population << endl;
+    }
+  }
+
+  if (options.count("generations")) {
+    // hyperspeed covers any stretch, but is only worth it once the pattern
+    // is regular, such as after settling. Earlier targets are reached from
+    // the checkpoint before them.
+    tree.seek(InputParser::strToInt64(options["generations"]));
+    cout << "Generation " << tree.getGeneration() << ": population "
+         << tree.population() << endl;
+  }
+
+  if (options.count("census")) {
+    Census census;
+    Classifier classifier;
+    census.addAsh(tree.getLivingCells(), classifier);
+    auto entries = census.sorted();
+    size_t shown = InputParser::strToInt64(options["census"]);
+    cout << census.objects() << " objects, " << entries.size()
+         << " distinct, " << classifier.getMisses() << " run to classify"
+         << endl;
+    for (size_t i = 0; i < entries.size() && i < shown; i++) {
+      cout << "  " << entries[i].second << " " << entries[i].first << endl;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Runs random soups across every core until they settle, and prints the
+ * census of their ash, most common objects first.
+ */
+int runSoupSearch(map<string, string> &options) {
+  auto search = SoupSearch::defaultOptions();
+  search.soups = InputParser::strToInt64(options["soup-search"]);
+  if (options.count("soup-size")) {
+    search.size = InputParser::strToInt64(options["soup-size"]);
+  }
+  if (options.count("density")) {
+    search.density = InputParser::strToInt64(options["density"]) / 100.0;
+  }
+  if (options.count("seed")) {
+    search.seed = InputParser::strToInt64(options["seed"]);
+  }
+  if (options.count("threads")) {
+    search.threads = InputParser::strToInt64(options["threads"]);
+  }
+  if (options.count("until-stable")) {
+    search.maxGenerations = InputParser::strToInt64(options["until-stable"]);
+  }
+
+  auto report = SoupSearch(search).run();
+  cout << "Searched " << report.soups << " " << search.size << "x"
+       << search.size << " soups at " << search.density * 100 << "% on "
+       << report.threads << " threads in " << report.seconds << "s ("
+       << report.soups / report.seconds << " soups/second, "
+       << report.generations / report.seconds << " generations/second), "
+       << report.unstable << " not stable after " << search.maxGenerations
+       << " generations" << endl;
+  cout << report.census.objects() << " objects:" << endl;
+  for (auto const &entry : report.census.sorted()) {
+    cout << "  " << entry.second << " " << entry.first << endl;
+  }
+  return 0;
+}
+
+/**
+ * Runs every life file in a batch list to its generation on every core, and
+ * writes a tab separated record for each to --output or the standard output.
+ */
+int runBatch(map<string, string> &options) {
+  ifstream list(options["batch"]);
+  if (!list) {
+    throw "Could not open batch list.";
+  }
+  uint64_t generations = 0;
+  if (options.count("generations")) {
+    generations = InputParser::strToInt64(options["generations"]);
+  }
+  auto jobs = BatchRunner::readJobs(list, generations);
+
+  unsigned int threads = 0;
+  if (options.count("threads")) {
+    threads = InputParser::strToInt64(options["threads"]);
+  }
+  auto caches = BatchRunner::ISOLATED;
+  if (options.count("caches")) {
+    caches = BatchRunner::cachesNamed(options["caches"]);
+  }
+
+  ofstream file;
+  ostream *out = &cout;
+  if (options.count("output")) {
+    file.open(options["output"]);
+    if (!file) {
+      throw "Could not open output file.";
+    }
+    out = &file;
+  }
+
+  BatchRunner runner = BatchRunner(threads, caches);
+  *out << BatchRunner::header() << endl;
+  auto start = chrono::steady_clock::now();
+  auto records = runner.run(jobs, out);
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  size_t failed = 0;
+  for (auto const &record : records) {
+    failed += record.error.empty() ? 0 : 1;
+  }
+  // kept off the standard output, which may be holding the records
+  cerr << "Ran " << records.size() << " files on " << runner.getThreads()
+       << " threads in " << seconds << "s (" << records.size() / seconds
+       << " files/second), " << failed << " failed" << endl;
+  return failed == 0 ? 0 : 1;
+}
+
+/**
+ * Steps the pattern, writing a frame of the nodes new in each generation to
+ * a file, or the standard output for "-", for a viewer to rebuild.
+ */
+int runStream(QuadTree &tree, map<string, string> &options) {
+  uint64_t frames = 100;
+  uint64_t step = 1;
+  if (options.count("frames")) {
+    frames = InputParser::strToInt64(options["frames"]);
+  }
+  if (options.count("step")) {
+    step = InputParser::strToInt64(options["step"]);
+  }
+  if (frames == 0) {
+    throw "A stream needs at least one frame.";
+  }
+
+  ofstream file;
+  ostream *out = &cout;
+  if (options["stream"] != "-") {
+    file.open(options["stream"], ios::binary);
+    if (!file) {
+      throw "Could not open stream file.";
+    }
+    out = &file;
+  }
+
+  // nothing rewinds, so past roots would only hold nodes in the cache
+  tree.setHistoryLimit(0);
+  DagStreamWriter writer = DagStreamWriter(*out);
+  uint64_t bytes = 0;
+  uint64_t nodes = 0;
+  uint64_t coordinates = 0;
+  for (uint64_t frame = 0; frame < frames; frame++) {
+    if (frame > 0) {
+      tree.advance(step);
+      if (QuadTreeNode::cacheSize() > STREAM_GARBAGE_LIMIT) {
+        tree.collectGarbage();
+      }
+    }
+    auto stats = writer.write(tree.root, tree.getGeneration());
+    bytes += stats.bytes;
+    nodes += stats.nodes;
+    coordinates += tree.population() * 2 * sizeof(int64_t);
+  }
+  // kept off the standard output, which may be holding the stream
+  cerr << "Streamed " << frames << " frames in " << bytes << " bytes ("
+       << bytes / frames << " per frame, " << nodes << " nodes), against "
+       << coordinates << " bytes as coordinates" << endl;
+  return 0;
+}
+
+/**
+ * Rebuilds every frame of a node stream from a file, or the standard input
+ * for "-", and prints what each holds.
+ */
+int runWatchStream(map<string, string> &options) {
+  ifstream file;
+  istream *in = &cin;
+  if (options["watch-stream"] != "-") {
+    file.open(options["watch-stream"], ios::binary);
+    if (!file) {
+      throw "Could not open stream file.";
+    }
+    in = &file;
+  }
+
+  DagStreamReader reader = DagStreamReader(*in);
+  DagStreamReader::Frame frame;
+  while (reader.read(frame)) {
+    QuadTree tree = QuadTree(frame.root);
+    Rect box = tree.boundingBox();
+    cout << "Generation " << frame.generation << ": population "
+         << tree.population();
+    if (!box.isEmpty()) {
+      cout << " in (" << box.minX << ", " << box.minY << ") to ("
+           << box.maxX << ", " << box.maxY << ")";
+    }
+    cout << ", " << frame.nodes << " new nodes"
+         << (frame.reset ? " after a reset" : "") << ", "
+         << reader.knownNodes() << " known" << endl;
+  }
+  return 0;
+}
+
+/**
+ * Prints every way the program can be run.
+ */
+void printUsage() {
+  cout << "Usage: ./conway [--rule B3/S23] [--torus size | --bounded size] "
+          "[--engine auto|hashlife|dense] "
+          "[--until-stable max] [--generations target] [--census top] "
+          "[--serve socket [--save-dir dir]] [--stream file|- [--frames 100] [--step 1]] "
+          "{(x0, y0) (x1, y1) ... (xN, yN)} | {-f file.life}"
+       << endl;
+  cout << "       ./conway [--rule B3/S23] --soup-search soups "
+          "[--soup-size 16] [--density 50] [--seed 1] [--threads n] "
+          "[--until-stable max]"
+       << endl;
+  cout << "       ./conway [--rule B3/S23] --batch list "
+          "[--generations target] [--threads n] "
+          "[--caches isolated|shared] [--output file]"
+       << endl;
+  cout << "       ./conway --watch-stream file|-" << endl;
+  cout << "Any of them can take [--shared-arena name [--shared-capacity "
+          "nodes]] to share nodes with every process using the same name."
+       << endl;
+}
 
 int main(int argc, char *argv[]) {
+  map<string, string> options;
+  vector<char *> args;
+
+  try {
+    args = InputParser::extractOptions(argc, argv, options);
+
+    if (options.count("rule")) {
+      QuadTreeNode::setRule(Rule(options["rule"]));
+    }
+    // before this thread makes any node, so that its nodes are shared too
+    if (options.count("shared-arena")) {
+      uint64_t capacity = DEFAULT_SHARED_CAPACITY;
+      if (options.count("shared-capacity")) {
+        capacity = InputParser::strToInt64(options["shared-capacity"]);
+      }
+      if (capacity > UINT32_MAX) {
+        throw "Shared arenas hold at most 2^32 nodes.";
+      }
+      QuadTreeNode::shareArena(options["shared-arena"], capacity);
+    }
+  } catch (const char *e) {
+    cout << e << endl;
+    printUsage();
+    return -1;
+  }
+
   vector<pair<int64_t, int64_t>> points;
+  QuadTree tree;
+  Simulator::Engine engine = Simulator::HASHLIFE;
+  bool automatic = true;
 
   try {
-    points = InputParser::getPoints(argc, argv);
+    if (options.count("soup-search")) {
+      return runSoupSearch(options);
+    }
+    if (options.count("batch")) {
+      return runBatch(options);
+    }
+    if (options.count("watch-stream")) {
+      return runWatchStream(options);
+    }
+
+    points = InputParser::getPoints(args.size(), args.data());
+
+    if (options.count("torus")) {
+      tree = QuadTree(points, QuadTree::TORUS,
+                      QuadTree::heightForSize(
+                          InputParser::strToInt64(options["torus"])));
+    } else if (options.count("bounded")) {
+      tree = QuadTree(points, QuadTree::BOUNDED,
+                      QuadTree::heightForSize(
+                          InputParser::strToInt64(options["bounded"])));
+    } else {
+      tree = QuadTree(points);
+    }
+
+    if (options.count("engine")) {
+      if (options["engine"] == "dense") {
+        engine = Simulator::DENSE;
+        automatic = false;
+      } else if (options["engine"] == "hashlife") {
+        automatic = false;
+      } else if (options["engine"] != "auto") {
+        throw "Engine must be auto, hashlife or dense.";
+      }
+    }
+
+    if (options.count("until-stable") || options.count("generations") ||
+        options.count("census")) {
+      return runHeadless(tree, options);
+    }
+    if (options.count("stream")) {
+      return runStream(tree, options);
+    }
+    if (options.count("serve")) {
+      // nothing rewinds, so past roots would only hold nodes in the cache
+      tree.setHistoryLimit(0);
+      QueryServer server(tree, options["serve"], options["save-dir"]);
+      cout << "Serving on " << options["serve"] << endl;
+      server.run();
+      return 0;
+    }
   } catch (const char *e) {
     cout << e << endl;
-    cout << "Usage: ./conway {(x0, y0) (x1, y1) ... (xN, yN)} | {-f file.life}"
-         << endl;
+    printUsage();
     return -1;
   }
 
-  QuadTree tree = QuadTree(points);
   Game *game;
   try {
-    game = new Game(WIDTH, HEIGHT, tree);
+    game = new Game(WIDTH, HEIGHT, tree, engine, automatic);
   } catch (const char *e) {
     cout << e;
     return -1;
@@ -39,6 +386,9 @@ int main(int argc, char *argv[]) {
   cout << "  * Left bracket to zoom out, right bracket to zoom in." << endl;
   cout << "  * Minus to slow down the simulation, equals to speed it up."
        << endl;
+  cout << "  * Space to pause, comma to step back a generation, period to "
+          "step forward."
+       << endl;
   cout << "  * Escape to quit." << endl;
 
   while (!game->shouldQuit) {
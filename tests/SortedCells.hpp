@@ -0,0 +1,18 @@
+#ifndef SORTEDCELLS_HPP
+#define SORTEDCELLS_HPP
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Returns cells in order, so that lists of cells collected in different
+ * orders by different engines compare equal when they hold the same cells.
+ */
+inline std::vector<std::pair<int64_t, int64_t>>
+sorted(std::vector<std::pair<int64_t, int64_t>> cells) {
+  std::sort(cells.begin(), cells.end());
+  return cells;
+}
+
+#endif // SORTEDCELLS_HPP
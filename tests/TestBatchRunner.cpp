@@ -0,0 +1,93 @@
+#include "../BatchRunner.hpp"
+#include "catch.hpp"
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("Batch runner", "[BatchRunner]") {
+  SECTION("Batch lists give each file its own or the default generation") {
+    std::istringstream list("# patterns\n"
+                            "examples/glider.life 100\n"
+                            "\n"
+                            "  examples/acorn.life\n");
+    auto jobs = BatchRunner::readJobs(list, 7);
+
+    REQUIRE(2 == jobs.size());
+    REQUIRE("examples/glider.life" == jobs[0].path);
+    REQUIRE(100 == jobs[0].generations);
+    REQUIRE("examples/acorn.life" == jobs[1].path);
+    REQUIRE(7 == jobs[1].generations);
+  }
+
+  SECTION("Malformed batch lines are refused") {
+    std::istringstream extra("examples/glider.life 100 200\n");
+    REQUIRE_THROWS(BatchRunner::readJobs(extra, 0));
+    std::istringstream negative("examples/glider.life -5\n");
+    REQUIRE_THROWS(BatchRunner::readJobs(negative, 0));
+    std::istringstream word("examples/glider.life soon\n");
+    REQUIRE_THROWS(BatchRunner::readJobs(word, 0));
+    REQUIRE_THROWS(BatchRunner::cachesNamed("global"));
+  }
+
+  SECTION("Each file is run to its generation") {
+    auto jobs = std::vector<BatchRunner::Job>{
+        BatchRunner::Job{"examples/glider.life", 100},
+        BatchRunner::Job{"examples/acorn.life", 5206}};
+    auto records = BatchRunner(2, BatchRunner::ISOLATED).run(jobs, nullptr);
+
+    REQUIRE(2 == records.size());
+    REQUIRE("examples/glider.life" == records[0].path);
+    REQUIRE(100 == records[0].generation);
+    REQUIRE(5 == records[0].population);
+    REQUIRE(records[0].box.maxX - records[0].box.minX == 2);
+    REQUIRE(records[0].error.empty());
+    REQUIRE(5206 == records[1].generation);
+    REQUIRE(633 == records[1].population);
+    REQUIRE(records[1].nodes > 0);
+  }
+
+  SECTION("Records don't depend on the caches or the threads") {
+    auto jobs = std::vector<BatchRunner::Job>();
+    for (unsigned int i = 0; i < 3; i++) {
+      jobs.push_back(BatchRunner::Job{"examples/acorn.life", 1000 * i});
+      jobs.push_back(BatchRunner::Job{"examples/gliderGun.life", 500 * i});
+      jobs.push_back(BatchRunner::Job{"examples/pulsar.life", 7 * i});
+    }
+    auto single = BatchRunner(1, BatchRunner::ISOLATED).run(jobs, nullptr);
+    auto shared = BatchRunner(1, BatchRunner::SHARED).run(jobs, nullptr);
+    auto parallel = BatchRunner(3, BatchRunner::SHARED).run(jobs, nullptr);
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+      REQUIRE(single[i].path == jobs[i].path);
+      REQUIRE(single[i].generation == jobs[i].generations);
+      REQUIRE(single[i].population == shared[i].population);
+      REQUIRE(single[i].population == parallel[i].population);
+      REQUIRE(single[i].box == shared[i].box);
+      REQUIRE(single[i].box == parallel[i].box);
+    }
+    // later files reuse the nodes of earlier ones instead of starting over
+    REQUIRE(shared.back().nodes > single.back().nodes);
+  }
+
+  SECTION("A file that can't be run doesn't stop the batch") {
+    auto jobs = std::vector<BatchRunner::Job>{
+        BatchRunner::Job{"examples/missing.life", 10},
+        BatchRunner::Job{"examples/glider.life", 4}};
+    std::ostringstream out;
+    auto records = BatchRunner(2, BatchRunner::ISOLATED).run(jobs, &out);
+
+    REQUIRE(!records[0].error.empty());
+    REQUIRE(records[0].box.isEmpty());
+    REQUIRE(records[1].error.empty());
+
+    std::istringstream lines(out.str());
+    std::string first;
+    std::string second;
+    std::getline(lines, first);
+    std::getline(lines, second);
+    REQUIRE(0 == first.find("examples/missing.life\t0\t0\t-\t-\t-\t-\t"));
+    REQUIRE(first.find("\tok") == std::string::npos);
+    REQUIRE(0 == second.find("examples/glider.life\t4\t5\t"));
+    REQUIRE(second.size() - 3 == second.rfind("\tok"));
+  }
+}
@@ -0,0 +1,131 @@
+#include "../Census.hpp"
+#include "../Classifier.hpp"
+#include "../QuadTree.hpp"
+#include "../Stabilizer.hpp"
+#include "catch.hpp"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Census separation", "[Census]") {
+  SECTION("Cells touching at a corner belong to the same object") {
+    auto objects = Census::separate({{0, 0}, {1, 1}, {2, 2}, {5, 5}});
+
+    REQUIRE(2 == objects.size());
+    auto diagonal = Census::Cells{{0, 0}, {1, 1}, {2, 2}};
+    auto single = Census::Cells{{5, 5}};
+    REQUIRE(diagonal == objects[0]);
+    REQUIRE(single == objects[1]);
+  }
+
+  SECTION("A one cell gap separates objects") {
+    auto objects = Census::separate(
+        {{0, 0}, {1, 0}, {0, 1}, {1, 1}, {3, 0}, {4, 0}, {3, 1}, {4, 1}});
+
+    REQUIRE(2 == objects.size());
+    REQUIRE(4 == objects[0].size());
+    REQUIRE(4 == objects[1].size());
+  }
+
+  SECTION("Arms that only meet further south are one object") {
+    auto objects = Census::separate({{0, 0}, {4, 0}, {0, 1}, {4, 1}, {1, 2},
+                                     {2, 2}, {3, 2}, {2, 0}, {7, 0}});
+
+    REQUIRE(3 == objects.size());
+    REQUIRE(7 == objects[0].size());
+    REQUIRE((Census::Cells{{2, 0}}) == objects[1]);
+    REQUIRE((Census::Cells{{7, 0}}) == objects[2]);
+  }
+
+  SECTION("No cells make no objects") {
+    REQUIRE(Census::separate(Census::Cells()).empty());
+  }
+}
+
+TEST_CASE("Census codes", "[Census]") {
+  SECTION("Still lifes get the Wechsler codes apgsearch gives them") {
+    REQUIRE("33" == Census::canonicalCode({{0, 0}, {1, 0}, {0, 1}, {1, 1}}));
+    REQUIRE("696" == Census::canonicalCode(
+                         {{1, 0}, {2, 0}, {0, 1}, {3, 1}, {1, 2}, {2, 2}}));
+    REQUIRE("253" ==
+            Census::canonicalCode({{0, 0}, {1, 0}, {0, 1}, {2, 1}, {1, 2}}));
+    REQUIRE("6996" ==
+            Census::canonicalCode({{1, 0}, {2, 0}, {0, 1}, {3, 1}, {0, 2},
+                                   {3, 2}, {1, 3}, {2, 3}}));
+  }
+
+  SECTION("Rotated and reflected copies share a code") {
+    auto glider = Census::Cells{{1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}};
+    auto flipped = Census::Cells();
+    auto turned = Census::Cells();
+    for (auto const &cell : glider) {
+      flipped.push_back(std::make_pair(-cell.first + 7, cell.second));
+      turned.push_back(std::make_pair(cell.second, -cell.first - 3));
+    }
+
+    REQUIRE("153" == Census::canonicalCode(glider));
+    REQUIRE("153" == Census::canonicalCode(flipped));
+    REQUIRE("153" == Census::canonicalCode(turned));
+  }
+
+  SECTION("Orienting moves cells to start at (0, 0) and sorts them") {
+    auto oriented = Census::orient({{5, 3}, {4, 3}, {4, 2}}, 0);
+    auto mirrored = Census::orient({{5, 3}, {4, 3}, {4, 2}}, 1);
+
+    REQUIRE((Census::Cells{{0, 0}, {0, 1}, {1, 1}}) == oriented);
+    REQUIRE((Census::Cells{{0, 1}, {1, 0}, {1, 1}}) == mirrored);
+  }
+
+  SECTION("Tall objects are cut into strips of five rows") {
+    auto column = Census::Cells();
+    for (int64_t y = 0; y < 7; y++) {
+      column.push_back(std::make_pair(int64_t(0), y));
+    }
+
+    REQUIRE("vz3" == Census::wechsler(column));
+  }
+
+  SECTION("Runs of empty columns are shortened") {
+    REQUIRE("101" == Census::wechsler({{0, 0}, {2, 0}}));
+    REQUIRE("1w1" == Census::wechsler({{0, 0}, {3, 0}}));
+    REQUIRE("1x1" == Census::wechsler({{0, 0}, {4, 0}}));
+    REQUIRE("1y01" == Census::wechsler({{0, 0}, {5, 0}}));
+    REQUIRE("1yz1" == Census::wechsler({{0, 0}, {40, 0}}));
+  }
+}
+
+TEST_CASE("Census tallies", "[Census]") {
+  SECTION("The R-pentomino's ash holds its well known 25 objects") {
+    QuadTree tree = QuadTree({{0, -1}, {1, -1}, {-1, 0}, {0, 0}, {0, 1}});
+    REQUIRE(Stabilizer(tree).run(5000).stable);
+
+    Census census;
+    Classifier classifier;
+    census.addAsh(tree.getLivingCells(), classifier);
+
+    REQUIRE(25 == census.objects());
+    REQUIRE(8 == census.count("xs4_33"));
+    REQUIRE(6 == census.count("xq4_153"));
+    REQUIRE(4 == census.count("xs6_696"));
+    REQUIRE(4 == census.count("xp2_7"));
+    REQUIRE(1 == census.count("xs5_253"));
+    REQUIRE(1 == census.count("xs7_2596"));
+    REQUIRE(1 == census.count("xs6_356"));
+    REQUIRE("xs4_33" == census.sorted().front().first);
+  }
+
+  SECTION("Merging adds the counts of both") {
+    Census a;
+    Census b;
+    a.add("xs4_33", 2);
+    b.add("xs4_33", 3);
+    b.add("xp2_7", 1);
+    a.merge(b);
+
+    REQUIRE(5 == a.count("xs4_33"));
+    REQUIRE(1 == a.count("xp2_7"));
+    REQUIRE(0 == a.count("xs6_696"));
+    REQUIRE(6 == a.objects());
+  }
+}
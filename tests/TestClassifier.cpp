@@ -0,0 +1,76 @@
+#include "../Census.hpp"
+#include "../Classifier.hpp"
+#include "catch.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Classifier", "[Classifier]") {
+  Classifier classifier;
+
+  SECTION("Still lifes are named by their population") {
+    auto const &block = classifier.classify({{5, 5}, {6, 5}, {5, 6}, {6, 6}});
+
+    REQUIRE(Classifier::STILL_LIFE == block.kind);
+    REQUIRE(1 == block.period);
+    REQUIRE("xs4_33" == block.code);
+  }
+
+  SECTION("Oscillators are named by their period and lowest phase") {
+    auto const &blinker = classifier.classify({{0, 0}, {1, 0}, {2, 0}});
+    auto const &toad = classifier.classify(
+        {{1, 0}, {2, 0}, {3, 0}, {0, 1}, {1, 1}, {2, 1}});
+
+    REQUIRE(Classifier::OSCILLATOR == blinker.kind);
+    REQUIRE(2 == blinker.period);
+    REQUIRE("xp2_7" == blinker.code);
+    REQUIRE(Classifier::OSCILLATOR == toad.kind);
+    REQUIRE("xp2_7e" == toad.code);
+  }
+
+  SECTION("Spaceships are named by their period and know their speed") {
+    auto const &glider =
+        classifier.classify({{1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}});
+    auto const &lwss = classifier.classify({{1, 0}, {4, 0}, {0, 1}, {0, 2},
+                                            {4, 2}, {0, 3}, {1, 3}, {2, 3},
+                                            {3, 3}});
+
+    REQUIRE(Classifier::SPACESHIP == glider.kind);
+    REQUIRE(4 == glider.period);
+    REQUIRE(1 == glider.dx);
+    REQUIRE(1 == glider.dy);
+    REQUIRE("xq4_153" == glider.code);
+    REQUIRE(Classifier::SPACESHIP == lwss.kind);
+    REQUIRE(-2 == lwss.dx);
+    REQUIRE(0 == lwss.dy);
+    REQUIRE("xq4_6frc" == lwss.code);
+  }
+
+  SECTION("Objects that die or change on their own are unknown") {
+    auto const &single = classifier.classify({{0, 0}});
+    auto const &preblock = classifier.classify({{0, 0}, {1, 0}, {0, 1}});
+
+    REQUIRE(Classifier::UNKNOWN == single.kind);
+    REQUIRE("zz_1" == single.code);
+    REQUIRE(Classifier::UNKNOWN == preblock.kind);
+    REQUIRE(0 == preblock.period);
+  }
+
+  SECTION("Every phase and orientation of a classified object is known") {
+    classifier.classify({{0, 0}, {1, 0}, {2, 0}});
+    REQUIRE(1 == classifier.getMisses());
+    REQUIRE(0 == classifier.getHits());
+
+    auto const &vertical = classifier.classify({{9, 3}, {9, 4}, {9, 5}});
+    REQUIRE("xp2_7" == vertical.code);
+
+    auto glider = Census::Cells{{1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}};
+    classifier.classify(glider);
+    // the glider turned and reflected, two generations on
+    auto later = Census::Cells{{0, 0}, {2, 0}, {1, 1}, {2, 1}, {1, 2}};
+    REQUIRE("xq4_153" == classifier.classify(later).code);
+    REQUIRE(2 == classifier.getMisses());
+    REQUIRE(2 == classifier.getHits());
+    REQUIRE(2 * 8 + 4 * 8 >= classifier.knownShapes());
+  }
+}
@@ -0,0 +1,122 @@
+#include "../DagStream.hpp"
+#include "../InputParser.hpp"
+#include "../QuadTree.hpp"
+#include "SortedCells.hpp"
+#include "catch.hpp"
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Node streams", "[DagStream]") {
+  SECTION("Every frame rebuilds as the same root") {
+    QuadTree tree = QuadTree(InputParser::readFile("examples/gliderGun.life"));
+    tree.setHistoryLimit(0);
+    std::stringstream stream;
+    DagStreamWriter writer = DagStreamWriter(stream);
+    DagStreamReader reader = DagStreamReader(stream);
+
+    for (unsigned int i = 0; i < 60; i++) {
+      auto stats = writer.write(tree.root, tree.getGeneration());
+      REQUIRE(stats.reset == (i == 0));
+
+      DagStreamReader::Frame frame;
+      REQUIRE(reader.read(frame));
+      REQUIRE(tree.getGeneration() == frame.generation);
+      REQUIRE(stats.nodes == frame.nodes);
+      // read on the same thread, the nodes are hash-consed into the same ones
+      REQUIRE(tree.root == frame.root);
+      tree.nextGeneration();
+    }
+    DagStreamReader::Frame frame;
+    REQUIRE(!reader.read(frame));
+  }
+
+  SECTION("Unchanged nodes aren't sent again") {
+    auto block = std::vector<std::pair<int64_t, int64_t>>{
+        {0, 0}, {1, 0}, {0, 1}, {1, 1}};
+    QuadTree tree = QuadTree(block);
+    std::ostringstream stream;
+    DagStreamWriter writer = DagStreamWriter(stream);
+
+    // the first step frames the block differently, after which the root
+    // stays the same
+    auto first = writer.write(tree.root, 0);
+    tree.nextGeneration();
+    writer.write(tree.root, 1);
+    tree.nextGeneration();
+    auto still = writer.write(tree.root, 2);
+
+    REQUIRE(first.nodes > 0);
+    REQUIRE(0 == still.nodes);
+    REQUIRE(still.bytes <= 4);
+  }
+
+  SECTION("A reader on another thread rebuilds the same cells") {
+    QuadTree tree = QuadTree(InputParser::readFile("examples/acorn.life"));
+    tree.setHistoryLimit(0);
+    std::stringstream stream;
+    DagStreamWriter writer = DagStreamWriter(stream);
+    auto expected = std::vector<std::vector<std::pair<int64_t, int64_t>>>();
+    uint64_t sent = 0;
+    for (unsigned int i = 0; i < 40; i++) {
+      sent += writer.write(tree.root, tree.getGeneration()).nodes;
+      expected.push_back(sorted(tree.getLivingCells()));
+      tree.advance(25);
+      if (i == 20) {
+        // indices may be reused from here on, so everything is sent again
+        tree.collectGarbage();
+      }
+    }
+
+    auto rebuilt = std::vector<std::vector<std::pair<int64_t, int64_t>>>();
+    auto resets = std::vector<uint64_t>();
+    uint64_t received = 0;
+    const char *error = nullptr;
+    std::thread viewer([&]() {
+      try {
+        DagStreamReader reader = DagStreamReader(stream);
+        DagStreamReader::Frame frame;
+        while (reader.read(frame)) {
+          QuadTree copy = QuadTree(frame.root);
+          rebuilt.push_back(sorted(copy.getLivingCells()));
+          received += frame.nodes;
+          if (frame.reset) {
+            resets.push_back(frame.generation);
+          }
+        }
+      } catch (const char *e) {
+        error = e;
+      }
+    });
+    viewer.join();
+
+    REQUIRE(error == nullptr);
+    REQUIRE(expected == rebuilt);
+    REQUIRE(sent == received);
+    auto collected = std::vector<uint64_t>{0, 21 * 25};
+    REQUIRE(collected == resets);
+  }
+
+  SECTION("Broken streams are refused") {
+    QuadTree tree = QuadTree(InputParser::readFile("examples/glider.life"));
+    std::ostringstream written;
+    DagStreamWriter writer = DagStreamWriter(written);
+    writer.write(tree.root, 0);
+    std::string bytes = written.str();
+
+    std::istringstream truncated(bytes.substr(0, bytes.size() - 1));
+    DagStreamReader cut = DagStreamReader(truncated);
+    DagStreamReader::Frame frame;
+    REQUIRE_THROWS(cut.read(frame));
+
+    std::istringstream wrong("QTDX" + bytes.substr(4));
+    DagStreamReader magic = DagStreamReader(wrong);
+    REQUIRE_THROWS(magic.read(frame));
+
+    std::istringstream empty("");
+    DagStreamReader nothing = DagStreamReader(empty);
+    REQUIRE(!nothing.read(frame));
+  }
+}
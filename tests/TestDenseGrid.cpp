@@ -0,0 +1,102 @@
+#include "../DenseGrid.hpp"
+#include "../QuadTree.hpp"
+#include "../QuadTreeNode.hpp"
+#include "../Rule.hpp"
+#include "SortedCells.hpp"
+#include "catch.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+TEST_CASE("DenseGrid cells", "[DenseGrid]") {
+  SECTION("Cells set alive report alive across tile boundaries") {
+    DenseGrid grid = DenseGrid();
+    grid.setCellAlive(0, 0);
+    grid.setCellAlive(-1, -1);
+    grid.setCellAlive(63, 64);
+    grid.setCellAlive(-65, 200);
+
+    REQUIRE(true == grid.getCellAlive(0, 0));
+    REQUIRE(true == grid.getCellAlive(-1, -1));
+    REQUIRE(true == grid.getCellAlive(63, 64));
+    REQUIRE(true == grid.getCellAlive(-65, 200));
+    REQUIRE(false == grid.getCellAlive(-1, 0));
+    REQUIRE(false == grid.getCellAlive(64, 64));
+    REQUIRE(4 == grid.population());
+    REQUIRE(4 == grid.tileCount());
+  }
+
+  SECTION("Rules the dense engine can't run throw") {
+    QuadTreeNode::setRule(Rule("B2/S/C3"));
+    REQUIRE_THROWS(DenseGrid());
+    QuadTreeNode::setRule(Rule());
+  }
+}
+
+TEST_CASE("DenseGrid nextGeneration", "[DenseGrid]") {
+  SECTION("A blinker straddling four tiles oscillates") {
+    auto points =
+        std::vector<std::pair<int64_t, int64_t>>{{-1, 0}, {0, 0}, {1, 0}};
+    DenseGrid grid = DenseGrid(points);
+
+    grid.nextGeneration();
+    REQUIRE(sorted(grid.getLivingCells()) ==
+            sorted({{0, -1}, {0, 0}, {0, 1}}));
+
+    grid.nextGeneration();
+    REQUIRE(sorted(grid.getLivingCells()) == sorted(points));
+  }
+
+  SECTION("Acorn matches the quad tree for 300 generations, under Conway and "
+          "HighLife") {
+    auto acorn = std::vector<std::pair<int64_t, int64_t>>{
+        {-2, -1}, {0, 0}, {-3, 1}, {-2, 1}, {1, 1}, {2, 1}, {3, 1}};
+
+    for (auto const &name : {"B3/S23", "B36/S23"}) {
+      QuadTreeNode::setRule(Rule(name));
+      QuadTree tree = QuadTree(acorn);
+      DenseGrid grid = DenseGrid(tree);
+
+      for (int i = 0; i < 300; i++) {
+        tree.nextGeneration();
+        grid.nextGeneration();
+      }
+      QuadTreeNode::setRule(Rule());
+
+      REQUIRE(tree.population() == grid.population());
+      REQUIRE(sorted(tree.getLivingCells()) == sorted(grid.getLivingCells()));
+    }
+  }
+
+  SECTION("Converting back to a quad tree keeps every cell") {
+    auto points = std::vector<std::pair<int64_t, int64_t>>{
+        {-100, 5}, {0, 0}, {63, 63}, {64, 64}, {1000, -1000}};
+    DenseGrid grid = DenseGrid(points);
+    QuadTree tree = grid.toQuadTree();
+
+    REQUIRE(5 == tree.population());
+    REQUIRE(sorted(tree.getLivingCells()) == sorted(points));
+  }
+}
+
+TEST_CASE("DenseGrid region queries", "[DenseGrid]") {
+  auto points = std::vector<std::pair<int64_t, int64_t>>{
+      {-100, 5}, {0, 0}, {63, 63}, {64, 64}, {1000, -1000}};
+  DenseGrid grid = DenseGrid(points);
+  QuadTree tree = QuadTree(points);
+
+  SECTION("The bounding box matches the quad tree's") {
+    REQUIRE(tree.boundingBox() == grid.boundingBox());
+    REQUIRE(DenseGrid().boundingBox().isEmpty());
+  }
+
+  SECTION("Populations in rectangles match the quad tree's") {
+    for (auto const &box :
+         {Rect{-100, -1000, 1000, 64}, Rect{0, 0, 63, 63}, Rect{1, 1, 63, 64},
+          Rect{-1, -1, 0, 0}, Rect{64, 64, 64, 64}, Rect{65, 65, 999, 999},
+          Rect{INT64_MIN, INT64_MIN, INT64_MAX, INT64_MAX}}) {
+      REQUIRE(tree.populationIn(box) == grid.populationIn(box));
+    }
+    REQUIRE(3 == grid.populationIn(Rect{0, 0, 64, 64}));
+  }
+}
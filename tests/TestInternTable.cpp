@@ -0,0 +1,73 @@
+#include "../InternTable.hpp"
+#include "../NodeHash.hpp"
+#include "../QuadTree.hpp"
+#include "../QuadTreeNode.hpp"
+#include "catch.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Interns every cached node into a table hashed with Hash, checks each one
+ * is found again, and returns the table's diagnostics.
+ */
+template <typename Hash>
+static TableDiagnostics internEveryNode(const std::vector<uint32_t> &indices) {
+  const QuadTreeNode *arena = QuadTreeNode::getArena();
+  InternTable<QuadTreeNode, Hash> table;
+  for (uint32_t index : indices) {
+    REQUIRE(0 == table.find(arena[index], arena));
+    table.insert(index, arena);
+  }
+  for (uint32_t index : indices) {
+    REQUIRE(index == table.find(arena[index], arena));
+  }
+  REQUIRE(indices.size() == table.size());
+  return table.diagnose(arena);
+}
+
+TEST_CASE("InternTable hash policies", "[InternTable]") {
+  QuadTree tree = QuadTree({{0, 0}, {1, 0}, {1, -2}, {3, -1}, {4, 0},
+                            {5, 0}, {6, 0}});
+  for (int i = 0; i < 100; i++) {
+    tree.nextGeneration();
+  }
+  auto indices = QuadTreeNode::cachedIndices();
+
+  SECTION("Every policy finds every node it interned") {
+    internEveryNode<LegacyHash>(indices);
+    internEveryNode<MixHash>(indices);
+    internEveryNode<WyHash>(indices);
+    internEveryNode<Crc32Hash>(indices);
+  }
+
+  SECTION("Diagnostics count every entry by its probe length") {
+    auto diagnostics = internEveryNode<MixHash>(indices);
+    size_t counted = 0;
+    for (size_t count : diagnostics.probes) {
+      counted += count;
+    }
+
+    REQUIRE(indices.size() == diagnostics.entries);
+    REQUIRE(indices.size() == counted);
+    REQUIRE(diagnostics.load <= 0.7);
+    REQUIRE(diagnostics.longestCluster > diagnostics.maxProbe);
+  }
+
+  SECTION("The legacy hash sends every empty node to the same slot") {
+    for (unsigned int height = 1; height < 8; height++) {
+      auto lower = QuadTreeNode::createEmptyAtHeight(height - 1);
+      auto empty = QuadTreeNode::createEmptyAtHeight(height);
+
+      REQUIRE(LegacyHash()(*lower) == LegacyHash()(*empty));
+      REQUIRE(MixHash()(*lower) != MixHash()(*empty));
+      REQUIRE(WyHash()(*lower) != WyHash()(*empty));
+    }
+  }
+
+  SECTION("The cache's own diagnostics cover every cached node") {
+    auto diagnostics = QuadTreeNode::diagnoseCache();
+    REQUIRE(QuadTreeNode::cacheSize() == diagnostics.entries);
+    REQUIRE(diagnostics.maxProbe < diagnostics.entries);
+  }
+}
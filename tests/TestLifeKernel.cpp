@@ -0,0 +1,86 @@
+#include "../LifeKernel.hpp"
+#include "../QuadTreeNode.hpp"
+#include "../Rule.hpp"
+#include "catch.hpp"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * Steps random rows at every instruction set level and returns each result.
+ */
+static std::vector<std::vector<uint64_t>> stepAtEveryLevel(const Rule &rule,
+                                                           size_t count) {
+  std::mt19937_64 random(42);
+  auto rows = std::vector<uint64_t>(count + 2);
+  auto west = std::vector<uint64_t>(count + 2);
+  auto east = std::vector<uint64_t>(count + 2);
+  for (size_t i = 0; i < count + 2; i++) {
+    rows[i] = random();
+    west[i] = (rows[i] << 1) | (random() & 1);
+    east[i] = (rows[i] >> 1) | (random() << 63);
+  }
+
+  auto results = std::vector<std::vector<uint64_t>>();
+  for (auto level : {LifeKernel::SCALAR, LifeKernel::SSE2, LifeKernel::AVX2}) {
+    auto out = std::vector<uint64_t>(count);
+    LifeKernel::setLevel(level);
+    LifeKernel::stepRows(rows.data(), west.data(), east.data(), out.data(),
+                         count, rule);
+    results.push_back(out);
+  }
+  LifeKernel::setLevel(LifeKernel::detect());
+  return results;
+}
+
+TEST_CASE("LifeKernel stepRows", "[LifeKernel]") {
+  SECTION("Every instruction set level agrees with scalar, including rows "
+          "left over past the vector width") {
+    for (auto const &name : {"B3/S23", "B36/S23", "B2/S", "B3678/S34678"}) {
+      auto results = stepAtEveryLevel(Rule(name), 67);
+      REQUIRE(results[0] == results[1]);
+      REQUIRE(results[0] == results[2]);
+    }
+  }
+
+  SECTION("A row of three cells becomes a column") {
+    uint64_t rows[5] = {0, 0, 0x7, 0, 0};
+    uint64_t west[5], east[5], out[3];
+    for (int i = 0; i < 5; i++) {
+      west[i] = rows[i] << 1;
+      east[i] = rows[i] >> 1;
+    }
+    LifeKernel::stepRows(rows, west, east, out, 3, Rule());
+
+    REQUIRE(0x2 == out[0]);
+    REQUIRE(0x2 == out[1]);
+    REQUIRE(0x2 == out[2]);
+  }
+}
+
+TEST_CASE("LifeKernel stepBaseCases", "[LifeKernel]") {
+  SECTION("Batched base cases match the neighborhood lookup for every 4x4 "
+          "block") {
+    for (auto const &name : {"B3/S23", "B36/S238"}) {
+      Rule rule = Rule(name);
+      auto batched = QuadTreeNode::generateBaseTable(rule);
+
+      for (unsigned int index = 0; index < batched.size(); index += 97) {
+        uint8_t expected = 0;
+        for (unsigned int cell = 0; cell < 4; cell++) {
+          unsigned int x = 1 + (cell & 1);
+          unsigned int y = 1 + (cell >> 1);
+          unsigned int neighborhood = 0;
+          for (unsigned int dy = 0; dy < 3; dy++) {
+            for (unsigned int dx = 0; dx < 3; dx++) {
+              unsigned int bit = (y + dy - 1) * 4 + (x + dx - 1);
+              neighborhood |= ((index >> bit) & 1) << (dy * 3 + dx);
+            }
+          }
+          expected |= rule.next(neighborhood) << cell;
+        }
+        REQUIRE(expected == batched[index]);
+      }
+    }
+  }
+}
@@ -1,6 +1,10 @@
 #include "../QuadTree.hpp"
+#include "SortedCells.hpp"
 #include "catch.hpp"
+#include <algorithm>
 #include <cstdint>
+#include <iterator>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -166,12 +170,99 @@ TEST_CASE("QuadTree growth", "[QuadTree]") {
     QuadTree tree = QuadTree{};
 
     for (int i = 0; i < 10; i++) {
-      REQUIRE(i + 1 == tree.root->height);
+      REQUIRE(i + 1 == tree.root->height());
       tree.growTree(1);
     }
 
     REQUIRE(11 == tree.height());
   }
+
+  SECTION("Stepping only grows the root while cells are near its border") {
+    auto block = std::vector<std::pair<int64_t, int64_t>>{
+        {0, 0}, {1, 0}, {0, 1}, {1, 1}};
+    QuadTree tree = QuadTree(block);
+    tree.nextGeneration();
+    unsigned int height = tree.height();
+
+    for (int i = 0; i < 10; i++) {
+      QuadTreeNode::resetStats();
+      tree.nextGeneration();
+      auto const &stats = QuadTreeNode::getStats();
+
+      REQUIRE(height == tree.height());
+      REQUIRE(stats.internHits + stats.internMisses <= 3);
+      REQUIRE(0 == stats.internMisses);
+    }
+    REQUIRE(sorted(block) == sorted(tree.getLivingCells()));
+  }
+
+  SECTION("A root with room around its cells steps without growing") {
+    auto blinker = std::vector<std::pair<int64_t, int64_t>>{
+        {-1, 0}, {0, 0}, {1, 0}};
+    QuadTree warm = QuadTree(blinker);
+    warm.growTree(3);
+    warm.nextGeneration();
+
+    // the same root again, whose next generation is now memoized
+    QuadTree tree = QuadTree(blinker);
+    tree.growTree(3);
+    unsigned int height = tree.height();
+    QuadTreeNode::resetStats();
+    tree.nextGeneration();
+
+    REQUIRE(height - 1 == tree.height());
+    REQUIRE(0 == QuadTreeNode::getStats().internMisses);
+    REQUIRE(0 == QuadTreeNode::getStats().nextMisses);
+    REQUIRE(tree.getCellAlive(0, -1));
+    REQUIRE(tree.getCellAlive(0, 1));
+    REQUIRE(3 == tree.population());
+  }
+
+  SECTION("An empty universe steps without interning anything") {
+    QuadTree tree = QuadTree{};
+    QuadTreeNode::resetStats();
+    for (int i = 0; i < 10; i++) {
+      tree.nextGeneration();
+    }
+
+    REQUIRE(0 == QuadTreeNode::getStats().internHits +
+                     QuadTreeNode::getStats().internMisses);
+    REQUIRE(0 == tree.population());
+  }
+
+  SECTION("A quiet stretch only compacts the root to look for a period") {
+    auto blinker = std::vector<std::pair<int64_t, int64_t>>{
+        {-1, 0}, {0, 0}, {1, 0}};
+    QuadTree watched = QuadTree(blinker);
+    QuadTree quiet = QuadTree(blinker);
+    quiet.setPeriodWindow(0);
+    for (int i = 0; i < 10; i++) {
+      watched.nextGeneration();
+      quiet.nextGeneration();
+    }
+
+    QuadTreeNode::resetStats();
+    for (int i = 0; i < 100; i++) {
+      watched.nextGeneration();
+    }
+    uint64_t watchedInterns = QuadTreeNode::getStats().internHits +
+                              QuadTreeNode::getStats().internMisses;
+    QuadTreeNode::resetStats();
+    for (int i = 0; i < 100; i++) {
+      quiet.nextGeneration();
+    }
+    uint64_t quietInterns = QuadTreeNode::getStats().internHits +
+                            QuadTreeNode::getStats().internMisses;
+
+    REQUIRE(2 == watched.getPeriod());
+    REQUIRE(0 == quiet.getPeriod());
+    REQUIRE(0 == QuadTreeNode::getStats().internMisses);
+    // only the root's growth back to a height with room is looked up
+    REQUIRE(quietInterns <= 100 * 3);
+    REQUIRE(quietInterns < watchedInterns);
+    REQUIRE(sorted(watched.getLivingCells()) ==
+            sorted(quiet.getLivingCells()));
+  }
 }
 
 TEST_CASE("QuadTree update", "[QuadTree]") {
@@ -283,7 +374,7 @@ TEST_CASE("QuadTree update", "[QuadTree]") {
         std::vector<std::pair<int64_t, int64_t>>{i0, i1, i2, i3, i4, i5};
 
     QuadTree tree = QuadTree(points);
-    unsigned int originalHeight = tree.root->height;
+    unsigned int originalHeight = tree.root->height();
 
     REQUIRE(true == tree.getCellAlive(big, -1));
     REQUIRE(true == tree.getCellAlive(big, 0));
@@ -356,3 +447,472 @@ TEST_CASE("QuadTree update", "[QuadTree]") {
     REQUIRE(1 == tree.height());
   }
 }
+
+TEST_CASE("QuadTree topologies", "[QuadTree]") {
+  auto glider = std::vector<std::pair<int64_t, int64_t>>{
+      {-1, -2}, {0, -1}, {-2, 0}, {-1, 0}, {0, 0}};
+
+  SECTION("A glider on an 8x8 torus wraps back to where it started after 32 "
+          "generations, without the tree growing") {
+    QuadTree tree = QuadTree(glider, QuadTree::TORUS, 3);
+    auto start = tree.root;
+
+    for (int i = 0; i < 32; i++) {
+      tree.nextGeneration();
+      REQUIRE(3 == tree.height());
+      REQUIRE(5 == tree.population());
+    }
+
+    REQUIRE(start == tree.root);
+  }
+
+  SECTION("Cells set outside of a torus wrap around") {
+    QuadTree tree = QuadTree(std::vector<std::pair<int64_t, int64_t>>(),
+                             QuadTree::TORUS, 3);
+    tree.setCellAlive(4, -5);
+    tree.setCellAlive(-13, 11);
+
+    REQUIRE(true == tree.getCellAlive(-4, 3));
+    REQUIRE(true == tree.getCellAlive(3, 3));
+    REQUIRE(3 == tree.height());
+  }
+
+  SECTION("A blinker on the edge of a bounded universe is clipped") {
+    auto points = std::vector<std::pair<int64_t, int64_t>>{
+        {-2, -1}, {-2, 0}, {-2, 1}, {7, 7}};
+    QuadTree tree = QuadTree(points, QuadTree::BOUNDED, 2);
+
+    REQUIRE(3 == tree.population());
+
+    tree.nextGeneration();
+
+    REQUIRE(2 == tree.height());
+    REQUIRE(2 == tree.population());
+    REQUIRE(true == tree.getCellAlive(-2, 0));
+    REQUIRE(true == tree.getCellAlive(-1, 0));
+  }
+
+  SECTION("Universe sizes must be powers of two") {
+    REQUIRE(3 == QuadTree::heightForSize(8));
+    REQUIRE_THROWS(QuadTree::heightForSize(12));
+    REQUIRE_THROWS(QuadTree::heightForSize(1));
+  }
+}
+
+TEST_CASE("QuadTree period detection", "[QuadTree]") {
+  SECTION("A block repeats with period 1") {
+    QuadTree tree = QuadTree({{0, 0}, {1, 0}, {0, 1}, {1, 1}});
+    REQUIRE(0 == tree.getPeriod());
+
+    tree.nextGeneration();
+
+    REQUIRE(1 == tree.getPeriod());
+    REQUIRE(1 == tree.getGeneration());
+  }
+
+  SECTION("A blinker repeats with period 2, and a row of ten cells settles "
+          "into a pentadecathlon with period 15") {
+    QuadTree blinker = QuadTree({{-1, 0}, {0, 0}, {1, 0}});
+    QuadTree row = QuadTree();
+    for (int64_t x = -5; x < 5; x++) {
+      row.setCellAlive(x, 0);
+    }
+
+    blinker.nextGeneration();
+    REQUIRE(0 == blinker.getPeriod());
+    blinker.nextGeneration();
+    REQUIRE(2 == blinker.getPeriod());
+
+    for (int i = 0; i < 40; i++) {
+      row.nextGeneration();
+    }
+    REQUIRE(15 == row.getPeriod());
+  }
+
+  SECTION("A glider on the plane never repeats, but on a torus it repeats "
+          "once it wraps back to where it started") {
+    auto glider = std::vector<std::pair<int64_t, int64_t>>{
+        {-1, -2}, {0, -1}, {-2, 0}, {-1, 0}, {0, 0}};
+    QuadTree plane = QuadTree(glider);
+    QuadTree torus = QuadTree(glider, QuadTree::TORUS, 3);
+
+    for (int i = 0; i < 40; i++) {
+      plane.nextGeneration();
+      torus.nextGeneration();
+    }
+
+    REQUIRE(0 == plane.getPeriod());
+    REQUIRE(32 == torus.getPeriod());
+  }
+
+  SECTION("Repeats older than the period window are forgotten") {
+    auto glider = std::vector<std::pair<int64_t, int64_t>>{
+        {-1, -2}, {0, -1}, {-2, 0}, {-1, 0}, {0, 0}};
+    QuadTree torus = QuadTree(glider, QuadTree::TORUS, 3);
+    torus.setPeriodWindow(16);
+
+    for (int i = 0; i < 40; i++) {
+      torus.nextGeneration();
+    }
+
+    REQUIRE(0 == torus.getPeriod());
+  }
+
+  SECTION("Setting a cell starts the history over") {
+    QuadTree tree = QuadTree({{0, 0}, {1, 0}, {0, 1}, {1, 1}});
+    tree.nextGeneration();
+    tree.setCellAlive(10, 10);
+
+    REQUIRE(0 == tree.getPeriod());
+    REQUIRE(0 == tree.getGeneration());
+  }
+}
+
+TEST_CASE("QuadTree spaceship detection", "[QuadTree]") {
+  auto glider = std::vector<std::pair<int64_t, int64_t>>{
+      {-1, -2}, {0, -1}, {-2, 0}, {-1, 0}, {0, 0}};
+
+  SECTION("The bounding box covers every living cell") {
+    QuadTree tree = QuadTree(glider);
+    Rect box = tree.boundingBox();
+    REQUIRE((-2 == box.minX && -2 == box.minY && 0 == box.maxX &&
+             0 == box.maxY));
+
+    tree.setCellAlive(1000, -7);
+    box = tree.boundingBox();
+    REQUIRE((-2 == box.minX && -7 == box.minY && 1000 == box.maxX &&
+             0 == box.maxY));
+    REQUIRE(QuadTree().boundingBox().isEmpty());
+  }
+
+  SECTION("Populations in rectangles count only the cells inside") {
+    QuadTree tree = QuadTree(glider);
+    tree.setCellAlive(1000, -7);
+
+    REQUIRE(6 == tree.populationIn(tree.boundingBox()));
+    REQUIRE(5 == tree.populationIn(Rect{-2, -2, 0, 0}));
+    REQUIRE(3 == tree.populationIn(Rect{-1, -1, 0, 0}));
+    REQUIRE(1 == tree.populationIn(Rect{1, -100, 5000, 100}));
+    REQUIRE(0 == tree.populationIn(Rect{1, -6, 5000, 100}));
+    REQUIRE(0 == tree.populationIn(Rect::empty()));
+    REQUIRE(6 == tree.populationIn(
+                     Rect{INT64_MIN, INT64_MIN, INT64_MAX, INT64_MAX}));
+  }
+
+  SECTION("A glider repeats every 4 generations, one cell further south "
+          "east") {
+    QuadTree tree = QuadTree(glider);
+    tree.setDetectTranslation(true);
+
+    for (int i = 0; i < 3; i++) {
+      tree.nextGeneration();
+    }
+    REQUIRE(0 == tree.getPeriod());
+
+    tree.nextGeneration();
+    REQUIRE(4 == tree.getPeriod());
+    REQUIRE(std::make_pair(int64_t(1), int64_t(1)) == tree.getDisplacement());
+  }
+
+  SECTION("A lightweight spaceship repeats every 4 generations, two cells "
+          "further west") {
+    QuadTree tree = QuadTree({{1, 0}, {4, 0}, {0, 1}, {0, 2}, {4, 2}, {0, 3},
+                              {1, 3}, {2, 3}, {3, 3}});
+    tree.setDetectTranslation(true);
+
+    for (int i = 0; i < 100; i++) {
+      tree.nextGeneration();
+    }
+    REQUIRE(4 == tree.getPeriod());
+    REQUIRE(std::make_pair(int64_t(-2), int64_t(0)) == tree.getDisplacement());
+  }
+
+  SECTION("Oscillators repeat without moving, and spaceships are missed with "
+          "detection off") {
+    QuadTree blinker = QuadTree({{-1, 0}, {0, 0}, {1, 0}});
+    QuadTree plain = QuadTree(glider);
+    blinker.setDetectTranslation(true);
+
+    for (int i = 0; i < 8; i++) {
+      blinker.nextGeneration();
+      plain.nextGeneration();
+    }
+    REQUIRE(2 == blinker.getPeriod());
+    REQUIRE(std::make_pair(int64_t(0), int64_t(0)) ==
+            blinker.getDisplacement());
+    REQUIRE(0 == plain.getPeriod());
+  }
+}
+
+TEST_CASE("QuadTree hyperspeed", "[QuadTree]") {
+  auto acorn = std::vector<std::pair<int64_t, int64_t>>{
+      {0, 0}, {1, 0}, {1, -2}, {3, -1}, {4, 0}, {5, 0}, {6, 0}};
+
+  SECTION("Jumping a power of two generations matches stepping them one at "
+          "a time") {
+    QuadTree stepped = QuadTree(acorn);
+    for (unsigned int log2Steps = 0; log2Steps <= 7; log2Steps++) {
+      QuadTree jumped = QuadTree(acorn);
+      jumped.advance(stepped.getGeneration());
+      jumped.jump(log2Steps);
+      for (unsigned int i = 0; i < 1u << log2Steps; i++) {
+        stepped.nextGeneration();
+      }
+
+      REQUIRE(stepped.getGeneration() == jumped.getGeneration());
+      REQUIRE(sorted(stepped.getLivingCells()) ==
+              sorted(jumped.getLivingCells()));
+    }
+  }
+
+  SECTION("Advancing any amount of generations matches stepping them") {
+    QuadTree stepped = QuadTree(acorn);
+    QuadTree advanced = QuadTree(acorn);
+    for (int i = 0; i < 333; i++) {
+      stepped.nextGeneration();
+    }
+    advanced.advance(333);
+
+    REQUIRE(333 == advanced.getGeneration());
+    REQUIRE(sorted(stepped.getLivingCells()) ==
+            sorted(advanced.getLivingCells()));
+  }
+
+  SECTION("Jumps on a torus wrap like single steps do") {
+    auto glider = std::vector<std::pair<int64_t, int64_t>>{
+        {-1, -2}, {0, -1}, {-2, 0}, {-1, 0}, {0, 0}};
+    QuadTree stepped = QuadTree(glider, QuadTree::TORUS, 3);
+    QuadTree jumped = QuadTree(glider, QuadTree::TORUS, 3);
+    for (int i = 0; i < 21; i++) {
+      stepped.nextGeneration();
+    }
+    jumped.advance(21);
+
+    REQUIRE(3 == jumped.height());
+    REQUIRE(stepped.root == jumped.root);
+  }
+}
+
+TEST_CASE("QuadTree prefetching", "[QuadTree]") {
+  auto acorn = std::vector<std::pair<int64_t, int64_t>>{
+      {0, 0}, {1, 0}, {1, -2}, {3, -1}, {4, 0}, {5, 0}, {6, 0}};
+
+  SECTION("Prefetching ahead of the recursion changes nothing it works out") {
+    auto cells = std::vector<std::vector<std::pair<int64_t, int64_t>>>(2);
+    auto misses = std::vector<uint64_t>(2);
+    for (int prefetching = 0; prefetching < 2; prefetching++) {
+      QuadTreeNode::setPrefetching(prefetching == 1);
+      // on a thread of its own, so nothing is memoized yet
+      std::thread worker([&]() {
+        QuadTree tree = QuadTree(acorn);
+        QuadTreeNode::resetStats();
+        for (int i = 0; i < 500; i++) {
+          tree.nextGeneration();
+        }
+        cells[prefetching] = sorted(tree.getLivingCells());
+        misses[prefetching] = QuadTreeNode::getStats().nextMisses;
+      });
+      worker.join();
+    }
+    QuadTreeNode::setPrefetching(false);
+
+    REQUIRE(cells[0] == cells[1]);
+    REQUIRE(misses[0] == misses[1]);
+  }
+}
+
+TEST_CASE("QuadTree seeking", "[QuadTree]") {
+  auto acorn = std::vector<std::pair<int64_t, int64_t>>{
+      {0, 0}, {1, 0}, {1, -2}, {3, -1}, {4, 0}, {5, 0}, {6, 0}};
+  QuadTree stepped = QuadTree(acorn);
+  auto generations = std::vector<std::vector<std::pair<int64_t, int64_t>>>();
+  for (int i = 0; i <= 300; i++) {
+    generations.push_back(sorted(stepped.getLivingCells()));
+    stepped.nextGeneration();
+  }
+
+  SECTION("Seeking forwards and backwards matches stepping") {
+    QuadTree tree = QuadTree(acorn);
+    for (uint64_t target : {300, 5, 77, 0, 256, 255, 129, 300, 1}) {
+      tree.seek(target);
+
+      REQUIRE(target == tree.getGeneration());
+      REQUIRE(generations[target] == sorted(tree.getLivingCells()));
+    }
+  }
+
+  SECTION("Seeking leaves checkpoints at powers of two") {
+    QuadTree tree = QuadTree(acorn);
+    tree.seek(300);
+    auto pinned = tree.pinnedRoots();
+    tree.seek(256);
+    auto checkpoint = tree.root;
+    tree.seek(300);
+    tree.seek(256);
+
+    REQUIRE(checkpoint == tree.root);
+    REQUIRE(pinned.end() !=
+            std::find(pinned.begin(), pinned.end(), checkpoint));
+  }
+
+  SECTION("Setting a cell drops the checkpoints") {
+    QuadTree tree = QuadTree(acorn);
+    tree.seek(64);
+    tree.setCellAlive(100, 100);
+    tree.seek(1);
+
+    REQUIRE(1 == tree.getGeneration());
+    REQUIRE(false == tree.getCellAlive(100, 100));
+  }
+}
+
+TEST_CASE("QuadTree diff", "[QuadTree]") {
+  auto acorn = std::vector<std::pair<int64_t, int64_t>>{
+      {0, 0}, {1, 0}, {1, -2}, {3, -1}, {4, 0}, {5, 0}, {6, 0}};
+
+  SECTION("Born and died cells match comparing every cell") {
+    QuadTree tree = QuadTree(acorn);
+    for (int i = 0; i < 200; i++) {
+      auto earlier = tree.root;
+      auto before = sorted(tree.getLivingCells());
+      tree.nextGeneration();
+      auto after = sorted(tree.getLivingCells());
+
+      auto born = std::vector<std::pair<int64_t, int64_t>>();
+      auto died = std::vector<std::pair<int64_t, int64_t>>();
+      std::set_difference(after.begin(), after.end(), before.begin(),
+                          before.end(), std::back_inserter(born));
+      std::set_difference(before.begin(), before.end(), after.begin(),
+                          after.end(), std::back_inserter(died));
+
+      auto changes = tree.changesSince(earlier);
+      REQUIRE(born == sorted(changes.born));
+      REQUIRE(died == sorted(changes.died));
+    }
+  }
+
+  SECTION("Nothing changes between a root and itself, or a still life") {
+    QuadTree block = QuadTree({{0, 0}, {1, 0}, {0, 1}, {1, 1}});
+    auto earlier = block.root;
+    block.nextGeneration();
+
+    REQUIRE(block.changesSince(block.root).born.empty());
+    REQUIRE(block.changesSince(earlier).born.empty());
+    REQUIRE(block.changesSince(earlier).died.empty());
+    REQUIRE(block.changedRegionsSince(earlier, 2).empty());
+  }
+
+  SECTION("Changed regions cover every changed cell") {
+    QuadTree blinker = QuadTree({{-1, 0}, {0, 0}, {1, 0}});
+    auto earlier = blinker.root;
+    blinker.nextGeneration();
+    auto regions = blinker.changedRegionsSince(earlier, 0);
+    auto changes = blinker.changesSince(earlier);
+
+    REQUIRE(4 == regions.size());
+    REQUIRE(2 == changes.born.size());
+    REQUIRE(2 == changes.died.size());
+    for (auto const &cell : changes.born) {
+      auto cellRect = Rect{cell.first, cell.second, cell.first, cell.second};
+      REQUIRE(regions.end() !=
+              std::find(regions.begin(), regions.end(), cellRect));
+    }
+  }
+}
+
+TEST_CASE("QuadTree history", "[QuadTree]") {
+  auto acorn = std::vector<std::pair<int64_t, int64_t>>{
+      {0, 0}, {1, 0}, {1, -2}, {3, -1}, {4, 0}, {5, 0}, {6, 0}};
+
+  SECTION("Rewinding restores the exact earlier roots, and forward replays "
+          "them") {
+    QuadTree tree = QuadTree(acorn);
+    auto roots = std::vector<QuadTreeNode *>{tree.root};
+    for (int i = 0; i < 50; i++) {
+      tree.nextGeneration();
+      roots.push_back(tree.root);
+    }
+
+    for (int i = 49; i >= 0; i--) {
+      REQUIRE(true == tree.rewind());
+      REQUIRE(roots[i] == tree.root);
+      REQUIRE(uint64_t(i) == tree.getGeneration());
+    }
+    REQUIRE(false == tree.rewind());
+    REQUIRE(50 == tree.futureSize());
+
+    for (int i = 1; i <= 50; i++) {
+      REQUIRE(true == tree.forward());
+      REQUIRE(roots[i] == tree.root);
+    }
+    REQUIRE(0 == tree.futureSize());
+    REQUIRE(false == tree.forward());
+    REQUIRE(51 == tree.getGeneration());
+  }
+
+  SECTION("Stepping after rewinding drops the rewound generations") {
+    QuadTree tree = QuadTree(acorn);
+    for (int i = 0; i < 10; i++) {
+      tree.nextGeneration();
+    }
+    tree.rewind();
+    tree.rewind();
+    auto eighth = tree.root;
+    tree.nextGeneration();
+
+    REQUIRE(0 == tree.futureSize());
+    REQUIRE(9 == tree.getGeneration());
+    REQUIRE(true == tree.rewind());
+    REQUIRE(eighth == tree.root);
+  }
+
+  SECTION("History is bounded by its limit") {
+    QuadTree tree = QuadTree(acorn);
+    tree.setHistoryLimit(8);
+    for (int i = 0; i < 20; i++) {
+      tree.nextGeneration();
+    }
+
+    REQUIRE(8 == tree.historySize());
+    for (int i = 0; i < 8; i++) {
+      REQUIRE(true == tree.rewind());
+    }
+    REQUIRE(false == tree.rewind());
+    REQUIRE(12 == tree.getGeneration());
+  }
+}
+
+TEST_CASE("QuadTree garbage collection", "[QuadTree]") {
+  SECTION("Collecting keeps the root and its history intact") {
+    QuadTree tree = QuadTree({{0, 0}, {1, 0}, {1, -2}, {3, -1}, {4, 0},
+                              {5, 0}, {6, 0}});
+    tree.setHistoryLimit(4);
+    for (int i = 0; i < 100; i++) {
+      tree.nextGeneration();
+    }
+    auto cells = sorted(tree.getLivingCells());
+    QuadTree reference = QuadTree(tree.getLivingCells());
+
+    size_t before = QuadTreeNode::cacheSize();
+    // the reference must survive too, as nodes are shared
+    auto pinned = tree.pinnedRoots();
+    pinned.push_back(reference.root);
+    size_t freed = QuadTreeNode::collectGarbage(pinned);
+
+    REQUIRE(freed > 0);
+    REQUIRE(before - freed == QuadTreeNode::cacheSize());
+    REQUIRE(cells == sorted(tree.getLivingCells()));
+
+    for (int i = 0; i < 4; i++) {
+      REQUIRE(true == tree.rewind());
+    }
+    REQUIRE(96 == tree.getGeneration());
+    for (int i = 0; i < 4; i++) {
+      tree.forward();
+    }
+    tree.nextGeneration();
+    reference.nextGeneration();
+    REQUIRE(sorted(reference.getLivingCells()) ==
+            sorted(tree.getLivingCells()));
+  }
+}
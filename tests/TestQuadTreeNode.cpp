@@ -1,15 +1,75 @@
+#include "../NodeHash.hpp"
 #include "../QuadTreeNode.hpp"
 #include "catch.hpp"
+#include <set>
+
+/**
+ * Returns how many distinct hashes Hash gives the leaves of every state.
+ */
+template <typename Hash> static size_t distinctLeafHashes() {
+  auto hashes = std::set<size_t>();
+  for (unsigned int state = 0; state < 256; state++) {
+    hashes.insert(Hash()(QuadTreeNode(uint8_t(state))));
+  }
+  return hashes.size();
+}
+
+/**
+ * Returns whether hashing node from its quad indices and height gives the
+ * slot hashing the node itself does.
+ */
+template <typename Hash> static bool hashesByQuads(const QuadTreeNode *node) {
+  return Hash()(*node) == Hash()(node->quad(0), node->quad(1), node->quad(2),
+                                 node->quad(3), node->height());
+}
 
 TEST_CASE("QuadTreeNode population sizes", "[QuadTreeNode]") {
   SECTION("Empty nodes have a population of 0") {
     auto node = QuadTreeNode::retrieve(false);
-    REQUIRE(0 == node->population);
+    REQUIRE(0 == node->population());
   }
 
   SECTION("Alive nodes with no children have a population of 1") {
     auto node = QuadTreeNode::retrieve(true);
-    REQUIRE(1 == node->population);
+    REQUIRE(1 == node->population());
+  }
+
+  SECTION("Dying nodes have a population of 0 but are not empty") {
+    auto node = QuadTreeNode::retrieveState(2);
+    REQUIRE(0 == node->population());
+    REQUIRE(true == node->alive());
+    REQUIRE(2 == node->state());
+    REQUIRE(node != QuadTreeNode::retrieve(false));
+    REQUIRE(node == QuadTreeNode::retrieveState(2));
+  }
+
+  SECTION("Leaves of different states never share a hash") {
+    // dying states have the population of a dead leaf, so they must be told
+    // apart by their state alone
+    REQUIRE(256 == distinctLeafHashes<LegacyHash>());
+    REQUIRE(256 == distinctLeafHashes<MixHash>());
+    REQUIRE(256 == distinctLeafHashes<WyHash>());
+    if (Crc32Hash::available) {
+      REQUIRE(256 == distinctLeafHashes<Crc32Hash>());
+    }
+  }
+
+  SECTION("Nodes hash the same from their quad indices and height") {
+    auto alive = QuadTreeNode::retrieve(true);
+    auto empty = QuadTreeNode::retrieve(false);
+    auto mixed = QuadTreeNode::retrieve(alive, empty, alive, alive);
+    auto full = QuadTreeNode::retrieve(alive, alive, alive, alive);
+    auto above = QuadTreeNode::retrieve(mixed, full, full, mixed);
+
+    for (auto node : {mixed, full, above}) {
+      REQUIRE(hashesByQuads<MixHash>(node));
+      REQUIRE(hashesByQuads<WyHash>(node));
+      REQUIRE(hashesByQuads<Crc32Hash>(node));
+    }
+    // the legacy hash can only tell dead quads apart by loading them
+    REQUIRE(hashesByQuads<LegacyHash>(full));
+    REQUIRE(hashesByQuads<LegacyHash>(above));
+    REQUIRE_FALSE(hashesByQuads<LegacyHash>(mixed));
   }
 
   SECTION("Nodes with children have a population equal to their children") {
@@ -22,14 +82,43 @@ TEST_CASE("QuadTreeNode population sizes", "[QuadTreeNode]") {
     auto four = QuadTreeNode::retrieve(alive, alive, alive, alive);
     auto eight = QuadTreeNode::retrieve(zero, one, three, four);
 
-    REQUIRE(1 == alive->population);
-    REQUIRE(0 == empty->population);
-    REQUIRE(0 == zero->population);
-    REQUIRE(1 == one->population);
-    REQUIRE(2 == two->population);
-    REQUIRE(3 == three->population);
-    REQUIRE(4 == four->population);
-    REQUIRE(8 == eight->population);
+    REQUIRE(1 == alive->population());
+    REQUIRE(0 == empty->population());
+    REQUIRE(0 == zero->population());
+    REQUIRE(1 == one->population());
+    REQUIRE(2 == two->population());
+    REQUIRE(3 == three->population());
+    REQUIRE(4 == four->population());
+    REQUIRE(8 == eight->population());
+  }
+
+  SECTION("Populations too large for a node's own bits stay exact") {
+    auto full = QuadTreeNode::retrieve(true);
+    auto empty = QuadTreeNode::retrieve(false);
+    for (unsigned int height = 1; height <= 30; height++) {
+      auto quarter = full;
+      full = QuadTreeNode::retrieve(quarter, quarter, quarter, quarter);
+      REQUIRE(uint64_t(1) << (2 * height) == full->population());
+      REQUIRE(height == full->height());
+
+      auto three = QuadTreeNode::retrieve(quarter, empty, quarter, quarter);
+      REQUIRE(3 * quarter->population() == three->population());
+      empty = QuadTreeNode::retrieve(empty, empty, empty, empty);
+    }
+  }
+
+  SECTION("Nodes keep their population after the arena reuses freed slots") {
+    auto alive = QuadTreeNode::retrieve(true);
+    auto empty = QuadTreeNode::retrieve(false);
+    auto kept = QuadTreeNode::retrieve(alive, empty, alive, empty);
+    QuadTreeNode::retrieve(empty, alive, alive, alive);
+    QuadTreeNode::collectGarbage({kept});
+
+    auto made = QuadTreeNode::retrieve(alive, alive, alive, empty);
+    REQUIRE(2 == kept->population());
+    REQUIRE(3 == made->population());
+    REQUIRE(kept == QuadTreeNode::retrieve(alive, empty, alive, empty));
+    REQUIRE(made == QuadTreeNode::retrieve(alive, alive, alive, empty));
   }
 }
 
@@ -44,7 +133,7 @@ TEST_CASE("QuadTreeNode (get/set)CellAlive", "[QuadTreeNode]") {
     bool bl = root->getCellAlive(0, -1);
     bool br = root->getCellAlive(-1, -1);
 
-    REQUIRE(1 == root->height);
+    REQUIRE(1 == root->height());
     REQUIRE(false == tl);
     REQUIRE(false == tr);
     REQUIRE(false == bl);
@@ -131,8 +220,8 @@ TEST_CASE("compact", "[QuadTreeNode]") {
     auto node = emptyNode->setCellAlive(-7, 8);
     auto compacted = node->compact();
 
-    REQUIRE(node->population == 1);
-    REQUIRE(node->population == compacted->population);
+    REQUIRE(node->population() == 1);
+    REQUIRE(node->population() == compacted->population());
     REQUIRE(node == compacted);
   }
 
@@ -145,14 +234,14 @@ TEST_CASE("compact", "[QuadTreeNode]") {
     node = node->setCellAlive(-1, 0);
     auto compacted = node->compact();
 
-    REQUIRE(2 == compacted->population);
-    REQUIRE(node->population == compacted->population);
-    REQUIRE(1 == compacted->height);
+    REQUIRE(2 == compacted->population());
+    REQUIRE(node->population() == compacted->population());
+    REQUIRE(1 == compacted->height());
 
-    REQUIRE(empty == compacted->nw);
-    REQUIRE(full == compacted->ne);
-    REQUIRE(full == compacted->sw);
-    REQUIRE(empty == compacted->se);
+    REQUIRE(empty == compacted->nw());
+    REQUIRE(full == compacted->ne());
+    REQUIRE(full == compacted->sw());
+    REQUIRE(empty == compacted->se());
   }
 
   SECTION("compact on an 8x8 node with a live child in the middle produces "
@@ -163,56 +252,56 @@ TEST_CASE("compact", "[QuadTreeNode]") {
     node = node->setCellAlive(0, 1);
     auto compacted = node->compact();
 
-    REQUIRE(1 == compacted->population);
-    REQUIRE(node->population == compacted->population);
-    REQUIRE(2 == compacted->height);
+    REQUIRE(1 == compacted->population());
+    REQUIRE(node->population() == compacted->population());
+    REQUIRE(2 == compacted->height());
 
-    REQUIRE(empty == compacted->nw->ne);
+    REQUIRE(empty == compacted->nw()->ne());
 
-    REQUIRE(empty == compacted->nw->nw);
-    REQUIRE(empty == compacted->nw->sw);
-    REQUIRE(empty == compacted->nw->se);
+    REQUIRE(empty == compacted->nw()->nw());
+    REQUIRE(empty == compacted->nw()->sw());
+    REQUIRE(empty == compacted->nw()->se());
 
-    REQUIRE(empty == compacted->ne->nw);
-    REQUIRE(empty == compacted->ne->ne);
-    REQUIRE(empty == compacted->ne->sw);
-    REQUIRE(empty == compacted->ne->se);
+    REQUIRE(empty == compacted->ne()->nw());
+    REQUIRE(empty == compacted->ne()->ne());
+    REQUIRE(empty == compacted->ne()->sw());
+    REQUIRE(empty == compacted->ne()->se());
 
-    REQUIRE(empty == compacted->sw->nw);
-    REQUIRE(empty == compacted->sw->ne);
-    REQUIRE(empty == compacted->sw->sw);
-    REQUIRE(empty == compacted->sw->se);
+    REQUIRE(empty == compacted->sw()->nw());
+    REQUIRE(empty == compacted->sw()->ne());
+    REQUIRE(empty == compacted->sw()->sw());
+    REQUIRE(empty == compacted->sw()->se());
 
-    REQUIRE(empty == compacted->se->nw);
-    REQUIRE(empty == compacted->se->ne);
-    REQUIRE(full == compacted->se->sw);
-    REQUIRE(empty == compacted->se->se);
+    REQUIRE(empty == compacted->se()->nw());
+    REQUIRE(empty == compacted->se()->ne());
+    REQUIRE(full == compacted->se()->sw());
+    REQUIRE(empty == compacted->se()->se());
   }
 }
 
 TEST_CASE("createEmptyAtHeight", "[QuadTreeNode]") {
   SECTION("emptyAtLevel(0) produces an emtpy node") {
     auto node = QuadTreeNode::createEmptyAtHeight(0);
-    REQUIRE(0 == node->alive);
-    REQUIRE(0 == node->population);
+    REQUIRE(0 == node->alive());
+    REQUIRE(0 == node->population());
   }
 
   SECTION("emptyAtLevel(63) works") {
     auto node = QuadTreeNode::createEmptyAtHeight(63);
-    REQUIRE(0 == node->alive);
-    REQUIRE(0 == node->population);
-    REQUIRE(63 == node->height);
+    REQUIRE(0 == node->alive());
+    REQUIRE(0 == node->population());
+    REQUIRE(63 == node->height());
   }
 
   SECTION("emptyAtLevel(1) produces a node containing 4 empty leaves") {
     auto empty = QuadTreeNode::retrieve(false);
     auto node = QuadTreeNode::createEmptyAtHeight(1);
 
-    REQUIRE(0 == node->population);
-    REQUIRE(empty == node->nw);
-    REQUIRE(empty == node->ne);
-    REQUIRE(empty == node->sw);
-    REQUIRE(empty == node->se);
+    REQUIRE(0 == node->population());
+    REQUIRE(empty == node->nw());
+    REQUIRE(empty == node->ne());
+    REQUIRE(empty == node->sw());
+    REQUIRE(empty == node->se());
   }
 
   SECTION("createEmptyAtHeight(2) produces a node containing 4 nodes each "
@@ -220,25 +309,51 @@ TEST_CASE("createEmptyAtHeight", "[QuadTreeNode]") {
     auto empty = QuadTreeNode::retrieve(false);
     auto node = QuadTreeNode::createEmptyAtHeight(2);
 
-    REQUIRE(0 == node->population);
-    REQUIRE(empty == node->nw->nw);
-    REQUIRE(empty == node->nw->ne);
-    REQUIRE(empty == node->nw->sw);
-    REQUIRE(empty == node->nw->se);
-
-    REQUIRE(empty == node->ne->nw);
-    REQUIRE(empty == node->ne->ne);
-    REQUIRE(empty == node->ne->sw);
-    REQUIRE(empty == node->ne->se);
-
-    REQUIRE(empty == node->sw->nw);
-    REQUIRE(empty == node->sw->ne);
-    REQUIRE(empty == node->sw->sw);
-    REQUIRE(empty == node->sw->se);
-
-    REQUIRE(empty == node->se->nw);
-    REQUIRE(empty == node->se->ne);
-    REQUIRE(empty == node->se->sw);
-    REQUIRE(empty == node->se->se);
+    REQUIRE(0 == node->population());
+    REQUIRE(empty == node->nw()->nw());
+    REQUIRE(empty == node->nw()->ne());
+    REQUIRE(empty == node->nw()->sw());
+    REQUIRE(empty == node->nw()->se());
+
+    REQUIRE(empty == node->ne()->nw());
+    REQUIRE(empty == node->ne()->ne());
+    REQUIRE(empty == node->ne()->sw());
+    REQUIRE(empty == node->ne()->se());
+
+    REQUIRE(empty == node->sw()->nw());
+    REQUIRE(empty == node->sw()->ne());
+    REQUIRE(empty == node->sw()->sw());
+    REQUIRE(empty == node->sw()->se());
+
+    REQUIRE(empty == node->se()->nw());
+    REQUIRE(empty == node->se()->ne());
+    REQUIRE(empty == node->se()->sw());
+    REQUIRE(empty == node->se()->se());
+  }
+
+  SECTION("Empty nodes are canonical and found without touching the cache") {
+    auto node = QuadTreeNode::createEmptyAtHeight(20);
+    QuadTreeNode::resetStats();
+
+    REQUIRE(node == QuadTreeNode::createEmptyAtHeight(20));
+    REQUIRE(node == QuadTreeNode::retrieve(node->nw(), node->ne(), node->sw(),
+                                           node->se()));
+    REQUIRE(node == QuadTreeNode::createEmptyAtHeight(19)->grow());
+    REQUIRE(node->grow() == QuadTreeNode::createEmptyAtHeight(21));
+    REQUIRE(node->nextGeneration() == QuadTreeNode::createEmptyAtHeight(19));
+    REQUIRE(node->compact() == QuadTreeNode::createEmptyAtHeight(1));
+    REQUIRE(!node->getCellAlive(-5, 7));
+    REQUIRE(0 == QuadTreeNode::getStats().internHits);
+    REQUIRE(0 == QuadTreeNode::getStats().internMisses);
+  }
+
+  SECTION("Empty nodes survive garbage collection") {
+    auto node = QuadTreeNode::createEmptyAtHeight(12);
+    QuadTreeNode::collectGarbage(std::vector<QuadTreeNode *>());
+
+    REQUIRE(node == QuadTreeNode::createEmptyAtHeight(12));
+    REQUIRE(0 == node->population());
+    REQUIRE(12 == node->height());
+    REQUIRE(node->nw() == QuadTreeNode::createEmptyAtHeight(11));
   }
 }
@@ -0,0 +1,269 @@
+#include "../InputParser.hpp"
+#include "../QueryServer.hpp"
+#include "catch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Connects to the server listening at path, returning the socket.
+ */
+static int connectTo(const std::string &path) {
+  sockaddr_un address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int client = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connect(client, reinterpret_cast<sockaddr *>(&address),
+              sizeof(address)) != 0) {
+    close(client);
+    return -1;
+  }
+  return client;
+}
+
+/**
+ * Sends one request line and returns the reply line without its newline.
+ */
+static std::string ask(int client, const std::string &request) {
+  std::string line = request + "\n";
+  send(client, line.data(), line.size(), MSG_NOSIGNAL);
+  std::string reply;
+  char c;
+  while (recv(client, &c, 1, 0) == 1 && c != '\n') {
+    reply += c;
+  }
+  return reply;
+}
+
+/**
+ * Runs a server for the given cells on its own thread, which makes the
+ * nodes and steps them, until stopped. Fixed universes are 64 cells across,
+ * and saves go to /tmp.
+ */
+class ServerThread {
+public:
+  ServerThread(const std::string &path,
+               std::vector<std::pair<int64_t, int64_t>> cells,
+               QuadTree::Topology topology = QuadTree::PLANE)
+      : path(path) {
+    std::promise<QueryServer *> started;
+    auto ready = started.get_future();
+    thread = std::thread([&started, cells, path, topology]() {
+      QuadTree tree = topology == QuadTree::PLANE
+                          ? QuadTree(cells)
+                          : QuadTree(cells, topology, 6);
+      tree.setHistoryLimit(0);
+      QueryServer server(tree, path, "/tmp");
+      started.set_value(&server);
+      server.run();
+    });
+    server = ready.get();
+  }
+
+  ~ServerThread() {
+    server->stop();
+    thread.join();
+  }
+
+  std::string path;
+  QueryServer *server;
+
+private:
+  std::thread thread;
+};
+
+static std::string socketPath(const char *name) {
+  return "/tmp/conway-test-" + std::to_string(getpid()) + "-" + name;
+}
+
+TEST_CASE("Query server", "[QueryServer]") {
+  auto glider = std::vector<std::pair<int64_t, int64_t>>{
+      {1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}};
+
+  SECTION("Queries read the latest step") {
+    ServerThread running(socketPath("glider"), glider);
+    int client = connectTo(running.path);
+    REQUIRE(client >= 0);
+
+    REQUIRE("ok 0" == ask(client, "generation"));
+    REQUIRE("ok 5" == ask(client, "population"));
+    REQUIRE("ok 0 0 2 2" == ask(client, "bbox"));
+    REQUIRE("ok 4" == ask(client, "step 4"));
+    REQUIRE("ok 4" == ask(client, "generation"));
+    REQUIRE("ok 1 1 3 3" == ask(client, "bbox"));
+    REQUIRE("ok 2 3 2 3 3" == ask(client, "region 3 1 3 3"));
+    REQUIRE("ok 0" == ask(client, "region -10 -10 0 0"));
+    REQUIRE("ok 100" == ask(client, "step 96"));
+    REQUIRE("ok 25 25 27 27" == ask(client, "bbox"));
+    close(client);
+  }
+
+  SECTION("Saved files read back as the same cells") {
+    ServerThread running(socketPath("save"), glider);
+    int client = connectTo(running.path);
+    std::string file = socketPath("saved.life");
+
+    REQUIRE("ok 8" == ask(client, "step 8"));
+    REQUIRE("ok 5" == ask(client, "save " + file.substr(strlen("/tmp/"))));
+    auto cells = InputParser::readFile(file);
+    auto moved = std::vector<std::pair<int64_t, int64_t>>{
+        {2, 4}, {3, 2}, {3, 4}, {4, 3}, {4, 4}};
+    std::sort(cells.begin(), cells.end());
+    REQUIRE(moved == cells);
+    unlink(file.c_str());
+    close(client);
+  }
+
+  SECTION("Saves stay inside the save directory") {
+    ServerThread running(socketPath("confined"), glider);
+    int client = connectTo(running.path);
+
+    REQUIRE(0 == ask(client, "save").find("error"));
+    REQUIRE(0 == ask(client, "save ..").find("error"));
+    REQUIRE(0 == ask(client, "save ../etc/escaped.life").find("error"));
+    REQUIRE(0 == ask(client, "save /tmp/escaped.life").find("error"));
+    REQUIRE(0 != access("/etc/escaped.life", F_OK));
+    close(client);
+  }
+
+  SECTION("Bad requests get errors and keep the connection") {
+    ServerThread running(socketPath("errors"), glider);
+    int client = connectTo(running.path);
+
+    REQUIRE(0 == ask(client, "jump 4").find("error"));
+    REQUIRE(0 == ask(client, "step").find("error"));
+    REQUIRE(0 == ask(client, "step -1").find("error"));
+    REQUIRE(0 == ask(client, "region 1 2 3").find("error"));
+    REQUIRE(0 == ask(client, "population now").find("error"));
+    REQUIRE("ok 5" == ask(client, "population"));
+    close(client);
+  }
+
+  SECTION("Fixed universes refuse steps too long to take at once") {
+    ServerThread bounded(socketPath("bounded"), glider, QuadTree::BOUNDED);
+    ServerThread torus(socketPath("torus"), glider, QuadTree::TORUS);
+    ServerThread plane(socketPath("plane"), glider);
+    int boundedClient = connectTo(bounded.path);
+    int torusClient = connectTo(torus.path);
+    int planeClient = connectTo(plane.path);
+    std::string far = std::to_string(uint64_t(1) << 40);
+
+    REQUIRE(0 == ask(boundedClient, "step " + far).find("error"));
+    REQUIRE("ok 0" == ask(boundedClient, "generation"));
+    REQUIRE("ok 4" == ask(boundedClient, "step 4"));
+    REQUIRE(0 == ask(torusClient, "step " + far).find("error"));
+    REQUIRE("ok 1024" == ask(torusClient, "step 1024"));
+    REQUIRE("ok " + far == ask(planeClient, "step " + far));
+    close(boundedClient);
+    close(torusClient);
+    close(planeClient);
+  }
+
+  SECTION("The population of a huge universe is answered at once") {
+    auto gun = InputParser::readFile("examples/gliderGun.life");
+    ServerThread running(socketPath("gun"), gun);
+    int stepper = connectTo(running.path);
+    int reader = connectTo(running.path);
+    uint64_t far = uint64_t(1) << 48;
+    QuadTree expected = QuadTree(gun);
+    expected.advance(far);
+
+    REQUIRE("ok " + std::to_string(far) ==
+            ask(stepper, "step " + std::to_string(far)));
+    auto start = std::chrono::steady_clock::now();
+    std::string population = ask(reader, "population");
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    REQUIRE("ok " + std::to_string(expected.population()) == population);
+    REQUIRE(elapsed < std::chrono::milliseconds(100));
+    close(stepper);
+    close(reader);
+  }
+
+  SECTION("Clients are served at once while the universe steps") {
+    ServerThread running(socketPath("concurrent"), glider);
+    auto replies = std::vector<std::vector<std::string>>(4);
+    auto clients = std::vector<std::thread>();
+    for (unsigned int i = 0; i < replies.size(); i++) {
+      clients.push_back(std::thread([&, i]() {
+        int client = connectTo(running.path);
+        for (unsigned int j = 0; j < 50; j++) {
+          replies[i].push_back(ask(client, i == 0 ? "step 1" : "population"));
+        }
+        close(client);
+      }));
+    }
+    for (auto &client : clients) {
+      client.join();
+    }
+
+    for (unsigned int j = 0; j < 50; j++) {
+      REQUIRE("ok " + std::to_string(j + 1) == replies[0][j]);
+      for (unsigned int i = 1; i < replies.size(); i++) {
+        REQUIRE("ok 5" == replies[i][j]);
+      }
+    }
+  }
+
+  SECTION("A stop request ends the server") {
+    std::string path = socketPath("stop");
+    std::thread serving([&]() {
+      QuadTree tree = QuadTree(glider);
+      QueryServer server(tree, path, "");
+      server.run();
+    });
+    int client = -1;
+    while (client < 0) {
+      client = connectTo(path);
+    }
+    REQUIRE(0 == ask(client, "save off.life").find("error"));
+    REQUIRE("ok" == ask(client, "stop"));
+    serving.join();
+    REQUIRE(connectTo(path) < 0);
+    close(client);
+  }
+}
+
+TEST_CASE("Arena views", "[QuadTreeNode]") {
+  SECTION("Another thread reads nodes through a view") {
+    auto cells = std::vector<std::pair<int64_t, int64_t>>();
+    for (int64_t i = 0; i < 300; i++) {
+      for (int64_t j = 0; j < 300; j++) {
+        cells.push_back(std::make_pair(i * 2, j * 2));
+      }
+    }
+    QuadTree tree = QuadTree(cells);
+    const QuadTreeNode *arena = QuadTreeNode::getArena();
+    QuadTreeNode *root = tree.root;
+
+    uint64_t population = 0;
+    size_t within = 0;
+    const char *error = nullptr;
+    std::thread reader([&]() {
+      QuadTreeNode::ArenaView view(arena);
+      population = root->population();
+      auto found = std::vector<std::pair<int64_t, int64_t>>();
+      root->appendLivingCellsWithin(tree.min, tree.min, Rect{0, 0, 9, 9},
+                                    found);
+      within = found.size();
+      try {
+        QuadTreeNode::retrieve(true);
+      } catch (const char *e) {
+        error = e;
+      }
+    });
+    reader.join();
+
+    REQUIRE(90000 == population);
+    REQUIRE(25 == within);
+    REQUIRE(error != nullptr);
+  }
+}
@@ -0,0 +1,250 @@
+#include "../QuadTree.hpp"
+#include "../QuadTreeNode.hpp"
+#include "../Rule.hpp"
+#include "catch.hpp"
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Rule parsing", "[Rule]") {
+  SECTION("The default rule is Conway's B3/S23") {
+    Rule rule = Rule();
+    REQUIRE(true == rule.isConway());
+    REQUIRE("B3/S23" == rule.toString());
+  }
+
+  SECTION("B/S and S/B notations produce the same rule") {
+    REQUIRE(Rule("B36/S23") == Rule("23/36"));
+    REQUIRE(Rule("b36/s23") == Rule("S23/B36"));
+    REQUIRE("B36/S23" == Rule("23/36").toString());
+  }
+
+  SECTION("Rules with no survival counts parse") {
+    Rule seeds = Rule("B2/S");
+    REQUIRE((1 << 2) == seeds.birth);
+    REQUIRE(0 == seeds.survival);
+  }
+
+  SECTION("lives checks the birth mask for dead cells and survival for live "
+          "ones") {
+    Rule rule = Rule();
+    REQUIRE(true == rule.lives(false, 3));
+    REQUIRE(false == rule.lives(false, 2));
+    REQUIRE(true == rule.lives(true, 2));
+    REQUIRE(false == rule.lives(true, 4));
+  }
+
+  SECTION("Malformed rules throw") {
+    REQUIRE_THROWS(Rule("B3S23"));
+    REQUIRE_THROWS(Rule("B39/S23"));
+    REQUIRE_THROWS(Rule("B3/X23"));
+    REQUIRE_THROWS(Rule("B03/S23"));
+  }
+}
+
+TEST_CASE("Rule Generations", "[Rule]") {
+  SECTION("Generations rules parse the amount of states in either notation") {
+    Rule brain = Rule("B2/S/C3");
+    REQUIRE(3 == brain.states);
+    REQUIRE(brain == Rule("/2/3"));
+    REQUIRE("B2/S/C3" == brain.toString());
+    REQUIRE(Rule("B2/S345/C4") == Rule("345/2/4"));
+    REQUIRE(Rule("B2/S") != brain);
+  }
+
+  SECTION("Living cells that fail to survive start dying, and dying cells "
+          "age back to dead") {
+    Rule brain = Rule("B2/S/C3");
+    REQUIRE(1 == brain.nextState(0, true));
+    REQUIRE(0 == brain.nextState(0, false));
+    REQUIRE(2 == brain.nextState(1, false));
+    REQUIRE(0 == brain.nextState(2, true));
+
+    Rule starWars = Rule("B2/S345/C4");
+    REQUIRE(1 == starWars.nextState(1, true));
+    REQUIRE(3 == starWars.nextState(2, true));
+    REQUIRE(0 == starWars.nextState(3, false));
+  }
+
+  SECTION("Out of range state counts throw") {
+    REQUIRE_THROWS(Rule("B2/S/C1"));
+    REQUIRE_THROWS(Rule("B2/S/C257"));
+    REQUIRE_THROWS(Rule("B2/S/Cx"));
+  }
+}
+
+TEST_CASE("Rule Hensel notation", "[Rule]") {
+  SECTION("Listing every letter of a count is the same as the bare count") {
+    REQUIRE(Rule("B3/S23") == Rule("B3ceaiknjqry/S2ceaikn3"));
+    REQUIRE(Rule("B4/S") == Rule("B4ceaiknjqrytwz/S"));
+    REQUIRE(Rule("B36/S5") == Rule("B36ceaikn/S5ceaiknjqry"));
+    REQUIRE(Rule("B2/S17") == Rule("B2c2e2a2i2k2n/S1ce7ce"));
+  }
+
+  SECTION("Excluding letters is the same as listing the others") {
+    REQUIRE(Rule("B2-a/S") == Rule("B2ceikn/S"));
+    REQUIRE(Rule("B3/S2-in3") == Rule("B3/S2ceak3"));
+  }
+
+  SECTION("Letters restrict births to matching neighborhoods in any "
+          "orientation") {
+    // neighborhood bits are (y * 3 + x), so the top row is bits 0 to 2
+    Rule rule = Rule("B2c/S");
+    REQUIRE(false == rule.totalistic);
+    REQUIRE(true == rule.next((1 << 0) | (1 << 2)));  // nw, ne
+    REQUIRE(true == rule.next((1 << 2) | (1 << 8)));  // ne, se
+    REQUIRE(false == rule.next((1 << 0) | (1 << 8))); // nw, se
+    REQUIRE(false == rule.next((1 << 1) | (1 << 5))); // n, e
+  }
+
+  SECTION("Non-totalistic rules keep their notation") {
+    REQUIRE("B2-a/S12" == Rule("b2-a/s12").toString());
+  }
+
+  SECTION("Letters that don't exist for a count throw") {
+    REQUIRE_THROWS(Rule("B1a/S"));
+    REQUIRE_THROWS(Rule("B3/S8c"));
+    REQUIRE_THROWS(Rule("B3-/S23"));
+  }
+}
+
+/**
+ * Steps a set of points one generation by brute force, for comparing against
+ * the quad tree.
+ */
+static std::set<std::pair<int64_t, int64_t>>
+bruteForceStep(const std::set<std::pair<int64_t, int64_t>> &cells,
+               const Rule &rule) {
+  std::set<std::pair<int64_t, int64_t>> candidates;
+  for (auto const &cell : cells) {
+    for (int64_t dy = -1; dy <= 1; dy++) {
+      for (int64_t dx = -1; dx <= 1; dx++) {
+        candidates.insert({cell.first + dx, cell.second + dy});
+      }
+    }
+  }
+
+  std::set<std::pair<int64_t, int64_t>> next;
+  for (auto const &cell : candidates) {
+    unsigned int neighborhood = 0;
+    for (int64_t dy = -1; dy <= 1; dy++) {
+      for (int64_t dx = -1; dx <= 1; dx++) {
+        if (cells.count({cell.first + dx, cell.second + dy})) {
+          neighborhood |= 1 << ((dy + 1) * 3 + dx + 1);
+        }
+      }
+    }
+    if (rule.next(neighborhood)) {
+      next.insert(cell);
+    }
+  }
+  return next;
+}
+
+/**
+ * Steps a map of cell states one generation by brute force under a
+ * Generations rule.
+ */
+static std::map<std::pair<int64_t, int64_t>, uint8_t>
+bruteForceStates(const std::map<std::pair<int64_t, int64_t>, uint8_t> &cells,
+                 const Rule &rule) {
+  std::set<std::pair<int64_t, int64_t>> alive;
+  for (auto const &cell : cells) {
+    if (cell.second == 1) {
+      alive.insert(cell.first);
+    }
+  }
+
+  std::map<std::pair<int64_t, int64_t>, uint8_t> next;
+  for (auto const &cell : bruteForceStep(alive, rule)) {
+    next[cell] = 1;
+  }
+  for (auto const &cell : cells) {
+    uint8_t state = rule.nextState(cell.second, next.count(cell.first) > 0);
+    if (state != 0) {
+      next[cell.first] = state;
+    } else {
+      next.erase(cell.first);
+    }
+  }
+  return next;
+}
+
+TEST_CASE("QuadTree rules", "[Rule]") {
+  auto points = std::vector<std::pair<int64_t, int64_t>>{
+      {0, -2}, {1, -2}, {2, -2}, {-1, -1}, {2, -1}, {-2, 0},
+      {2, 0},  {-2, 1}, {1, 1},  {-2, 2},  {-1, 2}, {0, 2}};
+
+  SECTION("A blinker under Maze (B3/S12345) grows into a plus") {
+    QuadTreeNode::setRule(Rule("B3/S12345"));
+
+    QuadTree tree = QuadTree{};
+    tree.setCellAlive(0, -1);
+    tree.setCellAlive(0, 0);
+    tree.setCellAlive(0, 1);
+    tree.nextGeneration();
+
+    QuadTreeNode::setRule(Rule());
+
+    for (int64_t y = -3; y <= 3; y++) {
+      for (int64_t x = -3; x <= 3; x++) {
+        bool plus =
+            (x == 0 && y >= -1 && y <= 1) || (y == 0 && x >= -1 && x <= 1);
+        REQUIRE(plus == tree.getCellAlive(x, y));
+      }
+    }
+  }
+
+  SECTION("Compiled (B36/S23), table (B36/S238) and non-totalistic "
+          "(B2i3/S23-a) kernels match brute force") {
+    for (auto const &name : {"B36/S23", "B36/S238", "B2i3/S23-a"}) {
+      Rule rule = Rule(name);
+      QuadTreeNode::setRule(rule);
+
+      QuadTree tree = QuadTree(points);
+      auto cells = std::set<std::pair<int64_t, int64_t>>(points.begin(),
+                                                         points.end());
+      for (int i = 0; i < 16; i++) {
+        tree.nextGeneration();
+        cells = bruteForceStep(cells, rule);
+      }
+
+      QuadTreeNode::setRule(Rule());
+
+      REQUIRE(cells.size() == tree.population());
+      for (auto const &cell : cells) {
+        REQUIRE(true == tree.getCellAlive(cell.first, cell.second));
+      }
+    }
+  }
+
+  SECTION("Brian's Brain and Star Wars match brute force, including dying "
+          "cells") {
+    for (auto const &name : {"B2/S/C3", "B2/S345/C4"}) {
+      Rule rule = Rule(name);
+      QuadTreeNode::setRule(rule);
+
+      QuadTree tree = QuadTree(points);
+      auto cells = std::map<std::pair<int64_t, int64_t>, uint8_t>();
+      for (auto const &point : points) {
+        cells[point] = 1;
+      }
+      for (int i = 0; i < 16; i++) {
+        tree.nextGeneration();
+        cells = bruteForceStates(cells, rule);
+      }
+
+      QuadTreeNode::setRule(Rule());
+
+      uint64_t population = 0;
+      for (auto const &cell : cells) {
+        REQUIRE(cell.second ==
+                tree.getCellState(cell.first.first, cell.first.second));
+        population += cell.second == 1 ? 1 : 0;
+      }
+      REQUIRE(population == tree.population());
+    }
+  }
+}
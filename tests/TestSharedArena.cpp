@@ -0,0 +1,173 @@
+#include "../InputParser.hpp"
+#include "../QuadTree.hpp"
+#include "../QuadTreeNode.hpp"
+#include "../SharedArena.hpp"
+#include "catch.hpp"
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint32_t CAPACITY = 1 << 20;
+
+static std::string arenaName(const char *name) {
+  return "conway-test-" + std::to_string(getpid()) + "-" + name;
+}
+
+struct SharedRun {
+  uint64_t population;
+  QuadTreeNode::Stats stats;
+  bool shared;
+  size_t nodes;
+  size_t collected;
+  const char *error;
+};
+
+/**
+ * Seeks a life file to a generation on a new thread, which shares the
+ * named arena first if given one, or else takes whatever arena new threads
+ * get.
+ */
+static SharedRun runOnThread(const std::string &file, uint64_t generations,
+                             const std::string &share = "") {
+  SharedRun run = SharedRun{0, QuadTreeNode::Stats(), false, 0, 0, nullptr};
+  std::thread worker([&]() {
+    try {
+      if (!share.empty()) {
+        QuadTreeNode::shareArena(share, CAPACITY);
+      }
+      QuadTreeNode::resetStats();
+      QuadTree tree = QuadTree(InputParser::readFile(file));
+      tree.setHistoryLimit(0);
+      tree.seek(generations);
+      run.population = tree.population();
+      run.stats = QuadTreeNode::getStats();
+      run.shared = QuadTreeNode::arenaShared();
+      run.nodes = QuadTreeNode::cacheSize();
+      run.collected = tree.collectGarbage();
+    } catch (const char *e) {
+      run.error = e;
+    }
+  });
+  worker.join();
+  return run;
+}
+
+TEST_CASE("Shared arenas", "[SharedArena]") {
+  auto own = runOnThread("examples/acorn.life", 1000);
+  REQUIRE(!own.shared);
+
+  SECTION("Later threads find every node and result already made") {
+    std::string name = arenaName("threads");
+    auto first = runOnThread("examples/acorn.life", 1000, name);
+    auto second = runOnThread("examples/acorn.life", 1000);
+    QuadTreeNode::stopSharingArena();
+    SharedArena::unlink(name);
+
+    REQUIRE(first.error == nullptr);
+    REQUIRE(first.shared);
+    REQUIRE(second.shared);
+    REQUIRE(own.population == first.population);
+    REQUIRE(own.population == second.population);
+    REQUIRE(first.stats.internMisses > 0);
+    REQUIRE(0 == second.stats.internMisses);
+    REQUIRE(0 == second.stats.nextMisses);
+    // the jumps are memoized too, so most of the work is skipped
+    REQUIRE(second.stats.internHits * 10 < first.stats.internHits);
+    REQUIRE(first.nodes == second.nodes);
+    REQUIRE(0 == first.collected);
+    REQUIRE(!runOnThread("examples/acorn.life", 1).shared);
+  }
+
+  SECTION("Threads interning at once agree on every node") {
+    std::string name = arenaName("concurrent");
+    auto gun = runOnThread("examples/gliderGun.life", 700);
+    runOnThread("examples/glider.life", 0, name);
+    auto runs = std::vector<SharedRun>(4);
+    auto workers = std::vector<std::thread>();
+    for (unsigned int i = 0; i < runs.size(); i++) {
+      workers.push_back(std::thread([&, i]() {
+        runs[i] = runOnThread(i % 2 ? "examples/acorn.life"
+                                    : "examples/gliderGun.life",
+                              i % 2 ? 1000 : 700);
+      }));
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    auto again = runOnThread("examples/gliderGun.life", 700);
+    QuadTreeNode::stopSharingArena();
+    SharedArena::unlink(name);
+
+    for (unsigned int i = 0; i < runs.size(); i++) {
+      REQUIRE(runs[i].error == nullptr);
+      REQUIRE(runs[i].shared);
+      REQUIRE(runs[i].population ==
+              (i % 2 ? own.population : gun.population));
+    }
+    REQUIRE(0 == again.stats.internMisses);
+  }
+
+  SECTION("Another process reuses the nodes of the first") {
+    std::string name = arenaName("processes");
+    pid_t child = fork();
+    if (child == 0) {
+      auto run = runOnThread("examples/acorn.life", 1000, name);
+      _exit(run.error == nullptr && run.shared &&
+                    run.population == own.population
+                ? 0
+                : 1);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(0 == WEXITSTATUS(status));
+
+    auto run = runOnThread("examples/acorn.life", 1000, name);
+    QuadTreeNode::stopSharingArena();
+    SharedArena::unlink(name);
+    REQUIRE(run.error == nullptr);
+    REQUIRE(own.population == run.population);
+    REQUIRE(0 == run.stats.internMisses);
+    REQUIRE(0 == run.stats.nextMisses);
+  }
+
+  SECTION("Arenas of another rule or build are refused") {
+    std::string name = arenaName("mismatch");
+    SharedArena arena(name, CAPACITY, 24, "B3/S23", "MixHash");
+    REQUIRE(arena.created());
+    REQUIRE_THROWS(SharedArena(name, CAPACITY, 24, "B36/S23", "MixHash"));
+    REQUIRE_THROWS(SharedArena(name, CAPACITY, 24, "B3/S23", "WyHash"));
+    REQUIRE_THROWS(SharedArena(name, CAPACITY, 32, "B3/S23", "MixHash"));
+    SharedArena same(name, CAPACITY, 24, "B3/S23", "MixHash");
+    REQUIRE(!same.created());
+    SharedArena::unlink(name);
+
+    const char *error = nullptr;
+    std::thread worker([&]() {
+      try {
+        QuadTreeNode::shareArena(arenaName("rule"), CAPACITY);
+        QuadTreeNode::retrieve(true);
+        QuadTreeNode::setRule(Rule("B36/S23"));
+      } catch (const char *e) {
+        error = e;
+      }
+    });
+    worker.join();
+    QuadTreeNode::stopSharingArena();
+    SharedArena::unlink(arenaName("rule"));
+    REQUIRE(error != nullptr);
+  }
+
+  SECTION("A full arena says so") {
+    std::string name = arenaName("full");
+    SharedArena arena(name, 4, 24, "B3/S23", "MixHash");
+    SharedArena::unlink(name);
+    REQUIRE(1 == arena.allocate());
+    REQUIRE(2 == arena.allocate());
+    REQUIRE(3 == arena.allocate());
+    REQUIRE_THROWS(arena.allocate());
+    REQUIRE(3 == arena.size());
+  }
+}
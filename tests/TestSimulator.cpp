@@ -0,0 +1,103 @@
+#include "../QuadTree.hpp"
+#include "../QuadTreeNode.hpp"
+#include "../Rule.hpp"
+#include "../Simulator.hpp"
+#include "SortedCells.hpp"
+#include "catch.hpp"
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+static const std::vector<std::pair<int64_t, int64_t>> ACORN = {
+    {0, 0}, {1, 0}, {1, -2}, {3, -1}, {4, 0}, {5, 0}, {6, 0}};
+
+/**
+ * Returns a random 32x32 soup, which no other test has memoized.
+ */
+static std::vector<std::pair<int64_t, int64_t>> soup(unsigned int seed) {
+  std::mt19937 random(seed);
+  auto cells = std::vector<std::pair<int64_t, int64_t>>();
+  for (int64_t y = 0; y < 32; y++) {
+    for (int64_t x = 0; x < 32; x++) {
+      if (random() & 1) {
+        cells.push_back(std::pair<int64_t, int64_t>(x, y));
+      }
+    }
+  }
+  return cells;
+}
+
+TEST_CASE("Simulator engine switching", "[Simulator]") {
+  SECTION("Switching back and forth on every generation matches the quad "
+          "tree") {
+    // any hit rate is too low and any population change settled enough, so
+    // the engine switches at least every other generation
+    Simulator::Thresholds thresholds = {1.1, 1e9, 1};
+    Simulator simulator = Simulator(QuadTree(ACORN), Simulator::HASHLIFE,
+                                    true, thresholds);
+    QuadTree tree = QuadTree(ACORN);
+
+    for (unsigned int i = 0; i < 200; i++) {
+      simulator.nextGeneration();
+      tree.nextGeneration();
+      REQUIRE(sorted(tree.getLivingCells()) ==
+              sorted(simulator.getLivingCells()));
+    }
+    REQUIRE(simulator.getSwitchCount() > 10);
+    REQUIRE(200 == simulator.getGeneration());
+  }
+
+  SECTION("A chaotic pattern moves to the dense engine") {
+    Simulator simulator = Simulator(QuadTree(soup(32)));
+    for (unsigned int i = 0; i < 100; i++) {
+      simulator.nextGeneration();
+    }
+
+    REQUIRE(Simulator::DENSE == simulator.getEngine());
+    REQUIRE(simulator.getLastDecision().find("dense") != std::string::npos);
+  }
+
+  SECTION("A still life moves back to hashlife once it settles") {
+    Simulator simulator =
+        Simulator(QuadTree({{0, 0}, {1, 0}, {0, 1}, {1, 1}}), Simulator::DENSE);
+    for (unsigned int i = 0; i < 100; i++) {
+      simulator.nextGeneration();
+    }
+
+    REQUIRE(Simulator::HASHLIFE == simulator.getEngine());
+    REQUIRE(4 == simulator.population());
+    REQUIRE(1 == simulator.getSwitchCount());
+    REQUIRE(1 == simulator.getPeriod());
+  }
+
+  SECTION("Switching can be turned off") {
+    Simulator simulator =
+        Simulator(QuadTree(ACORN), Simulator::HASHLIFE, false);
+    for (unsigned int i = 0; i < 100; i++) {
+      simulator.nextGeneration();
+    }
+
+    REQUIRE(Simulator::HASHLIFE == simulator.getEngine());
+    REQUIRE(0 == simulator.getSwitchCount());
+  }
+
+  SECTION("Universes the dense engine can't run stay on hashlife") {
+    Simulator torus =
+        Simulator(QuadTree(ACORN, QuadTree::TORUS, 5), Simulator::HASHLIFE);
+    QuadTreeNode::setRule(Rule("B2/S/C3"));
+    Simulator generations = Simulator(QuadTree(ACORN), Simulator::HASHLIFE);
+    for (unsigned int i = 0; i < 100; i++) {
+      generations.nextGeneration();
+    }
+    QuadTreeNode::setRule(Rule());
+    for (unsigned int i = 0; i < 100; i++) {
+      torus.nextGeneration();
+    }
+
+    REQUIRE(Simulator::HASHLIFE == torus.getEngine());
+    REQUIRE(Simulator::HASHLIFE == generations.getEngine());
+    REQUIRE_THROWS(Simulator(QuadTree(ACORN, QuadTree::TORUS, 5),
+                             Simulator::DENSE));
+  }
+}
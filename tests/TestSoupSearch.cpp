@@ -0,0 +1,54 @@
+#include "../SoupSearch.hpp"
+#include "catch.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Soup search", "[SoupSearch]") {
+  SECTION("Soups depend only on the seed and their number") {
+    auto soup = SoupSearch::soup(7, 3, 16, 0.5);
+
+    REQUIRE(soup == SoupSearch::soup(7, 3, 16, 0.5));
+    REQUIRE(soup != SoupSearch::soup(7, 4, 16, 0.5));
+    REQUIRE(soup != SoupSearch::soup(8, 3, 16, 0.5));
+    REQUIRE(soup.size() > 64);
+    REQUIRE(soup.size() < 192);
+    for (auto const &cell : soup) {
+      REQUIRE(cell.first >= 0);
+      REQUIRE(cell.first < 16);
+      REQUIRE(cell.second >= 0);
+      REQUIRE(cell.second < 16);
+    }
+  }
+
+  SECTION("Densities of 0 and 1 give empty and full soups") {
+    REQUIRE(SoupSearch::soup(1, 1, 8, 0).empty());
+    REQUIRE(64 == SoupSearch::soup(1, 1, 8, 1).size());
+  }
+
+  SECTION("The census is the same however many threads run it") {
+    auto options = SoupSearch::defaultOptions();
+    options.soups = 24;
+    options.threads = 1;
+    auto single = SoupSearch(options).run();
+    options.threads = 4;
+    auto parallel = SoupSearch(options).run();
+
+    REQUIRE(24 == single.soups);
+    REQUIRE(24 == parallel.soups);
+    REQUIRE(4 == parallel.threads);
+    REQUIRE(single.unstable == parallel.unstable);
+    REQUIRE(single.generations == parallel.generations);
+    REQUIRE(single.census.objects() > 0);
+    REQUIRE(single.census.sorted() == parallel.census.sorted());
+  }
+
+  SECTION("Invalid options are refused") {
+    auto options = SoupSearch::defaultOptions();
+    options.density = 1.5;
+    REQUIRE_THROWS(SoupSearch{options});
+    options.density = 0.5;
+    options.size = 0;
+    REQUIRE_THROWS(SoupSearch{options});
+  }
+}
@@ -0,0 +1,45 @@
+#include "../QuadTree.hpp"
+#include "../Stabilizer.hpp"
+#include "catch.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Stabilizer", "[Stabilizer]") {
+  SECTION("A blinker is settled from the start with period 2") {
+    QuadTree tree = QuadTree({{-1, 0}, {0, 0}, {1, 0}});
+    auto result = Stabilizer(tree).run(100);
+
+    REQUIRE(true == result.stable);
+    REQUIRE(0 == result.generation);
+    REQUIRE(2 == result.period);
+    REQUIRE(3 == result.population);
+  }
+
+  SECTION("A block with a glider escaping from it settles once the glider "
+          "has left") {
+    QuadTree tree = QuadTree({{-1, -2}, {0, -1}, {-2, 0}, {-1, 0}, {0, 0},
+                              {-10, -10}, {-9, -10}, {-10, -9}, {-9, -9}});
+    auto result = Stabilizer(tree).run(1000);
+
+    REQUIRE(true == result.stable);
+    REQUIRE(0 == result.generation);
+    REQUIRE(1 == result.period);
+    REQUIRE(9 == result.population);
+  }
+
+  SECTION("The R-pentomino settles at generation 1103 with 116 cells, "
+          "including six escaping gliders") {
+    QuadTree tree = QuadTree({{0, -1}, {1, -1}, {-1, 0}, {0, 0}, {0, 1}});
+    Stabilizer stabilizer = Stabilizer(tree);
+
+    REQUIRE(false == stabilizer.run(1000).stable);
+    REQUIRE(1000 == tree.getGeneration());
+
+    auto result = stabilizer.run(5000);
+    REQUIRE(true == result.stable);
+    REQUIRE(1103 == result.generation);
+    REQUIRE(116 == result.population);
+    REQUIRE(tree.getGeneration() == result.detectedAt);
+  }
+}